@@ -6,44 +6,100 @@
 #include "types.hpp"
 #include "util.hpp"
 
-Arena make_arena(size_t capacity)
+#ifdef OS_WINDOWS
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+#endif
+
+#define ARENA_COMMIT_GRANULARITY kilobytes(64)
+
+static inline size_t align_up(size_t ptr, size_t align)
+{
+    return (ptr + (align - 1)) & ~(align - 1);
+}
+
+// ======================== VIRTUAL MEMORY ========================
+
+static void *arena_os_reserve(size_t size)
+{
+#ifdef OS_WINDOWS
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    void *ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return (ptr == MAP_FAILED) ? NULL : ptr;
+#endif
+}
+
+static bool arena_os_commit(void *ptr, size_t size)
+{
+#ifdef OS_WINDOWS
+    return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+    return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+static void arena_os_decommit(void *ptr, size_t size)
+{
+#ifdef OS_WINDOWS
+    VirtualFree(ptr, size, MEM_DECOMMIT);
+#else
+    // Mapping fresh PROT_NONE pages over the range drops the old ones
+    mmap(ptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+#endif
+}
+
+static void arena_os_release(void *ptr, size_t size)
+{
+#ifdef OS_WINDOWS
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    munmap(ptr, size);
+#endif
+}
+
+// ======================== ARENA ========================
+
+Arena make_arena(size_t reserve_size)
 {
     Arena arena = {};
-    arena.base = (u8 *)xmalloc(capacity);
-    arena.capacity = capacity;
+    arena.reserved = align_up(reserve_size, ARENA_COMMIT_GRANULARITY);
+    arena.base = (u8 *)arena_os_reserve(arena.reserved);
+    if (!arena.base) fatal("Failed to reserve %zu bytes for arena", arena.reserved);
     return arena;
 }
 
 void destroy_arena(Arena *arena)
 {
-    free(arena->base);
+    arena_os_release(arena->base, arena->reserved);
     *arena = (Arena){};
 }
 
-static inline size_t align_up(size_t ptr, size_t align)
-{
-    return (ptr + (align - 1)) & ~(align - 1);
-}
-
 void *arena_alloc_raw(Arena *arena, size_t size, size_t align)
 {
     size_t current = (size_t)(arena->base + arena->offset);
     size_t aligned = align_up(current, align);
     size_t new_offset = (aligned - (size_t)arena->base) + size;
-    bassert(new_offset <= arena->capacity);
+    if (new_offset > arena->reserved) fatal("Arena overflow: %zu of %zu bytes", new_offset, arena->reserved);
+
+    if (new_offset > arena->committed)
+    {
+        size_t new_committed = align_up(new_offset, ARENA_COMMIT_GRANULARITY);
+        if (new_committed > arena->reserved) new_committed = arena->reserved;
+        if (!arena_os_commit(arena->base + arena->committed, new_committed - arena->committed)) fatal("Failed to commit arena memory");
+        arena->committed = new_committed;
+    }
+
     arena->offset = new_offset;
+    if (new_offset > arena->high_water) arena->high_water = new_offset;
     void *data_ptr = (void *)aligned;
     return data_ptr;
 }
 
 void *arena_alloc_zero_raw(Arena *arena, size_t size, size_t align)
 {
-    size_t current = (size_t)(arena->base + arena->offset);
-    size_t aligned = align_up(current, align);
-    size_t new_offset = (aligned - (size_t)arena->base) + size;
-    bassert(new_offset <= arena->capacity);
-    arena->offset = new_offset;
-    void *data_ptr = (void *)aligned;
+    void *data_ptr = arena_alloc_raw(arena, size, align);
     memset(data_ptr, 0, size);
     return data_ptr;
 }
@@ -51,4 +107,34 @@ void *arena_alloc_zero_raw(Arena *arena, size_t size, size_t align)
 void arena_reset(Arena *arena)
 {
     arena->offset = 0;
+    if (arena->decommit_on_reset && arena->committed > 0)
+    {
+        arena_os_decommit(arena->base, arena->committed);
+        arena->committed = 0;
+    }
+}
+
+ArenaTemp arena_temp_begin(Arena *arena)
+{
+    ArenaTemp temp = {};
+    temp.arena = arena;
+    temp.offset = arena->offset;
+    return temp;
+}
+
+// Pages stay committed; only arena_reset with decommit_on_reset returns them
+void arena_temp_end(ArenaTemp temp)
+{
+    bassert(temp.offset <= temp.arena->offset);
+    temp.arena->offset = temp.offset;
+}
+
+ArenaStats arena_get_stats(const Arena *arena)
+{
+    ArenaStats stats = {};
+    stats.reserved = arena->reserved;
+    stats.committed = arena->committed;
+    stats.used = arena->offset;
+    stats.high_water = arena->high_water;
+    return stats;
 }
@@ -4,24 +4,47 @@
 
 #include "types.hpp"
 
+// Reserves a virtual range up front and commits pages as the offset grows,
+// so the arena can grow up to its reserve size without ever moving allocations.
 struct Arena
 {
     u8 *base;
-    size_t capacity;
+    size_t reserved;
+    size_t committed;
     size_t offset;
+    size_t high_water;
+    bool decommit_on_reset; // give committed pages back to the OS on arena_reset
 };
 
-Arena make_arena(size_t capacity);
+// Saved offset; arena_temp_end frees everything allocated since arena_temp_begin
+struct ArenaTemp
+{
+    Arena *arena;
+    size_t offset;
+};
+
+struct ArenaStats
+{
+    size_t reserved;
+    size_t committed;
+    size_t used;
+    size_t high_water;
+};
+
+Arena make_arena(size_t reserve_size);
 void destroy_arena(Arena *arena);
 void *arena_alloc_raw(Arena *arena, size_t size, size_t align);
 void *arena_alloc_zero_raw(Arena *arena, size_t size, size_t align);
 void arena_reset(Arena* arena);
+ArenaTemp arena_temp_begin(Arena *arena);
+void arena_temp_end(ArenaTemp temp);
+ArenaStats arena_get_stats(const Arena *arena);
 
 #define arena_alloc(arena, Type) \
     (Type *)arena_alloc_raw((arena), sizeof(Type), alignof(Type))
 
 #define arena_alloc_array(arena, Type, Count) \
-    (Typ e*)arena_alloc_raw((arena), (Count) * sizeof(Type), alignof(Type))
+    (Type *)arena_alloc_raw((arena), (Count) * sizeof(Type), alignof(Type))
 
 #define arena_alloc_zero(arena, Type) \
     (Type *)arena_alloc_zero_raw((arena), sizeof(Type), alignof(Type))
@@ -1,4 +1,9 @@
 #include "arena.cpp"
 #include "lin_math.cpp"
+#include "lin_math_array.cpp"
 #include "print_helpers.cpp"
 #include "random.cpp"
+#include "rect_pack.cpp"
+#include "slot_map.cpp"
+#include "thread_pool.cpp"
+#include "util.cpp"
@@ -1,6 +1,10 @@
 #include "arena.hpp"
 #include "lin_math.hpp"
+#include "lin_math_array.hpp"
 #include "print_helpers.hpp"
 #include "random.hpp"
+#include "rect_pack.hpp"
+#include "slot_map.hpp"
+#include "thread_pool.hpp"
 #include "types.hpp"
 #include "util.hpp"
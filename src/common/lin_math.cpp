@@ -2,6 +2,9 @@
 
 #include <cmath>
 
+#include "lin_math_simd.hpp"
+#include "util.hpp"
+
 v3 v3_normalize(v3 v)
 {
     f32 mag = sqrtf(v.x*v.x + v.y*v.y + v.z*v.z);
@@ -80,7 +83,7 @@ m4 m4_scale(v3 scale)
 
 // --------------------------------------------
 
-m4 m4_mul(m4 a, m4 b)
+m4 m4_mul_scalar(m4 a, m4 b)
 {
     m4 m;
     for (int col = 0; col < 4; col++)
@@ -97,6 +100,85 @@ m4 m4_mul(m4 a, m4 b)
     return m;
 }
 
+v4 m4_mul_v4_scalar(m4 m, v4 v)
+{
+    v4 result;
+    for (int row = 0; row < 4; row++)
+    {
+        result.d[row] = 0.0f;
+        for (int k = 0; k < 4; k++)
+        {
+            result.d[row] += m.d[k * 4 + row] * v.d[k];
+        }
+    }
+    return result;
+}
+
+m4 m4_transpose_scalar(m4 m)
+{
+    m4 t;
+    for (int col = 0; col < 4; col++)
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            t.d[row * 4 + col] = m.d[col * 4 + row];
+        }
+    }
+    return t;
+}
+
+/*
+ * Cofactors from 2x2 sub-determinants of the first two (s) and last two (c) columns.
+ * Written so every output is +-(x*p - y*q + z*r) * inv_det, which is what the SIMD path
+ * computes per lane, with the sign applied at the end.
+ */
+m4 m4_inverse_scalar(m4 m)
+{
+    const f32 *d = m.d;
+
+    f32 s[6], c[6];
+    s[0] = d[0]*d[5] - d[4]*d[1];
+    s[1] = d[0]*d[6] - d[4]*d[2];
+    s[2] = d[0]*d[7] - d[4]*d[3];
+    s[3] = d[1]*d[6] - d[5]*d[2];
+    s[4] = d[1]*d[7] - d[5]*d[3];
+    s[5] = d[2]*d[7] - d[6]*d[3];
+
+    c[0] = d[8]*d[13] - d[12]*d[9];
+    c[1] = d[8]*d[14] - d[12]*d[10];
+    c[2] = d[8]*d[15] - d[12]*d[11];
+    c[3] = d[9]*d[14] - d[13]*d[10];
+    c[4] = d[9]*d[15] - d[13]*d[11];
+    c[5] = d[10]*d[15] - d[14]*d[11];
+
+    f32 det = s[0]*c[5] - s[1]*c[4] + s[2]*c[3] + s[3]*c[2] - s[4]*c[1] + s[5]*c[0];
+    f32 inv_det = 1.0f / det;
+    f32 pos = inv_det;
+    f32 neg = -inv_det;
+
+    m4 r;
+    r.d[0]  = (d[5]*c[5]  - d[6]*c[4]  + d[7]*c[3])  * pos;
+    r.d[1]  = (d[1]*c[5]  - d[2]*c[4]  + d[3]*c[3])  * neg;
+    r.d[2]  = (d[13]*s[5] - d[14]*s[4] + d[15]*s[3]) * pos;
+    r.d[3]  = (d[9]*s[5]  - d[10]*s[4] + d[11]*s[3]) * neg;
+
+    r.d[4]  = (d[4]*c[5]  - d[6]*c[2]  + d[7]*c[1])  * neg;
+    r.d[5]  = (d[0]*c[5]  - d[2]*c[2]  + d[3]*c[1])  * pos;
+    r.d[6]  = (d[12]*s[5] - d[14]*s[2] + d[15]*s[1]) * neg;
+    r.d[7]  = (d[8]*s[5]  - d[10]*s[2] + d[11]*s[1]) * pos;
+
+    r.d[8]  = (d[4]*c[4]  - d[5]*c[2]  + d[7]*c[0])  * pos;
+    r.d[9]  = (d[0]*c[4]  - d[1]*c[2]  + d[3]*c[0])  * neg;
+    r.d[10] = (d[12]*s[4] - d[13]*s[2] + d[15]*s[0]) * pos;
+    r.d[11] = (d[8]*s[4]  - d[9]*s[2]  + d[11]*s[0]) * neg;
+
+    r.d[12] = (d[4]*c[3]  - d[5]*c[1]  + d[6]*c[0])  * neg;
+    r.d[13] = (d[0]*c[3]  - d[1]*c[1]  + d[2]*c[0])  * pos;
+    r.d[14] = (d[12]*s[3] - d[13]*s[1] + d[14]*s[0]) * neg;
+    r.d[15] = (d[8]*s[3]  - d[9]*s[1]  + d[10]*s[0]) * pos;
+    return r;
+}
+
 // --------------------------------------------
 
 m4 m4_proj_ortho(f32 left, f32 right, f32 bottom, f32 top, f32 near, f32 far)
@@ -145,7 +227,7 @@ m4 m4_proj_perspective(f32 fov, f32 aspect, f32 znear, f32 zfar)
 
 // --------------------------------------------
 
-m4 m4_look_at(v3 eye, v3 target, v3 up)
+m4 m4_look_at_scalar(v3 eye, v3 target, v3 up)
 {
     v3 f = v3_normalize(v3_sub(target, eye));
     v3 r = v3_normalize(v3_cross(f, up));
@@ -174,3 +256,299 @@ m4 m4_look_at(v3 eye, v3 target, v3 up)
 
     return m;
 }
+
+// ==================== SIMD ====================
+
+#if LIN_MATH_SSE || LIN_MATH_NEON
+
+// ((x*x + y*y) + z*z) in every lane, same order as the scalar dot
+static inline f32x4 f32x4_dot3(f32x4 a, f32x4 b)
+{
+    f32x4 p = f32x4_mul(a, b);
+    f32x4 sum = f32x4_add(f32x4_broadcast(p, 0), f32x4_broadcast(p, 1));
+    return f32x4_add(sum, f32x4_broadcast(p, 2));
+}
+
+static inline f32x4 f32x4_cross3(f32x4 a, f32x4 b)
+{
+    f32x4 a_yzx = f32x4_shuffle(a, 1, 2, 0, 3);
+    f32x4 a_zxy = f32x4_shuffle(a, 2, 0, 1, 3);
+    f32x4 b_yzx = f32x4_shuffle(b, 1, 2, 0, 3);
+    f32x4 b_zxy = f32x4_shuffle(b, 2, 0, 1, 3);
+    return f32x4_sub(f32x4_mul(a_yzx, b_zxy), f32x4_mul(a_zxy, b_yzx));
+}
+
+static inline f32x4 f32x4_normalize3(f32x4 v)
+{
+    f32x4 mag = f32x4_sqrt(f32x4_dot3(v, v));
+    if (f32x4_first(mag) == 0.0f) return f32x4_zero();
+    f32x4 i_mag = f32x4_div(f32x4_set1(1.0f), mag);
+    return f32x4_mul(v, i_mag);
+}
+
+m4 m4_mul(m4 a, m4 b)
+{
+    f32x4 cols[4] = { f32x4_load(&a.d[0]), f32x4_load(&a.d[4]), f32x4_load(&a.d[8]), f32x4_load(&a.d[12]) };
+    m4 m;
+    for (int col = 0; col < 4; col++)
+    {
+        f32x4_store(&m.d[col * 4], f32x4_mul_col(cols, &b.d[col * 4]));
+    }
+    return m;
+}
+
+v4 m4_mul_v4(m4 m, v4 v)
+{
+    f32x4 cols[4] = { f32x4_load(&m.d[0]), f32x4_load(&m.d[4]), f32x4_load(&m.d[8]), f32x4_load(&m.d[12]) };
+    v4 result;
+    f32x4_store(result.d, f32x4_mul_col(cols, v.d));
+    return result;
+}
+
+void m4_mul_broadcast(m4 lhs, const m4 *rhs, m4 *out, u32 count)
+{
+    f32x4 cols[4] = { f32x4_load(&lhs.d[0]), f32x4_load(&lhs.d[4]), f32x4_load(&lhs.d[8]), f32x4_load(&lhs.d[12]) };
+    for (u32 i = 0; i < count; i++)
+    {
+        f32x4 c0 = f32x4_mul_col(cols, &rhs[i].d[0]);
+        f32x4 c1 = f32x4_mul_col(cols, &rhs[i].d[4]);
+        f32x4 c2 = f32x4_mul_col(cols, &rhs[i].d[8]);
+        f32x4 c3 = f32x4_mul_col(cols, &rhs[i].d[12]);
+        f32x4_store(&out[i].d[0], c0);
+        f32x4_store(&out[i].d[4], c1);
+        f32x4_store(&out[i].d[8], c2);
+        f32x4_store(&out[i].d[12], c3);
+    }
+}
+
+void m4_mul_v4_array(m4 m, const v4 *in, v4 *out, u32 count)
+{
+    f32x4 cols[4] = { f32x4_load(&m.d[0]), f32x4_load(&m.d[4]), f32x4_load(&m.d[8]), f32x4_load(&m.d[12]) };
+    for (u32 i = 0; i < count; i++)
+    {
+        f32x4_store(out[i].d, f32x4_mul_col(cols, in[i].d));
+    }
+}
+
+m4 m4_transpose(m4 m)
+{
+    f32x4 c0 = f32x4_load(&m.d[0]);
+    f32x4 c1 = f32x4_load(&m.d[4]);
+    f32x4 c2 = f32x4_load(&m.d[8]);
+    f32x4 c3 = f32x4_load(&m.d[12]);
+    f32x4_transpose(&c0, &c1, &c2, &c3);
+    m4 t;
+    f32x4_store(&t.d[0], c0);
+    f32x4_store(&t.d[4], c1);
+    f32x4_store(&t.d[8], c2);
+    f32x4_store(&t.d[12], c3);
+    return t;
+}
+
+// See m4_inverse_scalar for the lane layout
+m4 m4_inverse(m4 m)
+{
+    f32x4 c0 = f32x4_load(&m.d[0]);
+    f32x4 c1 = f32x4_load(&m.d[4]);
+    f32x4 c2 = f32x4_load(&m.d[8]);
+    f32x4 c3 = f32x4_load(&m.d[12]);
+
+    // s[0..3], s[4..5] and c[0..3], c[4..5]
+    f32x4 s_lo = f32x4_sub(f32x4_mul(f32x4_shuffle(c0, 0, 0, 0, 1), f32x4_shuffle(c1, 1, 2, 3, 2)),
+                           f32x4_mul(f32x4_shuffle(c1, 0, 0, 0, 1), f32x4_shuffle(c0, 1, 2, 3, 2)));
+    f32x4 s_hi = f32x4_sub(f32x4_mul(f32x4_shuffle(c0, 1, 2, 1, 2), f32x4_broadcast(c1, 3)),
+                           f32x4_mul(f32x4_shuffle(c1, 1, 2, 1, 2), f32x4_broadcast(c0, 3)));
+    f32x4 c_lo = f32x4_sub(f32x4_mul(f32x4_shuffle(c2, 0, 0, 0, 1), f32x4_shuffle(c3, 1, 2, 3, 2)),
+                           f32x4_mul(f32x4_shuffle(c3, 0, 0, 0, 1), f32x4_shuffle(c2, 1, 2, 3, 2)));
+    f32x4 c_hi = f32x4_sub(f32x4_mul(f32x4_shuffle(c2, 1, 2, 1, 2), f32x4_broadcast(c3, 3)),
+                           f32x4_mul(f32x4_shuffle(c3, 1, 2, 1, 2), f32x4_broadcast(c2, 3)));
+
+    f32 s[8], c[8];
+    f32x4_store(&s[0], s_lo);
+    f32x4_store(&s[4], s_hi);
+    f32x4_store(&c[0], c_lo);
+    f32x4_store(&c[4], c_hi);
+    f32 det = s[0]*c[5] - s[1]*c[4] + s[2]*c[3] + s[3]*c[2] - s[4]*c[1] + s[5]*c[0];
+    f32 inv_det = 1.0f / det;
+    f32x4 sign_even = f32x4_set(inv_det, -inv_det, inv_det, -inv_det);
+    f32x4 sign_odd = f32x4_set(-inv_det, inv_det, -inv_det, inv_det);
+
+    // Lanes (c[k], c[k], s[k], s[k])
+    f32x4 cs0 = f32x4_shuffle2(c_lo, s_lo, 0, 0, 0, 0);
+    f32x4 cs1 = f32x4_shuffle2(c_lo, s_lo, 1, 1, 1, 1);
+    f32x4 cs2 = f32x4_shuffle2(c_lo, s_lo, 2, 2, 2, 2);
+    f32x4 cs3 = f32x4_shuffle2(c_lo, s_lo, 3, 3, 3, 3);
+    f32x4 cs4 = f32x4_shuffle2(c_hi, s_hi, 0, 0, 0, 0);
+    f32x4 cs5 = f32x4_shuffle2(c_hi, s_hi, 1, 1, 1, 1);
+
+    // Rows of m with lanes swapped pairwise: row r is (d[4+r], d[r], d[12+r], d[8+r])
+    f32x4_transpose(&c0, &c1, &c2, &c3);
+    f32x4 r0 = f32x4_shuffle(c0, 1, 0, 3, 2);
+    f32x4 r1 = f32x4_shuffle(c1, 1, 0, 3, 2);
+    f32x4 r2 = f32x4_shuffle(c2, 1, 0, 3, 2);
+    f32x4 r3 = f32x4_shuffle(c3, 1, 0, 3, 2);
+
+    f32x4 col0 = f32x4_add(f32x4_sub(f32x4_mul(r1, cs5), f32x4_mul(r2, cs4)), f32x4_mul(r3, cs3));
+    f32x4 col1 = f32x4_add(f32x4_sub(f32x4_mul(r0, cs5), f32x4_mul(r2, cs2)), f32x4_mul(r3, cs1));
+    f32x4 col2 = f32x4_add(f32x4_sub(f32x4_mul(r0, cs4), f32x4_mul(r1, cs2)), f32x4_mul(r3, cs0));
+    f32x4 col3 = f32x4_add(f32x4_sub(f32x4_mul(r0, cs3), f32x4_mul(r1, cs1)), f32x4_mul(r2, cs0));
+
+    m4 r;
+    f32x4_store(&r.d[0], f32x4_mul(col0, sign_even));
+    f32x4_store(&r.d[4], f32x4_mul(col1, sign_odd));
+    f32x4_store(&r.d[8], f32x4_mul(col2, sign_even));
+    f32x4_store(&r.d[12], f32x4_mul(col3, sign_odd));
+    return r;
+}
+
+m4 m4_look_at(v3 eye, v3 target, v3 up)
+{
+    f32x4 e = f32x4_set(eye.x, eye.y, eye.z, 0.0f);
+    f32x4 t = f32x4_set(target.x, target.y, target.z, 0.0f);
+    f32x4 u0 = f32x4_set(up.x, up.y, up.z, 0.0f);
+
+    f32x4 f = f32x4_normalize3(f32x4_sub(t, e));
+    f32x4 r = f32x4_normalize3(f32x4_cross3(f, u0));
+    f32x4 u = f32x4_cross3(r, f);
+
+    // Build the rows (r, -r.eye), (u, -u.eye), (-f, f.eye), (0, 0, 0, 1) and transpose into columns
+    // Negate by multiplying, like the scalar unary minus it keeps -0 for zero lanes
+    f32x4 neg_f = f32x4_mul(f, f32x4_set1(-1.0f));
+    f32x4 dots = f32x4_set(-f32x4_first(f32x4_dot3(r, e)), -f32x4_first(f32x4_dot3(u, e)), f32x4_first(f32x4_dot3(f, e)), 1.0f);
+    f32x4 row0 = f32x4_shuffle2(r, f32x4_shuffle2(r, dots, 2, 2, 0, 0), 0, 1, 0, 2);
+    f32x4 row1 = f32x4_shuffle2(u, f32x4_shuffle2(u, dots, 2, 2, 1, 1), 0, 1, 0, 2);
+    f32x4 row2 = f32x4_shuffle2(neg_f, f32x4_shuffle2(neg_f, dots, 2, 2, 2, 2), 0, 1, 0, 2);
+    f32x4 row3 = f32x4_set(0.0f, 0.0f, 0.0f, 1.0f);
+    f32x4_transpose(&row0, &row1, &row2, &row3);
+
+    m4 m;
+    f32x4_store(&m.d[0], row0);
+    f32x4_store(&m.d[4], row1);
+    f32x4_store(&m.d[8], row2);
+    f32x4_store(&m.d[12], row3);
+    return m;
+}
+
+const char *lin_math_simd_name()
+{
+#if LIN_MATH_SSE
+    return "SSE";
+#else
+    return "NEON";
+#endif
+}
+
+#else
+
+m4 m4_mul(m4 a, m4 b) { return m4_mul_scalar(a, b); }
+v4 m4_mul_v4(m4 m, v4 v) { return m4_mul_v4_scalar(m, v); }
+m4 m4_transpose(m4 m) { return m4_transpose_scalar(m); }
+m4 m4_inverse(m4 m) { return m4_inverse_scalar(m); }
+m4 m4_look_at(v3 eye, v3 target, v3 up) { return m4_look_at_scalar(eye, target, up); }
+
+void m4_mul_broadcast(m4 lhs, const m4 *rhs, m4 *out, u32 count)
+{
+    for (u32 i = 0; i < count; i++) out[i] = m4_mul_scalar(lhs, rhs[i]);
+}
+
+void m4_mul_v4_array(m4 m, const v4 *in, v4 *out, u32 count)
+{
+    for (u32 i = 0; i < count; i++) out[i] = m4_mul_v4_scalar(m, in[i]);
+}
+
+const char *lin_math_simd_name()
+{
+    return "scalar";
+}
+
+#endif
+
+static bool lin_math_check_m4(const char *name, m4 simd, m4 scalar)
+{
+    if (memcmp(&simd, &scalar, sizeof(m4)) == 0) return true;
+    for (int i = 0; i < 16; i++)
+    {
+        if (memcmp(&simd.d[i], &scalar.d[i], sizeof(f32)) != 0)
+        {
+            warning("%s (%s) differs from scalar at [%d]: %.9g vs %.9g", name, lin_math_simd_name(), i, simd.d[i], scalar.d[i]);
+            break;
+        }
+    }
+    return false;
+}
+
+bool lin_math_simd_self_check()
+{
+    m4 inputs[8];
+    inputs[0] = m4_identity();
+    inputs[1] = m4_translate(1.5f, -2.25f, 10.0f);
+    inputs[2] = m4_rotate(0.7f, V3(0.3f, 1.0f, -0.2f));
+    inputs[3] = m4_scale(V3(2.0f, 0.5f, -3.0f));
+    inputs[4] = m4_proj_perspective(deg_to_rad(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    inputs[5] = m4_proj_ortho(-4.0f, 4.0f, -3.0f, 3.0f, 0.1f, 50.0f);
+    inputs[6] = m4_look_at_scalar(V3(3.0f, 2.0f, 5.0f), V3(0.0f, 0.5f, 0.0f), V3(0.0f, 1.0f, 0.0f));
+    u32 state = 0x9e3779b9u;
+    for (int i = 0; i < 16; i++)
+    {
+        state = state * 1664525u + 1013904223u;
+        inputs[7].d[i] = (f32)(state >> 8) / (f32)(1u << 24) * 4.0f - 2.0f;
+    }
+
+    bool ok = true;
+    for (u32 i = 0; i < array_count(inputs); i++)
+    {
+        for (u32 j = 0; j < array_count(inputs); j++)
+        {
+            ok &= lin_math_check_m4("m4_mul", m4_mul(inputs[i], inputs[j]), m4_mul_scalar(inputs[i], inputs[j]));
+        }
+        ok &= lin_math_check_m4("m4_transpose", m4_transpose(inputs[i]), m4_transpose_scalar(inputs[i]));
+        ok &= lin_math_check_m4("m4_inverse", m4_inverse(inputs[i]), m4_inverse_scalar(inputs[i]));
+
+        v4 v = V4(0.25f * i, -1.0f, 3.5f, 1.0f);
+        v4 simd_v = m4_mul_v4(inputs[i], v);
+        v4 scalar_v = m4_mul_v4_scalar(inputs[i], v);
+        if (memcmp(&simd_v, &scalar_v, sizeof(v4)) != 0)
+        {
+            warning("m4_mul_v4 (%s) differs from scalar for input %u", lin_math_simd_name(), i);
+            ok = false;
+        }
+    }
+
+    ok &= lin_math_check_m4("m4_look_at",
+        m4_look_at(V3(3.0f, 2.0f, 5.0f), V3(0.0f, 0.5f, 0.0f), V3(0.0f, 1.0f, 0.0f)),
+        m4_look_at_scalar(V3(3.0f, 2.0f, 5.0f), V3(0.0f, 0.5f, 0.0f), V3(0.0f, 1.0f, 0.0f)));
+    ok &= lin_math_check_m4("m4_look_at",
+        m4_look_at(V3(-1.0f, 7.0f, 0.5f), V3(4.0f, -2.0f, 3.0f), V3(0.2f, 0.9f, 0.1f)),
+        m4_look_at_scalar(V3(-1.0f, 7.0f, 0.5f), V3(4.0f, -2.0f, 3.0f), V3(0.2f, 0.9f, 0.1f)));
+    return ok;
+}
+
+// --------------------------------------------
+
+void m4_frustum_planes(m4 view_proj, v4 out_planes[6])
+{
+    // Gribb-Hartmann: planes are sums/differences of the 4th row with the other rows
+    const f32 *d = view_proj.d;
+    for (int i = 0; i < 3; i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            f32 row_w = d[c * 4 + 3];
+            f32 row_i = d[c * 4 + i];
+            out_planes[i * 2 + 0].d[c] = row_w + row_i;
+            out_planes[i * 2 + 1].d[c] = row_w - row_i;
+        }
+    }
+
+    for (int i = 0; i < 6; i++)
+    {
+        v4 *p = &out_planes[i];
+        f32 mag = sqrtf(p->x*p->x + p->y*p->y + p->z*p->z);
+        if (mag == 0.0f) continue;
+        f32 i_mag = 1.0f / mag;
+        p->x *= i_mag;
+        p->y *= i_mag;
+        p->z *= i_mag;
+        p->w *= i_mag;
+    }
+}
@@ -95,8 +95,51 @@ m4 m4_rotate(float angle_rad, v3 axis);
 m4 m4_scale(v3 scale);
 
 m4 m4_mul(m4 a, m4 b);
+v4 m4_mul_v4(m4 m, v4 v);
+m4 m4_transpose(m4 m);
+m4 m4_inverse(m4 m); // singular matrices produce inf/nan
+
+// Batched with one shared operand: out[i] = lhs * rhs[i], out[i] = m * in[i]. Out may alias the input array.
+// Pairwise products are m4_array_mul in lin_math_array.hpp.
+void m4_mul_broadcast(m4 lhs, const m4 *rhs, m4 *out, u32 count);
+void m4_mul_v4_array(m4 m, const v4 *in, v4 *out, u32 count);
 
 m4 m4_proj_ortho(f32 left, f32 right, f32 bottom, f32 top, f32 near, f32 far);
 m4 m4_proj_perspective(f32 fov, f32 aspect, f32 znear, f32 zfar);
 
 m4 m4_look_at(v3 eye, v3 target, v3 up);
+
+// --------------------------------------------
+
+/*
+ * The functions above use SSE or NEON when available (LIN_MATH_NO_SIMD forces scalar).
+ * The SIMD paths do the same operations in the same order as the scalar references, so
+ * results match bit for bit as long as the compiler doesn't contract mul+add into fma.
+ */
+m4 m4_mul_scalar(m4 a, m4 b);
+v4 m4_mul_v4_scalar(m4 m, v4 v);
+m4 m4_transpose_scalar(m4 m);
+m4 m4_inverse_scalar(m4 m);
+m4 m4_look_at_scalar(v3 eye, v3 target, v3 up);
+
+const char *lin_math_simd_name();
+// Compares SIMD against scalar on a fixed set of inputs, warns on the first mismatch
+bool lin_math_simd_self_check();
+
+// --------------------------------------------
+
+/*
+ * Frustum planes as (normal.xyz, distance.w), normals pointing inwards and normalized.
+ * Order: left, right, bottom, top, near, far
+ */
+void m4_frustum_planes(m4 view_proj, v4 out_planes[6]);
+
+static inline bool sphere_in_frustum(const v4 planes[6], v3 center, f32 radius)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        f32 dist = planes[i].x*center.x + planes[i].y*center.y + planes[i].z*center.z + planes[i].w;
+        if (dist < -radius) return false;
+    }
+    return true;
+}
@@ -0,0 +1,404 @@
+#include "lin_math_array.hpp"
+
+#include <cmath>
+#include <ctime>
+
+#include "lin_math.hpp"
+#include "lin_math_simd.hpp"
+#include "util.hpp"
+
+V3Array make_v3_array(Arena *arena, u32 capacity)
+{
+    V3Array array = {};
+    array.capacity = capacity;
+    array.x = (f32 *)arena_alloc_raw(arena, capacity * sizeof(f32), 16);
+    array.y = (f32 *)arena_alloc_raw(arena, capacity * sizeof(f32), 16);
+    array.z = (f32 *)arena_alloc_raw(arena, capacity * sizeof(f32), 16);
+    return array;
+}
+
+// ==================== SCALAR ====================
+
+static inline void transform_point_scalar(const m4 *m, f32 x, f32 y, f32 z, f32 *out_x, f32 *out_y, f32 *out_z)
+{
+    const f32 *d = m->d;
+    *out_x = d[0]*x + d[4]*y + d[8]*z + d[12];
+    *out_y = d[1]*x + d[5]*y + d[9]*z + d[13];
+    *out_z = d[2]*x + d[6]*y + d[10]*z + d[14];
+}
+
+static inline f32 min_scalar(f32 a, f32 b) { return a < b ? a : b; }
+static inline f32 max_scalar(f32 a, f32 b) { return a > b ? a : b; }
+
+static inline void aabb_transform_scalar(const m4 *m, const f32 mn[3], const f32 mx[3], f32 out_mn[3], f32 out_mx[3])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        f32 lo = m->d[12 + i];
+        f32 hi = m->d[12 + i];
+        for (int j = 0; j < 3; j++)
+        {
+            f32 a = m->d[j * 4 + i] * mn[j];
+            f32 b = m->d[j * 4 + i] * mx[j];
+            lo = lo + min_scalar(a, b);
+            hi = hi + max_scalar(a, b);
+        }
+        out_mn[i] = lo;
+        out_mx[i] = hi;
+    }
+}
+
+static void v3_array_transform_points_range(const m4 *m, const V3Array *in, V3Array *out, u32 start)
+{
+    for (u32 i = start; i < in->count; i++)
+    {
+        transform_point_scalar(m, in->x[i], in->y[i], in->z[i], &out->x[i], &out->y[i], &out->z[i]);
+    }
+}
+
+static void v3_array_normalize_range(V3Array *array, u32 start)
+{
+    for (u32 i = start; i < array->count; i++)
+    {
+        v3 n = v3_normalize(v3_array_get(array, i));
+        array->x[i] = n.x;
+        array->y[i] = n.y;
+        array->z[i] = n.z;
+    }
+}
+
+static void aabb_array_transform_range(const m4 *m, const V3Array *in_min, const V3Array *in_max, V3Array *out_min, V3Array *out_max, u32 start)
+{
+    for (u32 i = start; i < in_min->count; i++)
+    {
+        f32 mn[3] = { in_min->x[i], in_min->y[i], in_min->z[i] };
+        f32 mx[3] = { in_max->x[i], in_max->y[i], in_max->z[i] };
+        f32 out_mn[3], out_mx[3];
+        aabb_transform_scalar(m, mn, mx, out_mn, out_mx);
+        out_min->x[i] = out_mn[0]; out_min->y[i] = out_mn[1]; out_min->z[i] = out_mn[2];
+        out_max->x[i] = out_mx[0]; out_max->y[i] = out_mx[1]; out_max->z[i] = out_mx[2];
+    }
+}
+
+void v3_array_transform_points_scalar(m4 m, const V3Array *in, V3Array *out)
+{
+    bassert(out->capacity >= in->count);
+    v3_array_transform_points_range(&m, in, out, 0);
+    out->count = in->count;
+}
+
+void v3_array_normalize_scalar(V3Array *array)
+{
+    v3_array_normalize_range(array, 0);
+}
+
+void m4_array_mul_scalar(const m4 *a, const m4 *b, m4 *out, u32 count)
+{
+    for (u32 i = 0; i < count; i++) out[i] = m4_mul_scalar(a[i], b[i]);
+}
+
+void aabb_array_transform_scalar(m4 m, const V3Array *in_min, const V3Array *in_max, V3Array *out_min, V3Array *out_max)
+{
+    bassert(in_min->count == in_max->count);
+    bassert(out_min->capacity >= in_min->count && out_max->capacity >= in_min->count);
+    aabb_array_transform_range(&m, in_min, in_max, out_min, out_max, 0);
+    out_min->count = in_min->count;
+    out_max->count = in_min->count;
+}
+
+// ==================== SIMD ====================
+
+#if LIN_MATH_SSE || LIN_MATH_NEON
+
+// Four elements per iteration, matrix entries broadcast once; the tail goes through the scalar path
+void v3_array_transform_points(m4 m, const V3Array *in, V3Array *out)
+{
+    bassert(out->capacity >= in->count);
+    f32x4 d[16];
+    for (int i = 0; i < 16; i++) d[i] = f32x4_set1(m.d[i]);
+
+    u32 simd_count = in->count & ~3u;
+    for (u32 i = 0; i < simd_count; i += 4)
+    {
+        f32x4 x = f32x4_load(&in->x[i]);
+        f32x4 y = f32x4_load(&in->y[i]);
+        f32x4 z = f32x4_load(&in->z[i]);
+        f32x4 ox = f32x4_add(f32x4_add(f32x4_add(f32x4_mul(d[0], x), f32x4_mul(d[4], y)), f32x4_mul(d[8], z)), d[12]);
+        f32x4 oy = f32x4_add(f32x4_add(f32x4_add(f32x4_mul(d[1], x), f32x4_mul(d[5], y)), f32x4_mul(d[9], z)), d[13]);
+        f32x4 oz = f32x4_add(f32x4_add(f32x4_add(f32x4_mul(d[2], x), f32x4_mul(d[6], y)), f32x4_mul(d[10], z)), d[14]);
+        f32x4_store(&out->x[i], ox);
+        f32x4_store(&out->y[i], oy);
+        f32x4_store(&out->z[i], oz);
+    }
+    v3_array_transform_points_range(&m, in, out, simd_count);
+    out->count = in->count;
+}
+
+void v3_array_normalize(V3Array *array)
+{
+    f32x4 one = f32x4_set1(1.0f);
+    u32 simd_count = array->count & ~3u;
+    for (u32 i = 0; i < simd_count; i += 4)
+    {
+        f32x4 x = f32x4_load(&array->x[i]);
+        f32x4 y = f32x4_load(&array->y[i]);
+        f32x4 z = f32x4_load(&array->z[i]);
+        f32x4 mag = f32x4_sqrt(f32x4_add(f32x4_add(f32x4_mul(x, x), f32x4_mul(y, y)), f32x4_mul(z, z)));
+        f32x4 i_mag = f32x4_div(one, mag);
+        f32x4_store(&array->x[i], f32x4_clear_where_zero(f32x4_mul(x, i_mag), mag));
+        f32x4_store(&array->y[i], f32x4_clear_where_zero(f32x4_mul(y, i_mag), mag));
+        f32x4_store(&array->z[i], f32x4_clear_where_zero(f32x4_mul(z, i_mag), mag));
+    }
+    v3_array_normalize_range(array, simd_count);
+}
+
+void m4_array_mul(const m4 *a, const m4 *b, m4 *out, u32 count)
+{
+    for (u32 i = 0; i < count; i++)
+    {
+        f32x4 cols[4] = { f32x4_load(&a[i].d[0]), f32x4_load(&a[i].d[4]), f32x4_load(&a[i].d[8]), f32x4_load(&a[i].d[12]) };
+        f32x4 c0 = f32x4_mul_col(cols, &b[i].d[0]);
+        f32x4 c1 = f32x4_mul_col(cols, &b[i].d[4]);
+        f32x4 c2 = f32x4_mul_col(cols, &b[i].d[8]);
+        f32x4 c3 = f32x4_mul_col(cols, &b[i].d[12]);
+        f32x4_store(&out[i].d[0], c0);
+        f32x4_store(&out[i].d[4], c1);
+        f32x4_store(&out[i].d[8], c2);
+        f32x4_store(&out[i].d[12], c3);
+    }
+}
+
+void aabb_array_transform(m4 m, const V3Array *in_min, const V3Array *in_max, V3Array *out_min, V3Array *out_max)
+{
+    bassert(in_min->count == in_max->count);
+    bassert(out_min->capacity >= in_min->count && out_max->capacity >= in_min->count);
+    f32x4 d[16];
+    for (int i = 0; i < 16; i++) d[i] = f32x4_set1(m.d[i]);
+
+    u32 simd_count = in_min->count & ~3u;
+    for (u32 i = 0; i < simd_count; i += 4)
+    {
+        f32x4 mn[3] = { f32x4_load(&in_min->x[i]), f32x4_load(&in_min->y[i]), f32x4_load(&in_min->z[i]) };
+        f32x4 mx[3] = { f32x4_load(&in_max->x[i]), f32x4_load(&in_max->y[i]), f32x4_load(&in_max->z[i]) };
+        f32x4 lo[3], hi[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            lo[axis] = d[12 + axis];
+            hi[axis] = d[12 + axis];
+            for (int j = 0; j < 3; j++)
+            {
+                f32x4 a = f32x4_mul(d[j * 4 + axis], mn[j]);
+                f32x4 b = f32x4_mul(d[j * 4 + axis], mx[j]);
+                lo[axis] = f32x4_add(lo[axis], f32x4_min(a, b));
+                hi[axis] = f32x4_add(hi[axis], f32x4_max(a, b));
+            }
+        }
+        f32x4_store(&out_min->x[i], lo[0]); f32x4_store(&out_min->y[i], lo[1]); f32x4_store(&out_min->z[i], lo[2]);
+        f32x4_store(&out_max->x[i], hi[0]); f32x4_store(&out_max->y[i], hi[1]); f32x4_store(&out_max->z[i], hi[2]);
+    }
+    aabb_array_transform_range(&m, in_min, in_max, out_min, out_max, simd_count);
+    out_min->count = in_min->count;
+    out_max->count = in_min->count;
+}
+
+#else
+
+void v3_array_transform_points(m4 m, const V3Array *in, V3Array *out) { v3_array_transform_points_scalar(m, in, out); }
+void v3_array_normalize(V3Array *array) { v3_array_normalize_scalar(array); }
+void m4_array_mul(const m4 *a, const m4 *b, m4 *out, u32 count) { m4_array_mul_scalar(a, b, out, count); }
+
+void aabb_array_transform(m4 m, const V3Array *in_min, const V3Array *in_max, V3Array *out_min, V3Array *out_max)
+{
+    aabb_array_transform_scalar(m, in_min, in_max, out_min, out_max);
+}
+
+#endif
+
+// ==================== CHECKS ====================
+
+static f32 lin_math_array_next_f32(u32 *state, f32 lo, f32 hi)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return lo + (f32)(*state >> 8) / (f32)(1u << 24) * (hi - lo);
+}
+
+static void lin_math_array_fill(V3Array *array, u32 count, u32 *state, f32 lo, f32 hi)
+{
+    array->count = 0;
+    for (u32 i = 0; i < count; i++)
+    {
+        f32 x = lin_math_array_next_f32(state, lo, hi);
+        f32 y = lin_math_array_next_f32(state, lo, hi);
+        f32 z = lin_math_array_next_f32(state, lo, hi);
+        v3_array_push(array, V3(x, y, z));
+    }
+}
+
+static bool lin_math_array_check_v3(const char *name, const V3Array *simd, const V3Array *scalar)
+{
+    for (u32 i = 0; i < scalar->count; i++)
+    {
+        if (memcmp(&simd->x[i], &scalar->x[i], sizeof(f32)) != 0 ||
+            memcmp(&simd->y[i], &scalar->y[i], sizeof(f32)) != 0 ||
+            memcmp(&simd->z[i], &scalar->z[i], sizeof(f32)) != 0)
+        {
+            warning("%s (%s) differs from scalar at [%u]", name, lin_math_simd_name(), i);
+            return false;
+        }
+    }
+    return true;
+}
+
+static m4 lin_math_array_make_m4(u32 *state)
+{
+    m4 m;
+    for (int i = 0; i < 16; i++) m.d[i] = lin_math_array_next_f32(state, -2.0f, 2.0f);
+    return m;
+}
+
+bool lin_math_array_self_check()
+{
+    const u32 count = 37;
+    Arena arena = make_arena(1 << 20);
+    u32 state = 0x2545f491u;
+
+    V3Array in = make_v3_array(&arena, count);
+    V3Array in_max = make_v3_array(&arena, count);
+    V3Array out_simd = make_v3_array(&arena, count);
+    V3Array out_scalar = make_v3_array(&arena, count);
+    V3Array out_max_simd = make_v3_array(&arena, count);
+    V3Array out_max_scalar = make_v3_array(&arena, count);
+    lin_math_array_fill(&in, count, &state, -10.0f, 10.0f);
+    // A zero vector for the normalize special case
+    in.x[5] = in.y[5] = in.z[5] = 0.0f;
+    in_max.count = count;
+    for (u32 i = 0; i < count; i++)
+    {
+        in_max.x[i] = in.x[i] + lin_math_array_next_f32(&state, 0.0f, 3.0f);
+        in_max.y[i] = in.y[i] + lin_math_array_next_f32(&state, 0.0f, 3.0f);
+        in_max.z[i] = in.z[i] + lin_math_array_next_f32(&state, 0.0f, 3.0f);
+    }
+
+    bool ok = true;
+    m4 m = m4_mul(m4_translate(1.5f, -2.0f, 4.0f), m4_rotate(0.9f, V3(0.2f, 1.0f, -0.4f)));
+
+    v3_array_transform_points(m, &in, &out_simd);
+    v3_array_transform_points_scalar(m, &in, &out_scalar);
+    ok &= lin_math_array_check_v3("v3_array_transform_points", &out_simd, &out_scalar);
+
+    aabb_array_transform(m, &in, &in_max, &out_simd, &out_max_simd);
+    aabb_array_transform_scalar(m, &in, &in_max, &out_scalar, &out_max_scalar);
+    ok &= lin_math_array_check_v3("aabb_array_transform", &out_simd, &out_scalar);
+    ok &= lin_math_array_check_v3("aabb_array_transform", &out_max_simd, &out_max_scalar);
+
+    for (u32 i = 0; i < count; i++)
+    {
+        out_simd.x[i] = out_scalar.x[i] = in.x[i];
+        out_simd.y[i] = out_scalar.y[i] = in.y[i];
+        out_simd.z[i] = out_scalar.z[i] = in.z[i];
+    }
+    out_simd.count = out_scalar.count = count;
+    v3_array_normalize(&out_simd);
+    v3_array_normalize_scalar(&out_scalar);
+    ok &= lin_math_array_check_v3("v3_array_normalize", &out_simd, &out_scalar);
+
+    m4 *a = arena_alloc_array(&arena, m4, count);
+    m4 *b = arena_alloc_array(&arena, m4, count);
+    m4 *mul_simd = arena_alloc_array(&arena, m4, count);
+    m4 *mul_scalar = arena_alloc_array(&arena, m4, count);
+    for (u32 i = 0; i < count; i++)
+    {
+        a[i] = lin_math_array_make_m4(&state);
+        b[i] = lin_math_array_make_m4(&state);
+    }
+    m4_array_mul(a, b, mul_simd, count);
+    m4_array_mul_scalar(a, b, mul_scalar, count);
+    if (memcmp(mul_simd, mul_scalar, count * sizeof(m4)) != 0)
+    {
+        warning("m4_array_mul (%s) differs from scalar", lin_math_simd_name());
+        ok = false;
+    }
+
+    destroy_arena(&arena);
+    return ok;
+}
+
+static f64 lin_math_array_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+}
+
+static void lin_math_array_print_rate(const char *name, u64 element_count, f64 simd_seconds, f64 scalar_seconds)
+{
+    f64 simd_rate = element_count / simd_seconds * 1e-6;
+    f64 scalar_rate = element_count / scalar_seconds * 1e-6;
+    printf("%-28s %10.1f M/s %10.1f M/s %6.2fx\n", name, simd_rate, scalar_rate, simd_rate / scalar_rate);
+}
+
+void lin_math_array_benchmark(u32 count, u32 iterations)
+{
+    Arena arena = make_arena((size_t)count * (12 * sizeof(f32) + 3 * sizeof(m4)) + (1 << 20));
+    u32 state = 0x6a09e667u;
+
+    V3Array in = make_v3_array(&arena, count);
+    V3Array in_max = make_v3_array(&arena, count);
+    V3Array out = make_v3_array(&arena, count);
+    V3Array out_max = make_v3_array(&arena, count);
+    lin_math_array_fill(&in, count, &state, -10.0f, 10.0f);
+    lin_math_array_fill(&in_max, count, &state, 10.0f, 20.0f);
+    m4 *a = arena_alloc_array(&arena, m4, count);
+    m4 *b = arena_alloc_array(&arena, m4, count);
+    m4 *mul_out = arena_alloc_array(&arena, m4, count);
+    for (u32 i = 0; i < count; i++)
+    {
+        a[i] = lin_math_array_make_m4(&state);
+        b[i] = lin_math_array_make_m4(&state);
+    }
+    m4 m = m4_mul(m4_translate(1.5f, -2.0f, 4.0f), m4_rotate(0.9f, V3(0.2f, 1.0f, -0.4f)));
+    u64 element_count = (u64)count * iterations;
+
+    printf("lin_math_array (%s), %u elements x %u iterations, one thread\n", lin_math_simd_name(), count, iterations);
+    printf("%-28s %14s %14s %7s\n", "kernel", "simd", "scalar", "speedup");
+
+    // Results feed a checksum so the loops can't be dropped
+    f32 checksum = 0.0f;
+    f64 start, simd_seconds, scalar_seconds;
+
+    start = lin_math_array_now();
+    for (u32 i = 0; i < iterations; i++) { v3_array_transform_points(m, &in, &out); checksum += out.x[i % count]; }
+    simd_seconds = lin_math_array_now() - start;
+    start = lin_math_array_now();
+    for (u32 i = 0; i < iterations; i++) { v3_array_transform_points_scalar(m, &in, &out); checksum += out.x[i % count]; }
+    scalar_seconds = lin_math_array_now() - start;
+    lin_math_array_print_rate("v3_array_transform_points", element_count, simd_seconds, scalar_seconds);
+
+    start = lin_math_array_now();
+    for (u32 i = 0; i < iterations; i++) { aabb_array_transform(m, &in, &in_max, &out, &out_max); checksum += out_max.y[i % count]; }
+    simd_seconds = lin_math_array_now() - start;
+    start = lin_math_array_now();
+    for (u32 i = 0; i < iterations; i++) { aabb_array_transform_scalar(m, &in, &in_max, &out, &out_max); checksum += out_max.y[i % count]; }
+    scalar_seconds = lin_math_array_now() - start;
+    lin_math_array_print_rate("aabb_array_transform", element_count, simd_seconds, scalar_seconds);
+
+    // In place; after the first pass the vectors are unit length, which costs the same
+    start = lin_math_array_now();
+    for (u32 i = 0; i < iterations; i++) { v3_array_normalize(&in_max); checksum += in_max.z[i % count]; }
+    simd_seconds = lin_math_array_now() - start;
+    start = lin_math_array_now();
+    for (u32 i = 0; i < iterations; i++) { v3_array_normalize_scalar(&in_max); checksum += in_max.z[i % count]; }
+    scalar_seconds = lin_math_array_now() - start;
+    lin_math_array_print_rate("v3_array_normalize", element_count, simd_seconds, scalar_seconds);
+
+    start = lin_math_array_now();
+    for (u32 i = 0; i < iterations; i++) { m4_array_mul(a, b, mul_out, count); checksum += mul_out[i % count].d[5]; }
+    simd_seconds = lin_math_array_now() - start;
+    start = lin_math_array_now();
+    for (u32 i = 0; i < iterations; i++) { m4_array_mul_scalar(a, b, mul_out, count); checksum += mul_out[i % count].d[5]; }
+    scalar_seconds = lin_math_array_now() - start;
+    lin_math_array_print_rate("m4_array_mul", element_count, simd_seconds, scalar_seconds);
+
+    printf("checksum %g\n", checksum);
+    destroy_arena(&arena);
+}
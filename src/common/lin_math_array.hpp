@@ -0,0 +1,56 @@
+#pragma once
+
+#include "arena.hpp"
+#include "types.hpp"
+#include "util.hpp"
+
+/*
+ * Kernels over many values at once, for per-frame vertex, particle and instance work.
+ * Positions are stored as structure-of-arrays so each SIMD lane holds a different element.
+ * Every kernel has a *_scalar reference with the same operation order; the SIMD
+ * versions match them bit for bit (see lin_math.hpp on fp contraction).
+ */
+
+struct V3Array
+{
+    f32 *x;
+    f32 *y;
+    f32 *z;
+    u32 count;
+    u32 capacity;
+};
+
+V3Array make_v3_array(Arena *arena, u32 capacity);
+
+static inline void v3_array_push(V3Array *array, v3 v)
+{
+    bassert(array->count < array->capacity);
+    u32 i = array->count++;
+    array->x[i] = v.x;
+    array->y[i] = v.y;
+    array->z[i] = v.z;
+}
+
+static inline v3 v3_array_get(const V3Array *array, u32 index)
+{
+    return V3(array->x[index], array->y[index], array->z[index]);
+}
+
+// out = m * (p, 1) with w dropped. out may be the same array as in.
+void v3_array_transform_points(m4 m, const V3Array *in, V3Array *out);
+void v3_array_normalize(V3Array *array);
+// out[i] = a[i] * b[i]; for one lhs shared by every element see m4_mul_broadcast
+void m4_array_mul(const m4 *a, const m4 *b, m4 *out, u32 count);
+// Tight world-space boxes of the transformed local boxes (Arvo). m must be affine.
+void aabb_array_transform(m4 m, const V3Array *in_min, const V3Array *in_max, V3Array *out_min, V3Array *out_max);
+
+void v3_array_transform_points_scalar(m4 m, const V3Array *in, V3Array *out);
+void v3_array_normalize_scalar(V3Array *array);
+void m4_array_mul_scalar(const m4 *a, const m4 *b, m4 *out, u32 count);
+void aabb_array_transform_scalar(m4 m, const V3Array *in_min, const V3Array *in_max, V3Array *out_min, V3Array *out_max);
+
+// Runs every kernel against its scalar reference on a fixed input, including a non-multiple-of-4 tail,
+// warns on the first mismatch
+bool lin_math_array_self_check();
+// Prints elements per second on the calling thread for each kernel and its scalar loop
+void lin_math_array_benchmark(u32 count, u32 iterations);
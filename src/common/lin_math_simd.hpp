@@ -0,0 +1,94 @@
+#pragma once
+
+// 4-lane float wrappers over SSE / NEON shared by the lin_math kernels.
+// Defines LIN_MATH_SSE or LIN_MATH_NEON when a SIMD path is available.
+
+#include "types.hpp"
+
+#if !defined(LIN_MATH_NO_SIMD) && (defined(__SSE__) || defined(_M_X64))
+#define LIN_MATH_SSE 1
+#include <xmmintrin.h>
+#elif !defined(LIN_MATH_NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+#define LIN_MATH_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if LIN_MATH_SSE
+
+typedef __m128 f32x4;
+#define f32x4_load(P) _mm_loadu_ps(P)
+#define f32x4_store(P, V) _mm_storeu_ps((P), (V))
+#define f32x4_set(X, Y, Z, W) _mm_setr_ps((X), (Y), (Z), (W))
+#define f32x4_set1(X) _mm_set1_ps(X)
+#define f32x4_zero() _mm_setzero_ps()
+#define f32x4_add(A, B) _mm_add_ps((A), (B))
+#define f32x4_sub(A, B) _mm_sub_ps((A), (B))
+#define f32x4_mul(A, B) _mm_mul_ps((A), (B))
+#define f32x4_div(A, B) _mm_div_ps((A), (B))
+#define f32x4_sqrt(A) _mm_sqrt_ps(A)
+#define f32x4_min(A, B) _mm_min_ps((A), (B))
+#define f32x4_max(A, B) _mm_max_ps((A), (B))
+// Lanes of V where M is zero are cleared to +0
+#define f32x4_clear_where_zero(V, M) _mm_andnot_ps(_mm_cmpeq_ps((M), _mm_setzero_ps()), (V))
+#define f32x4_first(V) _mm_cvtss_f32(V)
+// Lanes I0, I1 from A and I2, I3 from B
+#define f32x4_shuffle2(A, B, I0, I1, I2, I3) _mm_shuffle_ps((A), (B), _MM_SHUFFLE((I3), (I2), (I1), (I0)))
+
+#elif LIN_MATH_NEON
+
+typedef float32x4_t f32x4;
+#define f32x4_load(P) vld1q_f32(P)
+#define f32x4_store(P, V) vst1q_f32((P), (V))
+#define f32x4_set1(X) vdupq_n_f32(X)
+#define f32x4_zero() vdupq_n_f32(0.0f)
+#define f32x4_add(A, B) vaddq_f32((A), (B))
+#define f32x4_sub(A, B) vsubq_f32((A), (B))
+#define f32x4_mul(A, B) vmulq_f32((A), (B))
+#define f32x4_div(A, B) vdivq_f32((A), (B))
+#define f32x4_sqrt(A) vsqrtq_f32(A)
+#define f32x4_clear_where_zero(V, M) \
+    vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(V), vceqq_f32((M), vdupq_n_f32(0.0f))))
+#define f32x4_first(V) vgetq_lane_f32((V), 0)
+#define f32x4_shuffle2(A, B, I0, I1, I2, I3) __builtin_shufflevector((A), (B), (I0), (I1), (I2) + 4, (I3) + 4)
+
+static inline f32x4 f32x4_set(f32 x, f32 y, f32 z, f32 w)
+{
+    f32 d[4] = {x, y, z, w};
+    return vld1q_f32(d);
+}
+
+// Same as the SSE versions and (a < b ? a : b), unlike vminq/vmaxq which order -0 below +0
+static inline f32x4 f32x4_min(f32x4 a, f32x4 b) { return vbslq_f32(vcltq_f32(a, b), a, b); }
+static inline f32x4 f32x4_max(f32x4 a, f32x4 b) { return vbslq_f32(vcgtq_f32(a, b), a, b); }
+
+#endif
+
+#if LIN_MATH_SSE || LIN_MATH_NEON
+
+#define f32x4_shuffle(A, I0, I1, I2, I3) f32x4_shuffle2((A), (A), (I0), (I1), (I2), (I3))
+#define f32x4_broadcast(A, I) f32x4_shuffle((A), (I), (I), (I), (I))
+
+static inline void f32x4_transpose(f32x4 *c0, f32x4 *c1, f32x4 *c2, f32x4 *c3)
+{
+    f32x4 t0 = f32x4_shuffle2(*c0, *c1, 0, 1, 0, 1);
+    f32x4 t1 = f32x4_shuffle2(*c0, *c1, 2, 3, 2, 3);
+    f32x4 t2 = f32x4_shuffle2(*c2, *c3, 0, 1, 0, 1);
+    f32x4 t3 = f32x4_shuffle2(*c2, *c3, 2, 3, 2, 3);
+    *c0 = f32x4_shuffle2(t0, t2, 0, 2, 0, 2);
+    *c1 = f32x4_shuffle2(t0, t2, 1, 3, 1, 3);
+    *c2 = f32x4_shuffle2(t1, t3, 0, 2, 0, 2);
+    *c3 = f32x4_shuffle2(t1, t3, 1, 3, 1, 3);
+}
+
+// Starts from zero like the scalar loop, so -0 products sum the same way
+static inline f32x4 f32x4_mul_col(const f32x4 cols[4], const f32 *v)
+{
+    f32x4 acc = f32x4_zero();
+    acc = f32x4_add(acc, f32x4_mul(cols[0], f32x4_set1(v[0])));
+    acc = f32x4_add(acc, f32x4_mul(cols[1], f32x4_set1(v[1])));
+    acc = f32x4_add(acc, f32x4_mul(cols[2], f32x4_set1(v[2])));
+    acc = f32x4_add(acc, f32x4_mul(cols[3], f32x4_set1(v[3])));
+    return acc;
+}
+
+#endif
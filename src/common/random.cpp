@@ -1,14 +1,226 @@
 #include "random.hpp"
 
-#include <cstdlib>
+#include <cmath>
 
 #include "lin_math.hpp"
 #include "types.hpp"
+#include "util.hpp"
+
+#define RNG_DEFAULT_SEED 0x853c49e6748fea9bull
+#define RNG_LANES 8
+#define RNG_BLOCK (RNG_LANES * 8) // values per bulk step, enough for the consumer loops to vectorize
+
+Rng make_rng(u64 seed, u64 stream)
+{
+    Rng rng = {};
+    rng.inc = (stream << 1u) | 1u;
+    rng_next_u32(&rng);
+    rng.state += seed;
+    rng_next_u32(&rng);
+    return rng;
+}
+
+u32 rng_next_u32(Rng *rng)
+{
+    u64 old = rng->state;
+    rng->state = old * 6364136223846793005ull + rng->inc;
+    u32 xorshifted = (u32)(((old >> 18u) ^ old) >> 27u);
+    u32 rot = (u32)(old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+// Top 24 bits, so every value is exactly representable and 1.0 is never produced
+static inline f32 u32_to_unit_f32(u32 x)
+{
+    return (f32)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+f32 rng_next_f32(Rng *rng)
+{
+    return u32_to_unit_f32(rng_next_u32(rng));
+}
+
+// --------------------------------------------
+
+static u64 thread_rng_stream_counter;
+static thread_local Rng thread_rng;
+static thread_local bool thread_rng_initialized;
+
+Rng *get_thread_rng()
+{
+    if (!thread_rng_initialized)
+    {
+        u64 stream = __atomic_fetch_add(&thread_rng_stream_counter, 1, __ATOMIC_RELAXED);
+        thread_rng = make_rng(RNG_DEFAULT_SEED, stream);
+        thread_rng_initialized = true;
+    }
+    return &thread_rng;
+}
+
+void seed_thread_rng(u64 seed)
+{
+    Rng *rng = get_thread_rng();
+    *rng = make_rng(seed, rng->inc >> 1u);
+}
+
+// ==================== BULK ====================
+
+struct RngLanes
+{
+    u32 s0[RNG_LANES];
+    u32 s1[RNG_LANES];
+    u32 s2[RNG_LANES];
+    u32 s3[RNG_LANES];
+};
+
+static RngLanes make_rng_lanes(Rng *rng)
+{
+    RngLanes lanes;
+    for (int i = 0; i < RNG_LANES; i++)
+    {
+        lanes.s0[i] = rng_next_u32(rng) | 1u; // xoshiro state must not be all zero
+        lanes.s1[i] = rng_next_u32(rng);
+        lanes.s2[i] = rng_next_u32(rng);
+        lanes.s3[i] = rng_next_u32(rng);
+    }
+    return lanes;
+}
+
+// xoshiro128+, one step in every lane
+static inline void rng_lanes_next_f32(RngLanes *l, f32 out[RNG_LANES])
+{
+    for (int i = 0; i < RNG_LANES; i++)
+    {
+        u32 result = l->s0[i] + l->s3[i];
+        u32 t = l->s1[i] << 9;
+        l->s2[i] ^= l->s0[i];
+        l->s3[i] ^= l->s1[i];
+        l->s1[i] ^= l->s2[i];
+        l->s0[i] ^= l->s3[i];
+        l->s2[i] ^= t;
+        l->s3[i] = (l->s3[i] << 11) | (l->s3[i] >> 21);
+        out[i] = u32_to_unit_f32(result);
+    }
+}
+
+static inline void rng_lanes_next_block(RngLanes *l, f32 out[RNG_BLOCK])
+{
+    for (int i = 0; i < RNG_BLOCK; i += RNG_LANES) rng_lanes_next_f32(l, &out[i]);
+}
+
+// Branchless sin/cos for |a| <= pi: fold into [-pi/2, pi/2] and evaluate Taylor series
+// (error below 1e-7 there), written with selects so it vectorizes alongside the generator
+static inline void sincos_poly(f32 a, f32 *out_sin, f32 *out_cos)
+{
+    const f32 half_pi = PI32 * 0.5f;
+
+    f32 s = a > half_pi ? PI32 - a : a;
+    s = s < -half_pi ? -PI32 - s : s;
+    f32 s2 = s * s;
+    *out_sin = s * (1.0f + s2 * (-1.0f / 6.0f + s2 * (1.0f / 120.0f + s2 * (-1.0f / 5040.0f + s2 * (1.0f / 362880.0f + s2 * (-1.0f / 39916800.0f))))));
+
+    f32 abs_a = fabsf(a);
+    f32 c = abs_a > half_pi ? PI32 - abs_a : abs_a;
+    f32 c_sign = abs_a > half_pi ? -1.0f : 1.0f;
+    f32 c2 = c * c;
+    *out_cos = c_sign * (1.0f + c2 * (-0.5f + c2 * (1.0f / 24.0f + c2 * (-1.0f / 720.0f + c2 * (1.0f / 40320.0f + c2 * (-1.0f / 3628800.0f + c2 * (1.0f / 479001600.0f)))))));
+}
+
+// Full blocks have a fixed size so the inner loops vectorize; the last partial block
+// still draws a whole block so the output only depends on the rng state and count
+void rng_fill_f32(Rng *rng, f32 *out, u32 count, f32 min, f32 max)
+{
+    RngLanes lanes = make_rng_lanes(rng);
+    f32 range = max - min;
+    f32 u[RNG_BLOCK];
+    u32 i = 0;
+    for (; i + RNG_BLOCK <= count; i += RNG_BLOCK)
+    {
+        rng_lanes_next_block(&lanes, u);
+        for (u32 j = 0; j < RNG_BLOCK; j++) out[i + j] = min + range * u[j];
+    }
+    if (i < count)
+    {
+        rng_lanes_next_block(&lanes, u);
+        for (u32 j = 0; i + j < count; j++) out[i + j] = min + range * u[j];
+    }
+}
+
+static inline void box_point(v3 min, v3 range, f32 ux, f32 uy, f32 uz, f32 *x, f32 *y, f32 *z)
+{
+    *x = min.x + range.x * ux;
+    *y = min.y + range.y * uy;
+    *z = min.z + range.z * uz;
+}
+
+void rng_fill_v3_in_box(Rng *rng, V3Array *out, u32 count, v3 min, v3 max)
+{
+    bassert(out->count + count <= out->capacity);
+    RngLanes lanes = make_rng_lanes(rng);
+    v3 range = v3_sub(max, min);
+    f32 *x = out->x + out->count;
+    f32 *y = out->y + out->count;
+    f32 *z = out->z + out->count;
+    f32 ux[RNG_BLOCK], uy[RNG_BLOCK], uz[RNG_BLOCK];
+    u32 i = 0;
+    for (; i + RNG_BLOCK <= count; i += RNG_BLOCK)
+    {
+        rng_lanes_next_block(&lanes, ux);
+        rng_lanes_next_block(&lanes, uy);
+        rng_lanes_next_block(&lanes, uz);
+        for (u32 j = 0; j < RNG_BLOCK; j++) box_point(min, range, ux[j], uy[j], uz[j], &x[i + j], &y[i + j], &z[i + j]);
+    }
+    if (i < count)
+    {
+        rng_lanes_next_block(&lanes, ux);
+        rng_lanes_next_block(&lanes, uy);
+        rng_lanes_next_block(&lanes, uz);
+        for (u32 j = 0; i + j < count; j++) box_point(min, range, ux[j], uy[j], uz[j], &x[i + j], &y[i + j], &z[i + j]);
+    }
+    out->count += count;
+}
+
+// Uniform on the sphere: z uniform in [-1, 1), angle uniform around the z axis
+static inline void sphere_point(f32 radius, f32 uz, f32 ua, f32 *x, f32 *y, f32 *z)
+{
+    f32 pz = uz * 2.0f - 1.0f;
+    f32 r = sqrtf(fmaxf(0.0f, 1.0f - pz * pz));
+    f32 s, c;
+    sincos_poly(ua * (2.0f * PI32) - PI32, &s, &c);
+    *x = radius * r * c;
+    *y = radius * r * s;
+    *z = radius * pz;
+}
+
+void rng_fill_v3_on_sphere(Rng *rng, V3Array *out, u32 count, f32 radius)
+{
+    bassert(out->count + count <= out->capacity);
+    RngLanes lanes = make_rng_lanes(rng);
+    f32 *x = out->x + out->count;
+    f32 *y = out->y + out->count;
+    f32 *z = out->z + out->count;
+    f32 uz[RNG_BLOCK], ua[RNG_BLOCK];
+    u32 i = 0;
+    for (; i + RNG_BLOCK <= count; i += RNG_BLOCK)
+    {
+        rng_lanes_next_block(&lanes, uz);
+        rng_lanes_next_block(&lanes, ua);
+        for (u32 j = 0; j < RNG_BLOCK; j++) sphere_point(radius, uz[j], ua[j], &x[i + j], &y[i + j], &z[i + j]);
+    }
+    if (i < count)
+    {
+        rng_lanes_next_block(&lanes, uz);
+        rng_lanes_next_block(&lanes, ua);
+        for (u32 j = 0; i + j < count; j++) sphere_point(radius, uz[j], ua[j], &x[i + j], &y[i + j], &z[i + j]);
+    }
+    out->count += count;
+}
+
+// --------------------------------------------
 
 f32 rand_float()
 {
-    f32 v = rand() / (f32)RAND_MAX;
-    return v;
+    return rng_next_f32(get_thread_rng());
 }
 
 v3 rand_v3(f32 mag)
@@ -1,6 +1,35 @@
 #pragma once
 
+#include "lin_math_array.hpp"
 #include "types.hpp"
 
+// PCG32: 64-bit state, one odd increment per stream
+struct Rng
+{
+    u64 state;
+    u64 inc;
+};
+
+Rng make_rng(u64 seed, u64 stream);
+u32 rng_next_u32(Rng *rng);
+f32 rng_next_f32(Rng *rng); // [0, 1)
+
+// Per-thread generator behind rand_float/rand_v3. Threads get distinct streams in the
+// order they first touch it; seed_thread_rng makes a thread's sequence reproducible.
+Rng *get_thread_rng();
+void seed_thread_rng(u64 seed);
+
+/*
+ * Bulk fills. These seed 8 xoshiro128+ lanes from rng (advancing it) and generate one value
+ * per lane each step with no cross-lane dependency, so the loops vectorize.
+ * The same rng state always produces the same output.
+ */
+void rng_fill_f32(Rng *rng, f32 *out, u32 count, f32 min, f32 max);
+// Appends count points to out
+void rng_fill_v3_in_box(Rng *rng, V3Array *out, u32 count, v3 min, v3 max);
+void rng_fill_v3_on_sphere(Rng *rng, V3Array *out, u32 count, f32 radius);
+
+// Thread rng; [0, 1)
 f32 rand_float();
+// Direction from three rand_float components, so it stays in the positive octant
 v3 rand_v3(f32 mag);
@@ -0,0 +1,123 @@
+#include "rect_pack.hpp"
+
+#include "types.hpp"
+#include "util.hpp"
+
+SkylinePacker make_skyline_packer(u32 width, u32 height)
+{
+    bassert(width > 0 && height > 0);
+    SkylinePacker packer = {};
+    packer.width = width;
+    packer.height = height;
+    // Every node is at least one pixel wide
+    packer.max_node_count = width;
+    packer.nodes = (SkylineNode *)xmalloc(packer.max_node_count * sizeof(packer.nodes[0]));
+    skyline_reset(&packer);
+    return packer;
+}
+
+void destroy_skyline_packer(SkylinePacker *packer)
+{
+    free(packer->nodes);
+    *packer = (SkylinePacker){};
+}
+
+void skyline_reset(SkylinePacker *packer)
+{
+    packer->nodes[0] = (SkylineNode){ 0, 0, packer->width };
+    packer->node_count = 1;
+    packer->used_area = 0;
+}
+
+// Lowest y a width-wide rectangle can rest at when its left edge is at node index's x, false if it sticks out
+static bool skyline_fit(const SkylinePacker *packer, u32 index, u32 width, u32 height, u32 *out_y)
+{
+    u32 x = packer->nodes[index].x;
+    if (x + width > packer->width) return false;
+
+    u32 y = 0;
+    u32 remaining = width;
+    for (u32 i = index; remaining > 0; i++)
+    {
+        if (packer->nodes[i].y > y) y = packer->nodes[i].y;
+        if (y + height > packer->height) return false;
+        remaining -= packer->nodes[i].width < remaining ? packer->nodes[i].width : remaining;
+    }
+    *out_y = y;
+    return true;
+}
+
+bool skyline_pack(SkylinePacker *packer, u32 width, u32 height, u32 *out_x, u32 *out_y)
+{
+    if (width == 0 || height == 0)
+    {
+        *out_x = 0;
+        *out_y = 0;
+        return true;
+    }
+
+    u32 best_index = packer->node_count;
+    u32 best_y = 0;
+    for (u32 i = 0; i < packer->node_count; i++)
+    {
+        u32 y;
+        if (!skyline_fit(packer, i, width, height, &y)) continue;
+        if (best_index == packer->node_count || y < best_y)
+        {
+            best_index = i;
+            best_y = y;
+        }
+    }
+    if (best_index == packer->node_count) return false;
+
+    u32 x = packer->nodes[best_index].x;
+
+    // Segments under the new rectangle are cut away, the rectangle's top becomes one segment
+    u32 right = x + width;
+    u32 end = best_index;
+    while (end < packer->node_count && packer->nodes[end].x + packer->nodes[end].width <= right) end++;
+    if (end < packer->node_count && packer->nodes[end].x < right)
+    {
+        packer->nodes[end].width -= right - packer->nodes[end].x;
+        packer->nodes[end].x = right;
+    }
+
+    // Replace nodes [best_index, end) with the single new node
+    u32 removed = end - best_index;
+    if (removed == 0)
+    {
+        // Can't overflow, nodes tile the width at one pixel or more each
+        memmove(&packer->nodes[best_index + 1], &packer->nodes[best_index], (packer->node_count - best_index) * sizeof(packer->nodes[0]));
+        packer->node_count++;
+    }
+    else if (removed > 1)
+    {
+        memmove(&packer->nodes[best_index + 1], &packer->nodes[end], (packer->node_count - end) * sizeof(packer->nodes[0]));
+        packer->node_count -= removed - 1;
+    }
+    packer->nodes[best_index] = (SkylineNode){ x, best_y + height, width };
+
+    // Merge with neighbours at the same height
+    if (best_index + 1 < packer->node_count && packer->nodes[best_index + 1].y == packer->nodes[best_index].y)
+    {
+        packer->nodes[best_index].width += packer->nodes[best_index + 1].width;
+        memmove(&packer->nodes[best_index + 1], &packer->nodes[best_index + 2], (packer->node_count - best_index - 2) * sizeof(packer->nodes[0]));
+        packer->node_count--;
+    }
+    if (best_index > 0 && packer->nodes[best_index - 1].y == packer->nodes[best_index].y)
+    {
+        packer->nodes[best_index - 1].width += packer->nodes[best_index].width;
+        memmove(&packer->nodes[best_index], &packer->nodes[best_index + 1], (packer->node_count - best_index - 1) * sizeof(packer->nodes[0]));
+        packer->node_count--;
+    }
+
+    packer->used_area += (u64)width * height;
+    *out_x = x;
+    *out_y = best_y;
+    return true;
+}
+
+f32 skyline_get_occupancy(const SkylinePacker *packer)
+{
+    return (f32)((f64)packer->used_area / ((f64)packer->width * packer->height));
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "types.hpp"
+
+/*
+ * Skyline bottom-left rectangle packer. The packed area is described by its top edge, a list of
+ * horizontal segments; each rectangle goes where its top ends lowest (ties to the left), which keeps
+ * the skyline flat for streams of similarly sized images. Rectangles can be added at any time and
+ * are never removed; reset to start over.
+ */
+
+struct SkylineNode
+{
+    u32 x;
+    u32 y;
+    u32 width;
+};
+
+struct SkylinePacker
+{
+    SkylineNode *nodes; // sorted by x, covering [0, width)
+    u32 node_count;
+    u32 max_node_count;
+    u32 width;
+    u32 height;
+    u64 used_area;
+};
+
+SkylinePacker make_skyline_packer(u32 width, u32 height);
+void destroy_skyline_packer(SkylinePacker *packer);
+void skyline_reset(SkylinePacker *packer);
+bool skyline_pack(SkylinePacker *packer, u32 width, u32 height, u32 *out_x, u32 *out_y);
+f32 skyline_get_occupancy(const SkylinePacker *packer);
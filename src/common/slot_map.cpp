@@ -0,0 +1,74 @@
+#include "slot_map.hpp"
+
+#include "types.hpp"
+#include "util.hpp"
+
+SlotMap make_slot_map(u32 capacity)
+{
+    bassert(capacity > 0 && capacity <= HANDLE_INDEX_MASK + 1);
+    SlotMap map = {};
+    map.capacity = capacity;
+    map.generations = (u16 *)xcalloc(capacity * sizeof(map.generations[0]));
+    map.free_list = (u32 *)xmalloc(capacity * sizeof(map.free_list[0]));
+    return map;
+}
+
+void destroy_slot_map(SlotMap *map)
+{
+    free(map->generations);
+    free(map->free_list);
+    *map = (SlotMap){};
+}
+
+static inline Handle make_handle(u32 index, u32 generation)
+{
+    return (generation << HANDLE_INDEX_BITS) | index;
+}
+
+Handle slot_map_alloc(SlotMap *map)
+{
+    u32 index;
+    if (map->free_count > 0)
+    {
+        index = map->free_list[--map->free_count];
+    }
+    else
+    {
+        if (map->used_count >= map->capacity) fatal("Slot map full (%u slots)", map->capacity);
+        index = map->used_count++;
+    }
+
+    // Even -> odd marks the slot alive. The stored generation wraps at 16 bits,
+    // the handle keeps the low HANDLE_GENERATION_BITS of it and never ends up as HANDLE_NULL.
+    map->generations[index]++;
+    map->alive_count++;
+    return make_handle(index, map->generations[index] & HANDLE_GENERATION_MASK);
+}
+
+void slot_map_free(SlotMap *map, Handle handle)
+{
+    if (!slot_map_is_valid(map, handle)) fatal("Freeing stale handle 0x%08x", handle);
+    u32 index = handle_index(handle);
+    map->generations[index]++;
+    map->free_list[map->free_count++] = index;
+    map->alive_count--;
+}
+
+bool slot_map_is_valid(const SlotMap *map, Handle handle)
+{
+    u32 index = handle_index(handle);
+    if (handle == HANDLE_NULL || index >= map->used_count) return false;
+    u16 generation = map->generations[index];
+    return (generation & 1) && (generation & HANDLE_GENERATION_MASK) == handle_generation(handle);
+}
+
+bool slot_map_is_alive_index(const SlotMap *map, u32 index)
+{
+    return index < map->used_count && (map->generations[index] & 1);
+}
+
+u32 slot_map_get_index(const SlotMap *map, Handle handle)
+{
+    if (!slot_map_is_valid(map, handle)) fatal("Stale or invalid handle 0x%08x", handle);
+    return handle_index(handle);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "types.hpp"
+
+// 32-bit generational handles: low bits index a slot, high bits hold the slot's generation.
+// Freeing a slot bumps its generation, so handles to the old occupant stop validating.
+// Handle 0 is never handed out.
+#define HANDLE_INDEX_BITS 20
+#define HANDLE_GENERATION_BITS 12
+#define HANDLE_INDEX_MASK ((1u << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_GENERATION_MASK ((1u << HANDLE_GENERATION_BITS) - 1)
+#define HANDLE_NULL 0u
+
+typedef u32 Handle;
+
+// Only tracks slot liveness; owners keep their data in parallel arrays indexed by slot
+struct SlotMap
+{
+    u16 *generations; // odd while the slot is alive
+    u32 *free_list;
+    u32 free_count;
+    u32 used_count;   // slots ever handed out, the dense range to iterate
+    u32 alive_count;
+    u32 capacity;
+};
+
+SlotMap make_slot_map(u32 capacity);
+void destroy_slot_map(SlotMap *map);
+Handle slot_map_alloc(SlotMap *map);
+void slot_map_free(SlotMap *map, Handle handle);
+bool slot_map_is_valid(const SlotMap *map, Handle handle);
+bool slot_map_is_alive_index(const SlotMap *map, u32 index);
+u32 slot_map_get_index(const SlotMap *map, Handle handle);
+
+static inline u32 handle_index(Handle handle)
+{
+    return handle & HANDLE_INDEX_MASK;
+}
+
+static inline u32 handle_generation(Handle handle)
+{
+    return (handle >> HANDLE_INDEX_BITS) & HANDLE_GENERATION_MASK;
+}
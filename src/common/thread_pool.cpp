@@ -0,0 +1,130 @@
+#include "thread_pool.hpp"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "types.hpp"
+#include "util.hpp"
+
+static void thread_pool_do_jobs(ThreadPool *pool, u32 thread_index)
+{
+    for (;;)
+    {
+        u32 job_index = __atomic_fetch_add(&pool->next_job, 1, __ATOMIC_ACQ_REL);
+        if (job_index >= pool->job_count) break;
+
+        pool->fn(pool->user_data, job_index, thread_index);
+
+        u32 done = __atomic_add_fetch(&pool->jobs_done, 1, __ATOMIC_ACQ_REL);
+        if (done == pool->job_count)
+        {
+            pthread_mutex_lock(&pool->mutex);
+            pthread_cond_signal(&pool->done_cond);
+            pthread_mutex_unlock(&pool->mutex);
+        }
+    }
+}
+
+static void *thread_pool_worker_main(void *arg)
+{
+    ThreadPoolWorker *worker = (ThreadPoolWorker *)arg;
+    ThreadPool *pool = worker->pool;
+
+    pthread_mutex_lock(&pool->mutex);
+    u64 seen_generation = pool->generation;
+    for (;;)
+    {
+        while (pool->generation == seen_generation && !pool->shutting_down)
+        {
+            pthread_cond_wait(&pool->work_cond, &pool->mutex);
+        }
+        if (pool->shutting_down) break;
+
+        seen_generation = pool->generation;
+        pool->active_workers++;
+        pthread_mutex_unlock(&pool->mutex);
+
+        thread_pool_do_jobs(pool, worker->thread_index);
+
+        pthread_mutex_lock(&pool->mutex);
+        pool->active_workers--;
+        if (pool->active_workers == 0) pthread_cond_signal(&pool->done_cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+ThreadPool *make_thread_pool(u32 worker_count)
+{
+    ThreadPool *pool = (ThreadPool *)xcalloc(sizeof(ThreadPool));
+    pool->worker_count = worker_count;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    pool->threads = (pthread_t *)xmalloc(worker_count * sizeof(pool->threads[0]));
+    pool->workers = (ThreadPoolWorker *)xmalloc(worker_count * sizeof(pool->workers[0]));
+    for (u32 i = 0; i < worker_count; i++)
+    {
+        pool->workers[i].pool = pool;
+        pool->workers[i].thread_index = i + 1;
+        int result = pthread_create(&pool->threads[i], NULL, thread_pool_worker_main, &pool->workers[i]);
+        if (result != 0) fatal("Failed to create worker thread: %d", result);
+    }
+    return pool;
+}
+
+void destroy_thread_pool(ThreadPool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutting_down = true;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (u32 i = 0; i < pool->worker_count; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+}
+
+void thread_pool_run(ThreadPool *pool, u32 job_count, ThreadPoolJobFn fn, void *user_data)
+{
+    if (job_count == 0) return;
+
+    pthread_mutex_lock(&pool->mutex);
+    // Workers of the previous run may still be on their way out of thread_pool_do_jobs
+    while (pool->active_workers > 0)
+    {
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    pool->fn = fn;
+    pool->user_data = user_data;
+    pool->job_count = job_count;
+    pool->next_job = 0;
+    pool->jobs_done = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    thread_pool_do_jobs(pool, 0);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (__atomic_load_n(&pool->jobs_done, __ATOMIC_ACQUIRE) < job_count || pool->active_workers > 0)
+    {
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+u32 get_hardware_thread_count()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (u32)count : 1;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <pthread.h>
+
+#include "types.hpp"
+
+typedef void (*ThreadPoolJobFn)(void *user_data, u32 job_index, u32 thread_index);
+
+struct ThreadPool;
+
+struct ThreadPoolWorker
+{
+    ThreadPool *pool;
+    u32 thread_index;
+};
+
+struct ThreadPool
+{
+    pthread_t *threads;
+    ThreadPoolWorker *workers;
+    u32 worker_count;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+
+    ThreadPoolJobFn fn;
+    void *user_data;
+    u32 job_count;
+    u32 next_job;
+    u32 jobs_done;
+    u32 active_workers;
+    u64 generation;
+    bool shutting_down;
+};
+
+// The calling thread takes part in thread_pool_run as thread 0, workers are 1..worker_count
+ThreadPool *make_thread_pool(u32 worker_count);
+void destroy_thread_pool(ThreadPool *pool);
+void thread_pool_run(ThreadPool *pool, u32 job_count, ThreadPoolJobFn fn, void *user_data);
+u32 get_hardware_thread_count();
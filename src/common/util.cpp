@@ -0,0 +1,5 @@
+#include "util.hpp"
+
+#include "types.hpp"
+
+u64 heap_alloc_count;
@@ -5,6 +5,8 @@
 #include <cstdlib>
 #include <cstring>
 
+#include "types.hpp"
+
 // ======================== LOGGING ========================
 
 #define fatal(FMT, ...) do { \
@@ -61,7 +63,7 @@
 #define list_init(LIST, CAP) \
     do { \
         (LIST)->cap = (CAP); \
-        (LIST)->data = xrealloc((LIST)->data, (LIST)->cap * sizeof(*(LIST)->data)); \
+        (LIST)->data = (__typeof__((LIST)->data))xrealloc((LIST)->data, (LIST)->cap * sizeof(*(LIST)->data)); \
     } while(0)
 
 #define list_grow(LIST) \
@@ -73,7 +75,7 @@
         if ((LIST)->size >= (LIST)->cap) \
         { \
             (LIST)->cap *= 2; \
-            (LIST)->data = xrealloc((LIST)->data, (LIST)->cap * sizeof(*(LIST)->data)); \
+            (LIST)->data = (__typeof__((LIST)->data))xrealloc((LIST)->data, (LIST)->cap * sizeof(*(LIST)->data)); \
         } \
     } while (0)
 
@@ -110,8 +112,22 @@
 
 // ======================== STDLIB HEAP ========================
 
+// Every x*alloc call bumps this, so frame code can check that it stays off the heap
+extern u64 heap_alloc_count;
+
+static inline void count_heap_alloc()
+{
+    __atomic_add_fetch(&heap_alloc_count, 1, __ATOMIC_RELAXED);
+}
+
+static inline u64 get_heap_alloc_count()
+{
+    return __atomic_load_n(&heap_alloc_count, __ATOMIC_RELAXED);
+}
+
 static void *xmalloc(size_t size)
 {
+    count_heap_alloc();
     void *ptr = malloc(size);
     if (!ptr) fatal("malloc failed for %zu", size);
     return ptr;
@@ -119,6 +135,7 @@ static void *xmalloc(size_t size)
 
 static void *xcalloc(size_t size)
 {
+    count_heap_alloc();
     void *ptr = calloc(1, size);
     if (!ptr) fatal("calloc failed for %zu", size);
     return ptr;
@@ -126,6 +143,7 @@ static void *xcalloc(size_t size)
 
 static void *xrealloc(void *data, size_t new_size)
 {
+    count_heap_alloc();
     void *new_data = realloc(data, new_size);
     if (!new_data) fatal("realloc failed for %zu", new_size);
     return new_data;
@@ -135,6 +153,7 @@ static void *xrealloc(void *data, size_t new_size)
 
 static char *xstrdup(const char *str)
 {
+    count_heap_alloc();
     char *new_str = strdup(str);
     if (!new_str) fatal("strdup failed for %s", str);
     return new_str;
@@ -153,6 +172,23 @@ static char *strf(const char *fmt, ...)
     return str;
 }
 
+// ======================== HASHING ========================
+
+#define FNV1A64_SEED 0xcbf29ce484222325ull
+
+// Chainable: feed the previous result back in as seed to hash several fields
+static inline u64 hash_fnv1a64(const void *data, size_t size, u64 seed)
+{
+    const u8 *bytes = (const u8 *)data;
+    u64 hash = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
 // ======================== PLATFORM MACROS ========================
 
 #if defined(_WIN32)
@@ -0,0 +1,9 @@
+#include "common/common.hpp"
+
+// Throughput of the lin_math_array kernels against their scalar loops, run with make bench
+int main()
+{
+    if (!lin_math_simd_self_check() || !lin_math_array_self_check()) return 1;
+    lin_math_array_benchmark(4096, 2000);
+    return 0;
+}
@@ -1,20 +1,111 @@
 #include <GLFW/glfw3.h>
-#include <cstddef>
 
 #include "vgk.hpp"
 
 #define FRAMES_IN_FLIGHT 2
+#define IDLE_WAIT_TIMEOUT 0.5 // seconds, wakes the idle loop for housekeeping
+#define CURSOR_BOX_SIZE 48.0f
 
-struct Vertex
+// Shared with the GLFW callbacks through the window user pointer
+struct WindowState
 {
-    v3 pos;
-    v2 uv;
-    v4 color;
-    u32 tex_index;
+    Vgk_DamageTracker damage_tracker;
+    bool is_resized;
 };
 
+// Everything that follows the swapchain extent. On resize the render passes are kept, only their framebuffers are rebuilt.
+struct RenderTargets
+{
+    Vgk_SwapchainBundle swapchain_bundle;
+    Vgk_DepthImageBundle depth_image_bundle;
+    Vgk_MsaaImageBundle msaa_image_bundle;
+    Vgk_RenderPassBundle render_pass_bundle;
+    Vgk_RenderPassBundle damage_render_pass_bundle;
+};
+
+// Exposed or restored windows may have lost their contents
+static void on_window_refresh(GLFWwindow *window)
+{
+    WindowState *state = (WindowState *)glfwGetWindowUserPointer(window);
+    vgk_damage_add_full(&state->damage_tracker);
+}
+
+static void on_framebuffer_size(GLFWwindow *window, int width, int height)
+{
+    WindowState *state = (WindowState *)glfwGetWindowUserPointer(window);
+    state->is_resized = true;
+}
+
+static void create_render_target_images(RenderTargets *targets, VkSampleCountFlagBits sample_count, VkSurfaceKHR surface, VkDevice device, VkPhysicalDevice physical_device)
+{
+    targets->swapchain_bundle = vgk_create_swapchain_bundle(physical_device, surface, device);
+    targets->depth_image_bundle = vgk_create_depth_image_bundle(VK_FORMAT_D32_SFLOAT, sample_count, FRAMES_IN_FLIGHT, targets->swapchain_bundle.extent, device, physical_device);
+    if (sample_count > VK_SAMPLE_COUNT_1_BIT)
+    {
+        targets->msaa_image_bundle = vgk_create_msaa_image_bundle(targets->swapchain_bundle.format.format, sample_count, FRAMES_IN_FLIGHT, targets->swapchain_bundle.extent, device, physical_device);
+    }
+}
+
+static void destroy_render_target_images(RenderTargets *targets, VkDevice device)
+{
+    if (targets->msaa_image_bundle.image_count > 0) vgk_destroy_msaa_image_bundle(&targets->msaa_image_bundle, device);
+    vgk_destroy_depth_image_bundle(&targets->depth_image_bundle, device);
+    vgk_destroy_swapchain_bundle(&targets->swapchain_bundle, device);
+}
+
+static RenderTargets create_render_targets(VkSampleCountFlagBits sample_count, VkSurfaceKHR surface, VkDevice device, VkPhysicalDevice physical_device)
+{
+    RenderTargets targets = {};
+    create_render_target_images(&targets, sample_count, surface, device, physical_device);
+    const Vgk_MsaaImageBundle *msaa_image_bundle = targets.msaa_image_bundle.image_count > 0 ? &targets.msaa_image_bundle : NULL;
+    targets.render_pass_bundle = vgk_create_render_pass_bundle(&targets.swapchain_bundle, &targets.depth_image_bundle, msaa_image_bundle, true, true, device);
+    targets.damage_render_pass_bundle = vgk_create_damage_render_pass_bundle(&targets.swapchain_bundle, &targets.depth_image_bundle, msaa_image_bundle, device);
+    return targets;
+}
+
+// Pipelines were created against the render passes, keeping them lets the pipelines survive the resize
+static void resize_render_targets(RenderTargets *targets, VkSampleCountFlagBits sample_count, VkSurfaceKHR surface, VkDevice device, VkPhysicalDevice physical_device)
+{
+    destroy_render_target_images(targets, device);
+    create_render_target_images(targets, sample_count, surface, device, physical_device);
+    const Vgk_MsaaImageBundle *msaa_image_bundle = targets->msaa_image_bundle.image_count > 0 ? &targets->msaa_image_bundle : NULL;
+    vgk_recreate_framebuffers(&targets->render_pass_bundle, &targets->swapchain_bundle, &targets->depth_image_bundle, msaa_image_bundle, device);
+    vgk_recreate_framebuffers(&targets->damage_render_pass_bundle, &targets->swapchain_bundle, &targets->depth_image_bundle, msaa_image_bundle, device);
+}
+
+static void destroy_render_targets(RenderTargets *targets, VkDevice device)
+{
+    vgk_destroy_render_pass_bundle(&targets->damage_render_pass_bundle, device);
+    vgk_destroy_render_pass_bundle(&targets->render_pass_bundle, device);
+    destroy_render_target_images(targets, device);
+}
+
+// Pixel coordinates, origin at the top left
+static void write_ui_projection(Vgk_BufferBundle *uniform_buffer, VkExtent2D extent)
+{
+    *(m4 *)uniform_buffer->data_ptr = m4_proj_ortho(0.0f, (f32)extent.width, 0.0f, (f32)extent.height, -1.0f, 1.0f);
+}
+
+static VkRect2D get_cursor_box(GLFWwindow *window)
+{
+    int window_width, window_height, framebuffer_width, framebuffer_height;
+    glfwGetWindowSize(window, &window_width, &window_height);
+    glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+    if (window_width == 0 || window_height == 0) return (VkRect2D){};
+
+    // Cursor positions are in screen coordinates, the UI draws in framebuffer pixels
+    double cursor_x, cursor_y;
+    glfwGetCursorPos(window, &cursor_x, &cursor_y);
+    i32 x = (i32)(cursor_x * framebuffer_width / window_width - CURSOR_BOX_SIZE * 0.5f);
+    i32 y = (i32)(cursor_y * framebuffer_height / window_height - CURSOR_BOX_SIZE * 0.5f);
+    return (VkRect2D){ { x, y }, { (u32)CURSOR_BOX_SIZE, (u32)CURSOR_BOX_SIZE } };
+}
+
 int main()
 {
+    bassert(lin_math_simd_self_check());
+    bassert(lin_math_array_self_check());
+
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
@@ -26,11 +117,11 @@ int main()
     u32 queue_family_index = vgk_get_queue_family_index(physical_device, surface);
     VkDevice device = vgk_create_device(queue_family_index, physical_device);
     VkQueue queue = vgk_get_queue(device, queue_family_index);
-    Vgk_SwapchainBundle swapchain_bundle = vgk_create_swapchain_bundle(physical_device, surface, device);
-    Vgk_DepthImageBundle depth_image_bundle = vgk_create_depth_image_bundle(VK_FORMAT_D32_SFLOAT, swapchain_bundle.image_count, swapchain_bundle.extent, device, physical_device);
-    Vgk_RenderPassBundle render_pass_bundle = vgk_create_render_pass_bundle(&swapchain_bundle, &depth_image_bundle, true, false, device);
+    VkSampleCountFlagBits sample_count = vgk_clamp_sample_count(physical_device, VK_SAMPLE_COUNT_4_BIT);
+    RenderTargets targets = create_render_targets(sample_count, surface, device, physical_device);
     VkCommandPool command_pool = vgk_create_command_pool(queue_family_index, device);
     Vgk_FrameList frame_list = vgk_create_frame_list(FRAMES_IN_FLIGHT, command_pool, device);
+    Vgk_StagingPool staging_pool = vgk_create_staging_pool(1, device, physical_device);
 
     Vgk_DescriptorPoolBundle descriptor_pool_bundle = vgk_create_descriptor_pool_bundle(device);
 
@@ -39,11 +130,22 @@ int main()
     vgk_add_descriptor_binding(&ui_descriptor_set_spec, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, VK_SHADER_STAGE_FRAGMENT_BIT);
     Vgk_DescriptorSetBundle ui_descriptor_set = vgk_create_descriptor_set_bundle_from_spec(&descriptor_pool_bundle, &ui_descriptor_set_spec, device);
 
-    Vgk_VertInputSpec vert_input = vgk_make_vert_input_spec(sizeof(Vertex));
-    vgk_add_vert_attribute(&vert_input, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos));
-    vgk_add_vert_attribute(&vert_input, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv));
-    vgk_add_vert_attribute(&vert_input, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vertex, color));
-    vgk_add_vert_attribute(&vert_input, VK_FORMAT_R32_UINT, offsetof(Vertex, tex_index));
+    // Only rewritten after vkDeviceWaitIdle, so one buffer serves every frame in flight
+    Vgk_BufferBundle ui_uniform_buffer = vgk_create_buffer_bundle(sizeof(m4), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VGK_MEMORY_ACCESS_SEQUENTIAL_WRITE, device, physical_device);
+    write_ui_projection(&ui_uniform_buffer, targets.swapchain_bundle.extent);
+    vgk_update_buffer_descriptor(&ui_descriptor_set, 0, ui_uniform_buffer.buffer, 0, sizeof(m4), device);
+
+    // Untextured quads sample a white texel; both sampler slots must be valid
+    u32 white_pixel = 0xffffffff;
+    Vgk_TextureBundle white_texture = vgk_load_texture_from_pixels(&white_pixel, 1, 1, VK_FORMAT_R8G8B8A8_UNORM, &staging_pool, &frame_list, device, physical_device, command_pool, queue);
+    for (u32 i = 0; i < 2; i++)
+    {
+        vgk_update_image_descriptor(&ui_descriptor_set, 1, i, white_texture.image_view, white_texture.sampler, white_texture.layout, device);
+    }
+
+    Vgk_UiBatch ui_batch = vgk_create_ui_batch(16, FRAMES_IN_FLIGHT, device, physical_device);
+
+    Vgk_VertInputSpec vert_input = vgk_make_ui_vert_input_spec();
 
     Vgk_PipelineSpec pipeline_spec = vgk_make_pipeline_spec();
     vgk_set_vert_shader_path(&pipeline_spec, "bin/shaders/ui.vert.spv");
@@ -51,20 +153,132 @@ int main()
     vgk_set_frame_count(&pipeline_spec, frame_list.count);
     vgk_add_descriptor_set(&pipeline_spec, &ui_descriptor_set_spec);
     vgk_set_vert_input(&pipeline_spec, &vert_input);
-    vgk_set_viewport(&pipeline_spec, vgk_get_viewport_for_extent(swapchain_bundle.extent));
-    vgk_set_scissor(&pipeline_spec, vgk_get_scissor_for_extent(swapchain_bundle.extent));
+    // Both follow the swapchain extent, so the pipeline doesn't depend on the window size
+    vgk_set_dynamic_viewport(&pipeline_spec, true);
+    vgk_set_dynamic_scissor(&pipeline_spec, true);
     vgk_set_rasterization_state(&pipeline_spec, VK_POLYGON_MODE_FILL, 1.0f, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE);
-    vgk_set_sample_count(&pipeline_spec, VK_SAMPLE_COUNT_1_BIT);
+    vgk_set_sample_count(&pipeline_spec, sample_count);
     vgk_set_enable_blending(&pipeline_spec, true);
-    vgk_set_render_pass(&pipeline_spec, render_pass_bundle.render_pass);
+    vgk_set_render_pass(&pipeline_spec, targets.render_pass_bundle.render_pass);
 
-    Vgk_PipelineBundle pipeline_bundle = vgk_create_pipeline_from_spec(&pipeline_spec, device);
+    // Created once per spec; draws look the pipeline up by the cached hash
+    Vgk_PipelineRegistry pipeline_registry = vgk_create_pipeline_registry(64);
+    vgk_registry_get_pipeline(&pipeline_registry, &pipeline_spec, device);
+    u64 ui_pipeline_hash = vgk_hash_pipeline_spec(&pipeline_registry, &pipeline_spec);
 
+    WindowState window_state = {};
+    window_state.damage_tracker = vgk_create_damage_tracker(&targets.swapchain_bundle);
+    glfwSetWindowUserPointer(window, &window_state);
+    glfwSetWindowRefreshCallback(window, on_window_refresh);
+    glfwSetFramebufferSizeCallback(window, on_framebuffer_size);
+    Vgk_DamageTracker *damage_tracker = &window_state.damage_tracker;
+
+    VkClearColorValue clear_color = {{ 0.1f, 0.1f, 0.1f, 1.0f }};
+    VkRect2D panel_box = { { 40, 40 }, { 320, 200 } };
+    VkRect2D cursor_box = get_cursor_box(window);
+
+    // Render on demand: sleep in the event loop until something is damaged, then redraw only that
     while (!glfwWindowShouldClose(window))
     {
-        glfwPollEvents();
+        if (vgk_damage_has_pending(damage_tracker) || window_state.is_resized) glfwPollEvents();
+        else glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT);
+        vgk_maybe_log_memory_stats(glfwGetTime());
+
+        if (window_state.is_resized)
+        {
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
+            // Minimized, nothing can be presented until the window comes back
+            if (width == 0 || height == 0)
+            {
+                glfwWaitEvents();
+                continue;
+            }
+
+            vkDeviceWaitIdle(device);
+            resize_render_targets(&targets, sample_count, surface, device, physical_device);
+            write_ui_projection(&ui_uniform_buffer, targets.swapchain_bundle.extent);
+
+            // Image count and extent may have changed; a new tracker starts out fully damaged
+            window_state.damage_tracker = vgk_create_damage_tracker(&targets.swapchain_bundle);
+            window_state.is_resized = false;
+        }
+
+        VkRect2D new_cursor_box = get_cursor_box(window);
+        if (new_cursor_box.offset.x != cursor_box.offset.x || new_cursor_box.offset.y != cursor_box.offset.y)
+        {
+            vgk_damage_add_rect(damage_tracker, cursor_box);
+            vgk_damage_add_rect(damage_tracker, new_cursor_box);
+            cursor_box = new_cursor_box;
+        }
+
+        if (!vgk_damage_has_pending(damage_tracker)) continue;
+
+        Vgk_Frame *frame = vgk_frame_list_begin_frame(&frame_list, device);
+
+        u32 image_index;
+        VkResult result = vkAcquireNextImageKHR(device, targets.swapchain_bundle.swapchain, UINT64_MAX, frame->acquire_semaphore, VK_NULL_HANDLE, &image_index);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            // Nothing was submitted for this frame; the damage stays pending for the new swapchain
+            window_state.is_resized = true;
+            continue;
+        }
+        if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) fatal("Failed to acquire swapchain image. Result: %d", result);
+
+        Vgk_DamageRegion damage = vgk_damage_take(damage_tracker, image_index);
+
+        vgk_ui_batch_begin(&ui_batch, frame_list.frame_index);
+        vgk_ui_batch_add_quad(&ui_batch,
+            (f32)panel_box.offset.x, (f32)panel_box.offset.y,
+            (f32)(panel_box.offset.x + (i32)panel_box.extent.width), (f32)(panel_box.offset.y + (i32)panel_box.extent.height),
+            0.0f, 0.0f, 1.0f, 1.0f, V4(0.25f, 0.3f, 0.4f, 1.0f), 0);
+        vgk_ui_batch_add_quad(&ui_batch,
+            (f32)cursor_box.offset.x, (f32)cursor_box.offset.y,
+            (f32)(cursor_box.offset.x + (i32)cursor_box.extent.width), (f32)(cursor_box.offset.y + (i32)cursor_box.extent.height),
+            0.0f, 0.0f, 1.0f, 1.0f, V4(0.9f, 0.6f, 0.2f, 1.0f), 0);
+
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        result = vkBeginCommandBuffer(frame->command_buffer, &begin_info);
+        if (result != VK_SUCCESS) fatal("Failed to begin frame command buffer");
+
+        vgk_cmd_begin_damage_render_pass(frame->command_buffer, &targets.render_pass_bundle, &targets.damage_render_pass_bundle, &damage, image_index, frame_list.frame_index, targets.swapchain_bundle.extent, clear_color);
+        Vgk_PipelineHandle ui_pipeline = vgk_registry_find_pipeline(&pipeline_registry, ui_pipeline_hash);
+        vkCmdBindPipeline(frame->command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vgk_get_pipeline(&pipeline_registry.table, ui_pipeline));
+        vkCmdBindDescriptorSets(frame->command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vgk_get_pipeline_layout(&pipeline_registry.table, ui_pipeline), 0, 1, &ui_descriptor_set.descriptor_set, 0, NULL);
+        VkViewport viewport = vgk_get_viewport_for_extent(targets.swapchain_bundle.extent);
+        vkCmdSetViewport(frame->command_buffer, 0, 1, &viewport);
+        for (u32 i = 0; i < damage.rect_count; i++)
+        {
+            vkCmdSetScissor(frame->command_buffer, 0, 1, &damage.rects[i]);
+            vgk_cmd_draw_ui_batch(frame->command_buffer, &ui_batch);
+        }
+        vkCmdEndRenderPass(frame->command_buffer);
+
+        result = vkEndCommandBuffer(frame->command_buffer);
+        if (result != VK_SUCCESS) fatal("Failed to end frame command buffer");
+
+        VkSemaphore present_semaphore = targets.swapchain_bundle.submit_semaphores[image_index];
+        vgk_frame_list_submit_frame(&frame_list, frame, present_semaphore, queue);
+
+        VkPresentInfoKHR present_info = {};
+        present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        present_info.waitSemaphoreCount = 1;
+        present_info.pWaitSemaphores = &present_semaphore;
+        present_info.swapchainCount = 1;
+        present_info.pSwapchains = &targets.swapchain_bundle.swapchain;
+        present_info.pImageIndices = &image_index;
+        result = vkQueuePresentKHR(queue, &present_info);
+        // The swapchain no longer matches the surface, rebuild it before the next frame
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) window_state.is_resized = true;
+        else if (result != VK_SUCCESS) fatal("Failed to present. Result: %d", result);
     }
 
+    vkDeviceWaitIdle(device);
+    destroy_render_targets(&targets, device);
+
     glfwDestroyWindow(window);
     glfwTerminate();
 
@@ -8,8 +8,20 @@ layout(set = 0, binding = 1) uniform sampler2D texSampler[2];
 
 layout(location = 0) out vec4 outColor;
 
+// Same as VGK_UI_TINT_TEXTURE_BIT in vgk.hpp
+const uint TINT_TEXTURE_BIT = 0x80000000u;
+
 void main()
 {
-    vec4 t = texture(texSampler[fragTexIndex], fragUV);
-    outColor = vec4(vec3(fragColor), t.a);
+    vec4 t = texture(texSampler[fragTexIndex & ~TINT_TEXTURE_BIT], fragUV);
+    if ((fragTexIndex & TINT_TEXTURE_BIT) != 0u)
+    {
+        // Images: the texel tinted by the vertex color
+        outColor = fragColor * t;
+    }
+    else
+    {
+        // Vertex color masked by the texel's alpha (glyph coverage)
+        outColor = vec4(vec3(fragColor), t.a);
+    }
 }
@@ -3,9 +3,24 @@
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan_core.h>
+#include <cmath>
+#include <cstddef>
+#include <sys/stat.h>
+
+// Glyphs are rasterized at frame time, so stb_truetype's temporary allocations go to the scratch arena
+// set as the font's userdata around each rasterization. Anything else goes through the counted heap.
+#define STBTT_malloc(size, user_data) ((user_data) ? arena_alloc_raw((Arena *)(user_data), (size), 16) : xmalloc(size))
+#define STBTT_free(ptr, user_data) ((user_data) ? (void)0 : free(ptr))
+#define STB_TRUETYPE_IMPLEMENTATION
+#include <stb_truetype.h>
 
 #include "common/common.hpp"
 
+static void vgk_init_memory_tracker(VkPhysicalDevice physical_device, bool has_budget);
+
+// What vgk_create_device enabled, for asserts in the recording helpers
+static Vgk_DeviceCaps vgk_device_caps;
+
 // ======================== CREATE ======================================
 
 VkInstance vgk_create_instance()
@@ -26,8 +41,9 @@ VkInstance vgk_create_instance()
 #endif
         };
 
+        ArenaTemp scratch = arena_temp_begin(vgk_get_scratch_arena());
         u32 ext_count = 0;
-        const char **extensions = (const char **)xmalloc((glfw_ext_count + array_count(other_exts)) * sizeof(extensions[0]));
+        const char **extensions = arena_alloc_array(scratch.arena, const char *, glfw_ext_count + array_count(other_exts));
         for (u32 i = 0; i < glfw_ext_count; i++)
         {
             extensions[ext_count++] = glfw_ext[i];
@@ -53,7 +69,7 @@ VkInstance vgk_create_instance()
         VkResult result = vkCreateInstance(&create_info, NULL, &instance);
         if (result != VK_SUCCESS) fatal("Failed to create instance. Result: %d", result);
 
-        free(extensions);
+        arena_temp_end(scratch);
     }
     return instance;
 }
@@ -75,17 +91,20 @@ VkPhysicalDevice vgk_find_physical_device(VkInstance instance)
         u32 count;
         VkResult result = vkEnumeratePhysicalDevices(instance, &count, NULL);
         if (result != VK_SUCCESS) fatal("Failed to enumerate physical devices");
-        VkPhysicalDevice *physical_devices = (VkPhysicalDevice *)xmalloc(count * sizeof(physical_devices[0]));
+        ArenaTemp scratch = arena_temp_begin(vgk_get_scratch_arena());
+        VkPhysicalDevice *physical_devices = arena_alloc_array(scratch.arena, VkPhysicalDevice, count);
         result = vkEnumeratePhysicalDevices(instance, &count, physical_devices);
         if (result != VK_SUCCESS) fatal("Failed to enumerate physical devices 2");
         physical_device = physical_devices[0];
-        free(physical_devices);
+        arena_temp_end(scratch);
     }
     return physical_device;
 }
 
 VkDevice vgk_create_device(u32 queue_family_index, VkPhysicalDevice physical_device)
 {
+    Vgk_DeviceCaps caps = vgk_get_device_caps(physical_device);
+
     VkDevice vk_device;
     {
         float priority = 1.0f;
@@ -95,22 +114,44 @@ VkDevice vgk_create_device(u32 queue_family_index, VkPhysicalDevice physical_dev
         queue_create_info.queueCount = 1;
         queue_create_info.pQueuePriorities = &priority;
         // VK_KHR_portability_subset must be enabled because physical device VkPhysicalDevice 0x600001667be0 supports it.
-        const char *device_extensions[] = {
+        const char *device_extensions[3];
+        u32 device_extension_count = 0;
 #ifdef OS_MAC
-            "VK_KHR_portability_subset", 
+        device_extensions[device_extension_count++] = "VK_KHR_portability_subset";
 #endif
-            "VK_KHR_swapchain"
-        };
+        device_extensions[device_extension_count++] = "VK_KHR_swapchain";
+        if (caps.memory_budget) device_extensions[device_extension_count++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+
+        VkPhysicalDeviceVulkan12Features vulkan12_features = {};
+        vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12_features.drawIndirectCount = caps.draw_indirect_count ? VK_TRUE : VK_FALSE;
+        vulkan12_features.timelineSemaphore = VK_TRUE;
+
+        VkPhysicalDeviceVulkan13Features vulkan13_features = {};
+        vulkan13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        vulkan13_features.pNext = &vulkan12_features;
+        vulkan13_features.dynamicRendering = caps.dynamic_rendering ? VK_TRUE : VK_FALSE;
+
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &vulkan13_features;
+        features.features.multiDrawIndirect = caps.multi_draw_indirect ? VK_TRUE : VK_FALSE;
+        features.features.drawIndirectFirstInstance = caps.draw_indirect_first_instance ? VK_TRUE : VK_FALSE;
+
         VkDeviceCreateInfo device_create_info = {};
         device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        device_create_info.pNext = &features;
         device_create_info.queueCreateInfoCount = 1;
         device_create_info.pQueueCreateInfos = &queue_create_info;
-        device_create_info.enabledExtensionCount = array_count(device_extensions);
+        device_create_info.enabledExtensionCount = device_extension_count;
         device_create_info.ppEnabledExtensionNames = device_extensions;
 
         VkResult result = vkCreateDevice(physical_device, &device_create_info, NULL, &vk_device);
         if (result != VK_SUCCESS) fatal("Failed to create logical device");
     }
+
+    vgk_device_caps = caps;
+    vgk_init_memory_tracker(physical_device, caps.memory_budget);
     return vk_device;
 }
 
@@ -131,14 +172,15 @@ Vgk_SwapchainBundle vgk_create_swapchain_bundle(VkPhysicalDevice physical_device
     result = vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count, NULL);
     if (result != VK_SUCCESS) fatal("Failed to get physical device-surface formats");
 
-    VkSurfaceFormatKHR *formats = (VkSurfaceFormatKHR *)xmalloc(format_count * sizeof(formats[0]));
+    ArenaTemp scratch = arena_temp_begin(vgk_get_scratch_arena());
+    VkSurfaceFormatKHR *formats = arena_alloc_array(scratch.arena, VkSurfaceFormatKHR, format_count);
     result = vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count, formats);
     if (result != VK_SUCCESS) fatal("Failed to get physical device-surface formats 2");
 
     VkSurfaceFormatKHR surface_format = formats[0];
     assert(surface_format.format == VK_FORMAT_B8G8R8A8_UNORM && surface_format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR);
 
-    free(formats);
+    arena_temp_end(scratch);
 
     u32 image_count = capabilities.minImageCount + 1;
     if (capabilities.maxImageCount > 0 && image_count > capabilities.maxImageCount)
@@ -146,6 +188,9 @@ Vgk_SwapchainBundle vgk_create_swapchain_bundle(VkPhysicalDevice physical_device
         image_count = capabilities.maxImageCount;
     }
 
+    // For screenshots and frame dumps through vgk_cmd_readback_swapchain_image
+    bool supports_readback = (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+
     VkSwapchainKHR swapchain;
     {
         VkSwapchainCreateInfoKHR create_info = {};
@@ -157,6 +202,7 @@ Vgk_SwapchainBundle vgk_create_swapchain_bundle(VkPhysicalDevice physical_device
         create_info.imageExtent = capabilities.currentExtent;
         create_info.imageArrayLayers = 1;
         create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        if (supports_readback) create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
         create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
         create_info.preTransform = capabilities.currentTransform;
         create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
@@ -218,80 +264,102 @@ Vgk_SwapchainBundle vgk_create_swapchain_bundle(VkPhysicalDevice physical_device
     swapchain_bundle.image_views = image_views;
     swapchain_bundle.submit_semaphores = submit_semaphores;
     swapchain_bundle.extent = capabilities.currentExtent;
+    swapchain_bundle.supports_readback = supports_readback;
     return swapchain_bundle;
 }
 
-Vgk_DepthImageBundle vgk_create_depth_image_bundle(VkFormat depth_format, u32 image_count, VkExtent2D swapchain_extent, VkDevice device, VkPhysicalDevice physical_device)
+// Attachment images that never outlive a render pass: TRANSIENT_ATTACHMENT, lazily allocated memory where the device has it
+static bool vgk_create_transient_attachment(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect, VkSampleCountFlagBits samples, VkExtent2D extent, Vgk_MemoryCategory category, VkImage *out_image, VkDeviceMemory *out_memory, VkImageView *out_image_view, VkDevice device, VkPhysicalDevice physical_device)
 {
-    Vgk_DepthImageBundle depth_image_bundle = {};
-
-    depth_image_bundle.image_count = image_count;
-    depth_image_bundle.depth_format = depth_format;
-
     VkResult result;
+    bool is_lazily_allocated;
 
-    VkImage *images = (VkImage *)xmalloc(depth_image_bundle.image_count * sizeof(images[0]));
-    VkDeviceMemory *memory_list = (VkDeviceMemory *)xmalloc(depth_image_bundle.image_count * sizeof(memory_list[0]));
-    VkImageView *image_views = (VkImageView *)xmalloc(depth_image_bundle.image_count * sizeof(image_views[0]));
-    for (u32 i = 0; i < depth_image_bundle.image_count; i++)
+    // Image
     {
-        // Image
-        {
-            VkImageCreateInfo create_info = {};
-            create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-            create_info.imageType = VK_IMAGE_TYPE_2D;
-            create_info.extent.width = swapchain_extent.width;
-            create_info.extent.height = swapchain_extent.height;
-            create_info.extent.depth = 1;
-            create_info.mipLevels = 1;
-            create_info.arrayLayers = 1;
-            create_info.format = depth_format;
-            create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
-            create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            create_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-            create_info.samples = VK_SAMPLE_COUNT_1_BIT;
-            create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        VkImageCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        create_info.imageType = VK_IMAGE_TYPE_2D;
+        create_info.extent.width = extent.width;
+        create_info.extent.height = extent.height;
+        create_info.extent.depth = 1;
+        create_info.mipLevels = 1;
+        create_info.arrayLayers = 1;
+        create_info.format = format;
+        create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        create_info.usage = usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        create_info.samples = samples;
+        create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-            result = vkCreateImage(device, &create_info, NULL, &images[i]);
-            if (result != VK_SUCCESS) fatal("Failed to create depth buffer image");
-        }
+        result = vkCreateImage(device, &create_info, NULL, out_image);
+        if (result != VK_SUCCESS) fatal("Failed to create attachment image");
+    }
 
-        // Device memory
-        {
-            VkMemoryRequirements mem_req;
-            vkGetImageMemoryRequirements(device, images[i], &mem_req);
+    // Device memory
+    {
+        VkMemoryRequirements mem_req;
+        vkGetImageMemoryRequirements(device, *out_image, &mem_req);
 
-            VkMemoryAllocateInfo allocate_info = {};
-            allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            allocate_info.allocationSize = mem_req.size;
+        VkMemoryAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocate_info.allocationSize = mem_req.size;
+        is_lazily_allocated = vgk_try_find_memory_type(
+            physical_device,
+            mem_req.memoryTypeBits,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+            &allocate_info.memoryTypeIndex);
+        if (!is_lazily_allocated)
+        {
             allocate_info.memoryTypeIndex = vgk_find_memory_type(
                 physical_device,
                 mem_req.memoryTypeBits,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
 
-            result = vkAllocateMemory(device, &allocate_info, NULL, &memory_list[i]);
-            if (result != VK_SUCCESS) fatal("Failed to allocate memory for depth buffer image");
+        result = vgk_allocate_memory(&allocate_info, category, device, out_memory);
+        if (result != VK_SUCCESS) fatal("Failed to allocate memory for attachment image");
 
-            result = vkBindImageMemory(device, images[i], memory_list[i], 0);
-            if (result != VK_SUCCESS) fatal("Failed to bind memory for depth buffer image");
-        }
+        result = vkBindImageMemory(device, *out_image, *out_memory, 0);
+        if (result != VK_SUCCESS) fatal("Failed to bind memory for attachment image");
+    }
 
-        // Image view
-        {
-            VkImageViewCreateInfo create_info = {};
-            create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-            create_info.image = images[i];
-            create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-            create_info.format = depth_format;
-            create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-            create_info.subresourceRange.baseMipLevel = 0;
-            create_info.subresourceRange.levelCount = 1;
-            create_info.subresourceRange.baseArrayLayer = 0;
-            create_info.subresourceRange.layerCount = 1;
+    // Image view
+    {
+        VkImageViewCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        create_info.image = *out_image;
+        create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        create_info.format = format;
+        create_info.subresourceRange.aspectMask = aspect;
+        create_info.subresourceRange.baseMipLevel = 0;
+        create_info.subresourceRange.levelCount = 1;
+        create_info.subresourceRange.baseArrayLayer = 0;
+        create_info.subresourceRange.layerCount = 1;
 
-            VkResult result = vkCreateImageView(device, &create_info, NULL, &image_views[i]);
-            if (result != VK_SUCCESS) fatal("Failed to create image view");
-        }
+        result = vkCreateImageView(device, &create_info, NULL, out_image_view);
+        if (result != VK_SUCCESS) fatal("Failed to create image view");
+    }
+
+    return is_lazily_allocated;
+}
+
+Vgk_DepthImageBundle vgk_create_depth_image_bundle(VkFormat depth_format, VkSampleCountFlagBits samples, u32 frames_in_flight, VkExtent2D swapchain_extent, VkDevice device, VkPhysicalDevice physical_device)
+{
+    Vgk_DepthImageBundle depth_image_bundle = {};
+
+    depth_image_bundle.image_count = frames_in_flight;
+    depth_image_bundle.depth_format = depth_format;
+    depth_image_bundle.samples = samples;
+
+    VkImage *images = (VkImage *)xmalloc(depth_image_bundle.image_count * sizeof(images[0]));
+    VkDeviceMemory *memory_list = (VkDeviceMemory *)xmalloc(depth_image_bundle.image_count * sizeof(memory_list[0]));
+    VkImageView *image_views = (VkImageView *)xmalloc(depth_image_bundle.image_count * sizeof(image_views[0]));
+    depth_image_bundle.is_lazily_allocated = true;
+    for (u32 i = 0; i < depth_image_bundle.image_count; i++)
+    {
+        depth_image_bundle.is_lazily_allocated &= vgk_create_transient_attachment(
+            depth_format, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, samples, swapchain_extent, VGK_MEMORY_DEPTH,
+            &images[i], &memory_list[i], &image_views[i], device, physical_device);
     }
 
     depth_image_bundle.images = images;
@@ -301,41 +369,158 @@ Vgk_DepthImageBundle vgk_create_depth_image_bundle(VkFormat depth_format, u32 im
     return depth_image_bundle;
 }
 
-Vgk_RenderPassBundle vgk_create_render_pass_bundle(const Vgk_SwapchainBundle *swapchain_bundle, const Vgk_DepthImageBundle *depth_image_bundle, bool with_clear, bool is_final, VkDevice device)
+Vgk_MsaaImageBundle vgk_create_msaa_image_bundle(VkFormat color_format, VkSampleCountFlagBits samples, u32 frames_in_flight, VkExtent2D swapchain_extent, VkDevice device, VkPhysicalDevice physical_device)
+{
+    bassert(samples != VK_SAMPLE_COUNT_1_BIT);
+    Vgk_MsaaImageBundle msaa_image_bundle = {};
+
+    msaa_image_bundle.image_count = frames_in_flight;
+    msaa_image_bundle.color_format = color_format;
+    msaa_image_bundle.samples = samples;
+
+    VkImage *images = (VkImage *)xmalloc(msaa_image_bundle.image_count * sizeof(images[0]));
+    VkDeviceMemory *memory_list = (VkDeviceMemory *)xmalloc(msaa_image_bundle.image_count * sizeof(memory_list[0]));
+    VkImageView *image_views = (VkImageView *)xmalloc(msaa_image_bundle.image_count * sizeof(image_views[0]));
+    msaa_image_bundle.is_lazily_allocated = true;
+    for (u32 i = 0; i < msaa_image_bundle.image_count; i++)
+    {
+        msaa_image_bundle.is_lazily_allocated &= vgk_create_transient_attachment(
+            color_format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, samples, swapchain_extent, VGK_MEMORY_COLOR_ATTACHMENT,
+            &images[i], &memory_list[i], &image_views[i], device, physical_device);
+    }
+
+    msaa_image_bundle.images = images;
+    msaa_image_bundle.memory_list = memory_list;
+    msaa_image_bundle.image_views = image_views;
+
+    return msaa_image_bundle;
+}
+
+static u32 vgk_get_frame_attachment_count(const Vgk_DepthImageBundle *depth_image_bundle, const Vgk_MsaaImageBundle *msaa_image_bundle)
+{
+    if (depth_image_bundle && msaa_image_bundle) bassertf(depth_image_bundle->image_count == msaa_image_bundle->image_count, "Depth and MSAA images must both be per frame in flight");
+    if (depth_image_bundle) return depth_image_bundle->image_count;
+    if (msaa_image_bundle) return msaa_image_bundle->image_count;
+    return 1;
+}
+
+// Depth and MSAA images follow the frame in flight, the swapchain image follows the acquired image index
+static void vgk_create_framebuffers(Vgk_RenderPassBundle *bundle, const Vgk_SwapchainBundle *swapchain_bundle, const Vgk_DepthImageBundle *depth_image_bundle, const Vgk_MsaaImageBundle *msaa_image_bundle, VkDevice device)
+{
+    bool with_depth = (depth_image_bundle != NULL);
+    bool with_msaa = (msaa_image_bundle != NULL);
+    bundle->frame_attachment_count = vgk_get_frame_attachment_count(depth_image_bundle, msaa_image_bundle);
+    bundle->framebuffer_count = swapchain_bundle->image_count * bundle->frame_attachment_count;
+
+    VkFramebuffer *framebuffers = (VkFramebuffer *)xmalloc(bundle->framebuffer_count * sizeof(framebuffers[0]));
+    for (u32 i = 0; i < bundle->framebuffer_count; i++)
+    {
+        u32 image_index = i / bundle->frame_attachment_count;
+        u32 frame_index = i % bundle->frame_attachment_count;
+
+        // Same order as the attachment descriptions
+        VkImageView attachments[3];
+        u32 attachment_count = 0;
+        attachments[attachment_count++] = with_msaa ? msaa_image_bundle->image_views[frame_index] : swapchain_bundle->image_views[image_index];
+        if (with_depth) attachments[attachment_count++] = depth_image_bundle->image_views[frame_index];
+        if (with_msaa) attachments[attachment_count++] = swapchain_bundle->image_views[image_index];
+
+        VkFramebufferCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        create_info.renderPass = bundle->render_pass;
+        create_info.width = swapchain_bundle->extent.width;
+        create_info.height = swapchain_bundle->extent.height;
+        create_info.layers = 1;
+        create_info.attachmentCount = attachment_count;
+        create_info.pAttachments = attachments;
+
+        VkResult result = vkCreateFramebuffer(device, &create_info, NULL, &framebuffers[i]);
+        if (result != VK_SUCCESS) fatal("Failed to create framebuffer");
+    }
+    bundle->framebuffers = framebuffers;
+}
+
+// With an MSAA bundle the subpass renders into the multisampled image and resolves into the swapchain image
+// load_presented: the swapchain image is loaded as it was last presented, for redrawing part of it
+static Vgk_RenderPassBundle vgk_create_render_pass_bundle_internal(const Vgk_SwapchainBundle *swapchain_bundle, const Vgk_DepthImageBundle *depth_image_bundle, const Vgk_MsaaImageBundle *msaa_image_bundle, bool with_clear, bool is_final, bool load_presented, VkDevice device)
 {
     bool with_depth = (depth_image_bundle != NULL);
+    bool with_msaa = (msaa_image_bundle != NULL);
     Vgk_RenderPassBundle render_pass_bundle = {};
     render_pass_bundle.color_format = swapchain_bundle->format.format;
     render_pass_bundle.depth_format = with_depth ? depth_image_bundle->depth_format : VK_FORMAT_UNDEFINED;
-    render_pass_bundle.framebuffer_count = swapchain_bundle->image_count;
+    render_pass_bundle.samples = with_msaa ? msaa_image_bundle->samples : VK_SAMPLE_COUNT_1_BIT;
+    if (with_depth) bassertf(depth_image_bundle->samples == render_pass_bundle.samples, "Depth and color sample counts differ");
+    if (with_msaa) bassert(msaa_image_bundle->color_format == render_pass_bundle.color_format);
 
     VkRenderPass render_pass;
     {
-        VkAttachmentDescription color_attachment_description = {};
-        color_attachment_description.format = render_pass_bundle.color_format;
-        color_attachment_description.samples = VK_SAMPLE_COUNT_1_BIT;
-        color_attachment_description.loadOp = with_clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
-        color_attachment_description.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-        color_attachment_description.initialLayout = with_clear ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        color_attachment_description.finalLayout = is_final ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        VkAttachmentDescription attachment_descriptions[3] = {};
+        u32 attachment_count = 0;
 
+        VkAttachmentDescription *color_attachment_description = &attachment_descriptions[attachment_count];
         VkAttachmentReference color_attachment_reference = {};
-        color_attachment_reference.attachment = 0;
+        color_attachment_reference.attachment = attachment_count++;
         color_attachment_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-        VkAttachmentDescription depth_attachment_description = {};
-        depth_attachment_description.format = render_pass_bundle.depth_format;
-        depth_attachment_description.samples = VK_SAMPLE_COUNT_1_BIT;
-        depth_attachment_description.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depth_attachment_description.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        depth_attachment_description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        depth_attachment_description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        depth_attachment_description.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        depth_attachment_description.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        color_attachment_description->format = render_pass_bundle.color_format;
+        color_attachment_description->samples = render_pass_bundle.samples;
+        color_attachment_description->loadOp = with_clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+        color_attachment_description->initialLayout = with_clear ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        if (load_presented && with_msaa)
+        {
+            // Samples of earlier frames aren't stored, the render area is cleared and drawn from scratch
+            color_attachment_description->loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            color_attachment_description->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        }
+        else if (load_presented)
+        {
+            color_attachment_description->initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        }
+        if (with_msaa)
+        {
+            // Samples are only kept around if a later pass loads them
+            color_attachment_description->storeOp = is_final ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+            color_attachment_description->finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
+        else
+        {
+            color_attachment_description->storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            color_attachment_description->finalLayout = is_final ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
 
         VkAttachmentReference depth_attachment_reference = {};
-        depth_attachment_reference.attachment = 1;
-        depth_attachment_reference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        if (with_depth)
+        {
+            VkAttachmentDescription *depth_attachment_description = &attachment_descriptions[attachment_count];
+            depth_attachment_reference.attachment = attachment_count++;
+            depth_attachment_reference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            depth_attachment_description->format = render_pass_bundle.depth_format;
+            depth_attachment_description->samples = render_pass_bundle.samples;
+            depth_attachment_description->loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            depth_attachment_description->storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depth_attachment_description->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            depth_attachment_description->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depth_attachment_description->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            depth_attachment_description->finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        }
+
+        VkAttachmentReference resolve_attachment_reference = {};
+        if (with_msaa)
+        {
+            // The resolve overwrites the whole render area, so what was there before is never read. Pixels
+            // outside the render area keep their presented contents when load_presented is set.
+            VkAttachmentDescription *resolve_attachment_description = &attachment_descriptions[attachment_count];
+            resolve_attachment_reference.attachment = attachment_count++;
+            resolve_attachment_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            resolve_attachment_description->format = render_pass_bundle.color_format;
+            resolve_attachment_description->samples = VK_SAMPLE_COUNT_1_BIT;
+            resolve_attachment_description->loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            resolve_attachment_description->storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            resolve_attachment_description->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            resolve_attachment_description->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            resolve_attachment_description->initialLayout = load_presented ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED;
+            resolve_attachment_description->finalLayout = is_final ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
 
         VkSubpassDescription subpass_description = {};
         subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
@@ -345,60 +530,104 @@ Vgk_RenderPassBundle vgk_create_render_pass_bundle(const Vgk_SwapchainBundle *sw
         {
             subpass_description.pDepthStencilAttachment = &depth_attachment_reference;
         }
+        if (with_msaa)
+        {
+            subpass_description.pResolveAttachments = &resolve_attachment_reference;
+        }
+
+        // The implicit external dependency starts at TOP_OF_PIPE, before the acquire semaphore wait at
+        // COLOR_ATTACHMENT_OUTPUT. Waiting on that stage also orders the depth and MSAA writes after the
+        // previous frame's writes to the same images.
+        VkSubpassDependency dependency = {};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.srcAccessMask = 0;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
         VkRenderPassCreateInfo render_pass_create_info = {};
         render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
         render_pass_create_info.subpassCount = 1;
         render_pass_create_info.pSubpasses = &subpass_description;
-        if (with_depth)
-        {
-            VkAttachmentDescription render_pass_attachments[] = { color_attachment_description, depth_attachment_description };
-            render_pass_create_info.attachmentCount = array_count(render_pass_attachments);
-            render_pass_create_info.pAttachments = render_pass_attachments;
-        }
-        else
-        {
-            render_pass_create_info.attachmentCount = 1;
-            render_pass_create_info.pAttachments = &color_attachment_description;
-        }
+        render_pass_create_info.attachmentCount = attachment_count;
+        render_pass_create_info.pAttachments = attachment_descriptions;
+        render_pass_create_info.dependencyCount = 1;
+        render_pass_create_info.pDependencies = &dependency;
 
         VkResult result = vkCreateRenderPass(device, &render_pass_create_info, NULL, &render_pass);
         if (result != VK_SUCCESS) fatal("Failed to create render pass");
     }
     render_pass_bundle.render_pass = render_pass;
 
-    VkFramebuffer *framebuffers = (VkFramebuffer *)xmalloc(render_pass_bundle.framebuffer_count * sizeof(framebuffers[0]));
-    for (u32 i = 0; i < render_pass_bundle.framebuffer_count; i++)
-    {
-        VkFramebufferCreateInfo create_info = {};
-        create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        create_info.renderPass = render_pass;
-        create_info.width = swapchain_bundle->extent.width;
-        create_info.height = swapchain_bundle->extent.height;
-        create_info.layers = 1;
+    vgk_create_framebuffers(&render_pass_bundle, swapchain_bundle, depth_image_bundle, msaa_image_bundle, device);
 
-        if (with_depth)
-        {
-            VkImageView attachments[] =
-            {
-                swapchain_bundle->image_views[i],
-                depth_image_bundle->image_views[i]
-            };
-            create_info.attachmentCount = array_count(attachments);
-            create_info.pAttachments = attachments;
-        }
-        else
-        {
-            create_info.attachmentCount = 1;
-            create_info.pAttachments = &swapchain_bundle->image_views[i];
-        }
+    return render_pass_bundle;
+}
 
-        VkResult result = vkCreateFramebuffer(device, &create_info, NULL, &framebuffers[i]);
-        if (result != VK_SUCCESS) fatal("Failed to create framebuffer");
+Vgk_RenderPassBundle vgk_create_render_pass_bundle(const Vgk_SwapchainBundle *swapchain_bundle, const Vgk_DepthImageBundle *depth_image_bundle, const Vgk_MsaaImageBundle *msaa_image_bundle, bool with_clear, bool is_final, VkDevice device)
+{
+    return vgk_create_render_pass_bundle_internal(swapchain_bundle, depth_image_bundle, msaa_image_bundle, with_clear, is_final, false, device);
+}
+
+// Final pass that loads the presented swapchain image and redraws part of it, see vgk_cmd_begin_damage_render_pass.
+// Compatible with the full pass from vgk_create_render_pass_bundle, so the same pipelines work with both.
+Vgk_RenderPassBundle vgk_create_damage_render_pass_bundle(const Vgk_SwapchainBundle *swapchain_bundle, const Vgk_DepthImageBundle *depth_image_bundle, const Vgk_MsaaImageBundle *msaa_image_bundle, VkDevice device)
+{
+    return vgk_create_render_pass_bundle_internal(swapchain_bundle, depth_image_bundle, msaa_image_bundle, false, true, true, device);
+}
+
+// For a resized swapchain: the render pass is kept, so pipelines created against it stay valid.
+// The attachments must keep their formats and sample count. Call once the old framebuffers are idle.
+void vgk_recreate_framebuffers(Vgk_RenderPassBundle *bundle, const Vgk_SwapchainBundle *swapchain_bundle, const Vgk_DepthImageBundle *depth_image_bundle, const Vgk_MsaaImageBundle *msaa_image_bundle, VkDevice device)
+{
+    bassert(bundle->color_format == swapchain_bundle->format.format);
+    bassert(bundle->depth_format == (depth_image_bundle ? depth_image_bundle->depth_format : VK_FORMAT_UNDEFINED));
+    bassert(bundle->samples == (msaa_image_bundle ? msaa_image_bundle->samples : VK_SAMPLE_COUNT_1_BIT));
+    for (u32 i = 0; i < bundle->framebuffer_count; i++)
+    {
+        vkDestroyFramebuffer(device, bundle->framebuffers[i], NULL);
     }
-    render_pass_bundle.framebuffers = framebuffers;
+    free(bundle->framebuffers);
+    vgk_create_framebuffers(bundle, swapchain_bundle, depth_image_bundle, msaa_image_bundle, device);
+}
 
-    return render_pass_bundle;
+Vgk_RenderingSpec vgk_make_rendering_spec(const Vgk_SwapchainBundle *swapchain_bundle, const Vgk_DepthImageBundle *depth_image_bundle, const Vgk_MsaaImageBundle *msaa_image_bundle, bool with_clear, bool is_final)
+{
+    Vgk_RenderingSpec spec = {};
+    spec.color_format = swapchain_bundle->format.format;
+    spec.depth_format = depth_image_bundle ? depth_image_bundle->depth_format : VK_FORMAT_UNDEFINED;
+    spec.samples = msaa_image_bundle ? msaa_image_bundle->samples : VK_SAMPLE_COUNT_1_BIT;
+    spec.with_clear = with_clear;
+    spec.is_final = is_final;
+    return spec;
+}
+
+Vgk_RenderingTarget vgk_get_swapchain_rendering_target(const Vgk_SwapchainBundle *swapchain_bundle, const Vgk_DepthImageBundle *depth_image_bundle, const Vgk_MsaaImageBundle *msaa_image_bundle, u32 image_index, u32 frame_index)
+{
+    bassert(image_index < swapchain_bundle->image_count);
+    Vgk_RenderingTarget target = {};
+    if (msaa_image_bundle)
+    {
+        bassert(frame_index < msaa_image_bundle->image_count);
+        target.color_image = msaa_image_bundle->images[frame_index];
+        target.color_image_view = msaa_image_bundle->image_views[frame_index];
+        target.resolve_image = swapchain_bundle->images[image_index];
+        target.resolve_image_view = swapchain_bundle->image_views[image_index];
+    }
+    else
+    {
+        target.color_image = swapchain_bundle->images[image_index];
+        target.color_image_view = swapchain_bundle->image_views[image_index];
+    }
+    if (depth_image_bundle)
+    {
+        bassert(frame_index < depth_image_bundle->image_count);
+        target.depth_image = depth_image_bundle->images[frame_index];
+        target.depth_image_view = depth_image_bundle->image_views[frame_index];
+    }
+    target.extent = swapchain_bundle->extent;
+    return target;
 }
 
 VkCommandPool vgk_create_command_pool(u32 queue_family_index, VkDevice device)
@@ -436,16 +665,6 @@ Vgk_FrameList vgk_create_frame_list(u32 frames_in_flight, VkCommandPool command_
             if (result != VK_SUCCESS) fatal("Failed to allocate command buffer");
         }
 
-        VkFence in_flight_fence;
-        {
-            VkFenceCreateInfo create_info = {};
-            create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-            create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-            VkResult result = vkCreateFence(device, &create_info, NULL, &in_flight_fence);
-            if (result != VK_SUCCESS) fatal("Failed to create in flight fence");
-        }
-
         VkSemaphore acquire_semaphore;
         {
             VkSemaphoreCreateInfo semaphore_create_info = {};
@@ -456,27 +675,65 @@ Vgk_FrameList vgk_create_frame_list(u32 frames_in_flight, VkCommandPool command_
         }
 
         frames[i].command_buffer = command_buffer;
-        frames[i].in_flight_fence = in_flight_fence;
         frames[i].acquire_semaphore = acquire_semaphore;
+        frames[i].timeline_value = 0;
+        frames[i].open_value = 0;
+        frames[i].arena = make_arena(VGK_FRAME_ARENA_RESERVE);
     }
     frame_list.frames = frames;
 
+    VkSemaphore timeline_semaphore;
+    {
+        VkSemaphoreTypeCreateInfo type_create_info = {};
+        type_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_create_info.initialValue = 0;
+
+        VkSemaphoreCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        create_info.pNext = &type_create_info;
+
+        VkResult result = vkCreateSemaphore(device, &create_info, NULL, &timeline_semaphore);
+        if (result != VK_SUCCESS) fatal("Failed to create timeline semaphore");
+    }
+    frame_list.timeline_semaphore = timeline_semaphore;
+    frame_list.frame_index = frame_list.count - 1; // first begin_frame moves to frame 0
+    frame_list.last_submitted_value = 0;
+
     return frame_list;
 }
 
+Vgk_ParallelRecorder vgk_create_parallel_recorder(u32 thread_count, u32 frames_in_flight, u32 queue_family_index, VkDevice device)
+{
+    bassert(thread_count > 0 && thread_count <= MAX_RECORDING_THREADS);
+
+    Vgk_ParallelRecorder recorder = {};
+    recorder.thread_count = thread_count;
+    recorder.frame_count = frames_in_flight;
+    recorder.thread_pool = make_thread_pool(thread_count - 1);
+
+    u32 slot_count = thread_count * frames_in_flight;
+    recorder.slots = (Vgk_RecordSlot *)xcalloc(slot_count * sizeof(recorder.slots[0]));
+    for (u32 i = 0; i < slot_count; i++)
+    {
+        VkCommandPoolCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        create_info.queueFamilyIndex = queue_family_index;
+        create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // re-recorded every frame, reset in bulk
+
+        VkResult result = vkCreateCommandPool(device, &create_info, NULL, &recorder.slots[i].command_pool);
+        if (result != VK_SUCCESS) fatal("Failed to create per-thread command pool");
+    }
+
+    return recorder;
+}
+
+// The timeline never needs a reset; only the binary acquire semaphores can be left signaled
+// by an acquire whose frame was dropped (e.g. out of date swapchain). The device must be idle.
 void vgk_frame_list_reset_sync_objects(Vgk_FrameList *frame_list, VkDevice device)
 {
     for (u32 i = 0; i < frame_list->count; i++)
     {
-        vkDestroyFence(device, frame_list->frames[i].in_flight_fence, NULL);
-        {
-            VkFenceCreateInfo create_info = {};
-            create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-            create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-            VkResult result = vkCreateFence(device, &create_info, NULL, &frame_list->frames[i].in_flight_fence);
-            if (result != VK_SUCCESS) fatal("Failed to create in flight fence");
-        }
         vkDestroySemaphore(device, frame_list->frames[i].acquire_semaphore, NULL);
         {
             VkSemaphoreCreateInfo create_info = {};
@@ -488,6 +745,162 @@ void vgk_frame_list_reset_sync_objects(Vgk_FrameList *frame_list, VkDevice devic
     }
 }
 
+// Moves to the next frame, waits until its previous submission has completed,
+// releases everything deferred for destruction that the GPU is done with and resets the frame's arena.
+// Worker threads use vgk_get_scratch_arena for their own temporaries.
+Vgk_Frame *vgk_frame_list_begin_frame(Vgk_FrameList *frame_list, VkDevice device)
+{
+    u64 alloc_count = get_heap_alloc_count();
+    if (frame_list->last_submitted_value > 0)
+    {
+        frame_list->last_frame_heap_alloc_count = alloc_count - frame_list->frame_heap_alloc_start;
+        if (frame_list->last_frame_heap_alloc_count > 0)
+        {
+            trace("%llu heap allocations during the last frame", (unsigned long long)frame_list->last_frame_heap_alloc_count);
+        }
+    }
+    frame_list->frame_heap_alloc_start = alloc_count;
+
+    // A frame dropped before its submit (e.g. out of date swapchain) recorded nothing that runs
+    frame_list->is_frame_open = false;
+
+    frame_list->frame_index = (frame_list->frame_index + 1) % frame_list->count;
+    Vgk_Frame *frame = &frame_list->frames[frame_list->frame_index];
+    vgk_frame_list_wait_value(frame_list, frame->timeline_value, device);
+    vgk_frame_list_flush_deletions(frame_list, vgk_frame_list_get_completed_value(frame_list, device), device);
+    arena_reset(&frame->arena);
+
+    frame->open_value = frame_list->last_submitted_value + 1;
+    frame_list->is_frame_open = true;
+    return frame;
+}
+
+static u64 vgk_frame_list_submit_internal(Vgk_FrameList *frame_list, VkCommandBuffer command_buffer, VkSemaphore wait_binary_semaphore, u64 wait_value, VkPipelineStageFlags wait_stage, VkSemaphore signal_binary_semaphore, VkQueue queue)
+{
+    u64 signal_value = frame_list->last_submitted_value + 1;
+
+    VkSemaphore wait_semaphores[2];
+    u64 wait_values[2];
+    VkPipelineStageFlags wait_stages[2];
+    u32 wait_count = 0;
+    if (wait_binary_semaphore != VK_NULL_HANDLE)
+    {
+        wait_semaphores[wait_count] = wait_binary_semaphore;
+        wait_values[wait_count] = 0;
+        wait_stages[wait_count] = wait_stage;
+        wait_count++;
+    }
+    if (wait_value > 0)
+    {
+        wait_semaphores[wait_count] = frame_list->timeline_semaphore;
+        wait_values[wait_count] = wait_value;
+        wait_stages[wait_count] = wait_stage;
+        wait_count++;
+    }
+
+    VkSemaphore signal_semaphores[2];
+    u64 signal_values[2];
+    u32 signal_count = 0;
+    signal_semaphores[signal_count] = frame_list->timeline_semaphore;
+    signal_values[signal_count] = signal_value;
+    signal_count++;
+    if (signal_binary_semaphore != VK_NULL_HANDLE)
+    {
+        signal_semaphores[signal_count] = signal_binary_semaphore;
+        signal_values[signal_count] = 0;
+        signal_count++;
+    }
+
+    VkTimelineSemaphoreSubmitInfo timeline_submit_info = {};
+    timeline_submit_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_submit_info.waitSemaphoreValueCount = wait_count;
+    timeline_submit_info.pWaitSemaphoreValues = wait_values;
+    timeline_submit_info.signalSemaphoreValueCount = signal_count;
+    timeline_submit_info.pSignalSemaphoreValues = signal_values;
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_submit_info;
+    submit_info.waitSemaphoreCount = wait_count;
+    submit_info.pWaitSemaphores = wait_semaphores;
+    submit_info.pWaitDstStageMask = wait_stages;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer;
+    submit_info.signalSemaphoreCount = signal_count;
+    submit_info.pSignalSemaphores = signal_semaphores;
+
+    VkResult result = vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE);
+    if (result != VK_SUCCESS) fatal("Failed to submit command buffer. Result: %d", result);
+
+    frame_list->last_submitted_value = signal_value;
+    return signal_value;
+}
+
+// Waits on the frame's acquire semaphore, signals present_semaphore for vkQueuePresentKHR
+// and the next timeline value. Returns that value.
+u64 vgk_frame_list_submit_frame(Vgk_FrameList *frame_list, Vgk_Frame *frame, VkSemaphore present_semaphore, VkQueue queue)
+{
+    frame->timeline_value = vgk_frame_list_submit_internal(
+        frame_list, frame->command_buffer,
+        frame->acquire_semaphore, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        present_semaphore, queue);
+    frame_list->is_frame_open = false;
+    return frame->timeline_value;
+}
+
+// Uploads, compute etc. wait_value of 0 waits on nothing. Returns the value signaled on completion.
+u64 vgk_frame_list_submit(Vgk_FrameList *frame_list, VkCommandBuffer command_buffer, u64 wait_value, VkPipelineStageFlags wait_stage, VkQueue queue)
+{
+    bassert(wait_value <= frame_list->last_submitted_value);
+    return vgk_frame_list_submit_internal(frame_list, command_buffer, VK_NULL_HANDLE, wait_value, wait_stage, VK_NULL_HANDLE, queue);
+}
+
+u64 vgk_frame_list_get_completed_value(const Vgk_FrameList *frame_list, VkDevice device)
+{
+    u64 value;
+    VkResult result = vkGetSemaphoreCounterValue(device, frame_list->timeline_semaphore, &value);
+    if (result != VK_SUCCESS) fatal("Failed to get timeline semaphore value");
+    return value;
+}
+
+// Value to hold a resource for when work being recorded uses it: the next submission. Inside an
+// open frame that isn't necessarily the frame's own, uploads and compute may submit in between,
+// so compare it against the timeline only through vgk_frame_list_resolve_use_value.
+u64 vgk_frame_list_get_use_value(const Vgk_FrameList *frame_list)
+{
+    return frame_list->last_submitted_value + 1;
+}
+
+// Timeline value after which a use from vgk_frame_list_get_use_value is over. Uses taken while a
+// frame was open last until that frame's submission, VGK_TIMELINE_PENDING until it is made.
+u64 vgk_frame_list_resolve_use_value(const Vgk_FrameList *frame_list, u64 use_value)
+{
+    for (u32 i = 0; i < frame_list->count; i++)
+    {
+        const Vgk_Frame *frame = &frame_list->frames[i];
+        if (frame->open_value == 0 || use_value < frame->open_value) continue;
+        if (frame_list->is_frame_open && i == frame_list->frame_index) return VGK_TIMELINE_PENDING;
+        // Empty for a frame that was dropped before its submit
+        if (use_value <= frame->timeline_value) return frame->timeline_value;
+    }
+    // Older than every frame still tracked, whose submissions have completed since
+    return use_value;
+}
+
+void vgk_frame_list_wait_value(const Vgk_FrameList *frame_list, u64 value, VkDevice device)
+{
+    if (value == 0) return;
+
+    VkSemaphoreWaitInfo wait_info = {};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &frame_list->timeline_semaphore;
+    wait_info.pValues = &value;
+
+    VkResult result = vkWaitSemaphores(device, &wait_info, UINT64_MAX);
+    if (result != VK_SUCCESS) fatal("Failed to wait on timeline semaphore. Result: %d", result);
+}
+
 VkShaderModule vgk_create_shader_module(const char *path, VkDevice device)
 {
     FILE *file = fopen(path, "rb");
@@ -495,7 +908,9 @@ VkShaderModule vgk_create_shader_module(const char *path, VkDevice device)
     fseek(file, 0, SEEK_END);
     long size = ftell(file);
     rewind(file);
-    char* buffer = (char *)xmalloc(size);
+    // SPIR-V is read as u32 words, the scratch allocation keeps it aligned
+    ArenaTemp scratch = arena_temp_begin(vgk_get_scratch_arena());
+    u32 *buffer = arena_alloc_array(scratch.arena, u32, ((size_t)size + 3) / 4);
     fread(buffer, 1, size, file);
     fclose(file);
 
@@ -504,17 +919,17 @@ VkShaderModule vgk_create_shader_module(const char *path, VkDevice device)
         VkShaderModuleCreateInfo create_info = {};
         create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
         create_info.codeSize = (size_t)size;
-        create_info.pCode = (uint32_t *)buffer;
+        create_info.pCode = buffer;
 
         VkResult result = vkCreateShaderModule(device, &create_info, NULL, &module);
         if (result != VK_SUCCESS) fatal("Failed to create shader module");
     }
 
-    free(buffer);
+    arena_temp_end(scratch);
     return module;
 }
 
-Vgk_BufferBundle vgk_create_buffer_bundle(VkDeviceSize size, VkBufferUsageFlags usage, VkDevice device, VkPhysicalDevice physical_device)
+Vgk_BufferBundle vgk_create_buffer_bundle(VkDeviceSize size, VkBufferUsageFlags usage, Vgk_MemoryAccess access, VkDevice device, VkPhysicalDevice physical_device)
 {
     VkBuffer buffer;
     {
@@ -529,41 +944,81 @@ Vgk_BufferBundle vgk_create_buffer_bundle(VkDeviceSize size, VkBufferUsageFlags
     }
 
     VkDeviceMemory device_memory;
+    VkMemoryPropertyFlags memory_props;
+    VkDeviceSize allocation_size;
     {
         VkMemoryRequirements memory_requirements;
         vkGetBufferMemoryRequirements(device, buffer, &memory_requirements);
 
+        VkMemoryPropertyFlags required = access == VGK_MEMORY_ACCESS_GPU_ONLY ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        VkMemoryPropertyFlags preferred = 0;
+        VkMemoryPropertyFlags secondary = 0;
+        VkMemoryPropertyFlags avoided = 0;
+        switch (access)
+        {
+            case VGK_MEMORY_ACCESS_SEQUENTIAL_WRITE:
+                required |= VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+                avoided = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+                break;
+            case VGK_MEMORY_ACCESS_RANDOM:
+                preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+                secondary = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+                break;
+            case VGK_MEMORY_ACCESS_READBACK:
+                preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+                secondary = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+                avoided = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+                break;
+            case VGK_MEMORY_ACCESS_GPU_ONLY:
+                // Leaves the small host-visible device heap to buffers that are mapped
+                avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+                break;
+        }
+
         VkMemoryAllocateInfo allocate_info = {};
         allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
         allocate_info.allocationSize = memory_requirements.size;
-        allocate_info.memoryTypeIndex = vgk_find_memory_type(
-            physical_device,
-            memory_requirements.memoryTypeBits,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        );
+        if (!vgk_try_find_preferred_memory_type(physical_device, memory_requirements.memoryTypeBits, required, preferred, secondary, avoided, &allocate_info.memoryTypeIndex))
+        {
+            fatal("Failed to find memory type for access %d", access);
+        }
+        allocation_size = memory_requirements.size;
 
-        VkResult result = vkAllocateMemory(device, &allocate_info, NULL, &device_memory);
+        VkPhysicalDeviceMemoryProperties mem_props;
+        vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_props);
+        memory_props = mem_props.memoryTypes[allocate_info.memoryTypeIndex].propertyFlags;
+
+        VkResult result = vgk_allocate_memory(&allocate_info, vgk_get_buffer_memory_category(usage), device, &device_memory);
         if (result != VK_SUCCESS) fatal("Failed to allocate memory for uniform buffer");
 
         result = vkBindBufferMemory(device, buffer, device_memory, 0);
         if (result != VK_SUCCESS) fatal("Failed to bind memory to uniform buffer");
     }
 
-    void *data;
+    void *data = NULL;
+    if (access != VGK_MEMORY_ACCESS_GPU_ONLY)
     {
-        VkResult result = vkMapMemory(device, device_memory, 0, size, 0, &data);
+        // Whole allocation, so atom-aligned flush ranges past size stay inside the mapping
+        VkResult result = vkMapMemory(device, device_memory, 0, VK_WHOLE_SIZE, 0, &data);
         if (result != VK_SUCCESS) fatal("Failed to map vertex buffer memory");
     }
 
+    VkPhysicalDeviceProperties device_props;
+    vkGetPhysicalDeviceProperties(physical_device, &device_props);
+
     Vgk_BufferBundle buffer_bundle = {};
     buffer_bundle.buffer = buffer;
     buffer_bundle.memory = device_memory;
     buffer_bundle.data_ptr = data;
     buffer_bundle.size = size;
+    buffer_bundle.allocation_size = allocation_size;
+    buffer_bundle.atom_size = device_props.limits.nonCoherentAtomSize;
+    buffer_bundle.is_coherent = (memory_props & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    buffer_bundle.is_cached = (memory_props & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0;
     return buffer_bundle;
 }
 
-Vgk_BufferBundleList vgk_create_buffer_bundle_list(VkDeviceSize max_size, VkBufferUsageFlags usage, u32 frames_in_flight, VkDevice device, VkPhysicalDevice physical_device)
+Vgk_BufferBundleList vgk_create_buffer_bundle_list(VkDeviceSize max_size, VkBufferUsageFlags usage, Vgk_MemoryAccess access, u32 frames_in_flight, VkDevice device, VkPhysicalDevice physical_device)
 {
     Vgk_BufferBundleList buffer_bundle_list = {};
     buffer_bundle_list.count = frames_in_flight;
@@ -571,28 +1026,105 @@ Vgk_BufferBundleList vgk_create_buffer_bundle_list(VkDeviceSize max_size, VkBuff
     Vgk_BufferBundle *buffer_bundles = (Vgk_BufferBundle *)xmalloc(buffer_bundle_list.count * sizeof(buffer_bundles[0]));
     for (u32 i = 0; i < buffer_bundle_list.count; i++)
     {
-        buffer_bundles[i] = vgk_create_buffer_bundle(max_size, usage, device, physical_device);
+        buffer_bundles[i] = vgk_create_buffer_bundle(max_size, usage, access, device, physical_device);
     }
     buffer_bundle_list.buffer_bundles = buffer_bundles;
 
     return buffer_bundle_list;
 }
 
-void vgk_destroy_buffer_bundle(Vgk_BufferBundle *bundle);
+Vgk_IndirectDrawList vgk_create_indirect_draw_list(u32 max_command_count, u32 frames_in_flight, VkDevice device, VkPhysicalDevice physical_device)
+{
+    Vgk_DeviceCaps caps = vgk_get_device_caps(physical_device);
+
+    Vgk_IndirectDrawList list = {};
+    list.max_command_count = max_command_count;
+    list.use_multi_draw = caps.multi_draw_indirect;
+    list.use_draw_count = caps.draw_indirect_count;
+    list.allow_first_instance = caps.draw_indirect_first_instance;
+    list.max_draw_indirect_count = caps.max_draw_indirect_count;
+
+    // Storage and transfer usage let compute passes and fills write the same buffers. They stay in device
+    // memory so the cull pass's atomics and fills don't cross the bus; CPU batches are copied in.
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    list.command_buffers = vgk_create_buffer_bundle_list(
+        max_command_count * sizeof(VkDrawIndexedIndirectCommand),
+        usage,
+        VGK_MEMORY_ACCESS_GPU_ONLY,
+        frames_in_flight,
+        device,
+        physical_device);
+
+    list.count_buffers = vgk_create_buffer_bundle_list(
+        MAX_INDIRECT_BATCHES * sizeof(u32),
+        usage,
+        VGK_MEMORY_ACCESS_GPU_ONLY,
+        frames_in_flight,
+        device,
+        physical_device);
+
+    list.upload_buffers = vgk_create_buffer_bundle_list(
+        max_command_count * sizeof(VkDrawIndexedIndirectCommand) + MAX_INDIRECT_BATCHES * sizeof(u32),
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VGK_MEMORY_ACCESS_SEQUENTIAL_WRITE,
+        frames_in_flight,
+        device,
+        physical_device);
+
+    return list;
+}
 
-Vgk_TextureBundle vgk_load_texture_from_pixels(void *pixels, u32 w, u32 h, VkDeviceSize image_size, VkFormat format, VkDevice device, VkPhysicalDevice physical_device, VkCommandPool command_pool, VkQueue queue)
+Vgk_CullPass vgk_create_cull_pass(const char *comp_shader_path, u32 max_object_count, const Vgk_IndirectDrawList *draw_list, Vgk_DescriptorPoolBundle *descriptor_pool_bundle, VkDevice device, VkPhysicalDevice physical_device)
 {
-    Vgk_BufferBundle staging_buffer = vgk_create_buffer_bundle(image_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, device, physical_device);
+    Vgk_CullPass pass = {};
+    pass.max_object_count = max_object_count;
+    pass.frame_count = draw_list->command_buffers.count;
+
+    Vgk_DescriptorSetSpec descriptor_set_spec = vgk_make_descriptor_set_spec();
+    vgk_add_descriptor_binding(&descriptor_set_spec, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT); // objects
+    vgk_add_descriptor_binding(&descriptor_set_spec, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT); // draw commands
+    vgk_add_descriptor_binding(&descriptor_set_spec, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT); // draw counts
+
+    Vgk_ComputePipelineSpec pipeline_spec = vgk_make_compute_pipeline_spec();
+    vgk_set_comp_shader_path(&pipeline_spec, comp_shader_path);
+    vgk_add_compute_descriptor_set(&pipeline_spec, &descriptor_set_spec);
+    vgk_add_compute_push_constant(&pipeline_spec, sizeof(Vgk_CullPushConstants));
+    pass.pipeline_bundle = vgk_create_compute_pipeline_from_spec(&pipeline_spec, device);
+
+    pass.object_buffers = vgk_create_buffer_bundle_list(
+        max_object_count * sizeof(Vgk_CullObject),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VGK_MEMORY_ACCESS_SEQUENTIAL_WRITE,
+        pass.frame_count,
+        device,
+        physical_device);
+
+    pass.object_counts = (u32 *)xcalloc(pass.frame_count * sizeof(pass.object_counts[0]));
+
+    pass.descriptor_sets = (Vgk_DescriptorSetBundle *)xmalloc(pass.frame_count * sizeof(pass.descriptor_sets[0]));
+    for (u32 i = 0; i < pass.frame_count; i++)
+    {
+        Vgk_DescriptorSetBundle *set = &pass.descriptor_sets[i];
+        *set = vgk_create_descriptor_set_bundle_from_spec(descriptor_pool_bundle, &descriptor_set_spec, device);
+        vgk_update_buffer_descriptor(set, 0, pass.object_buffers.buffer_bundles[i].buffer, 0, VK_WHOLE_SIZE, device);
+        vgk_update_buffer_descriptor(set, 1, draw_list->command_buffers.buffer_bundles[i].buffer, 0, VK_WHOLE_SIZE, device);
+        vgk_update_buffer_descriptor(set, 2, draw_list->count_buffers.buffer_bundles[i].buffer, 0, VK_WHOLE_SIZE, device);
+    }
 
-    memcpy(staging_buffer.data_ptr, pixels, (size_t)image_size);
+    return pass;
+}
 
+// components: the image view swizzle, zero for identity
+static Vgk_TextureBundle vgk_create_texture_bundle_internal(u32 width, u32 height, VkFormat format, VkComponentMapping components, VkDevice device, VkPhysicalDevice physical_device)
+{
     VkImage image;
     {
         VkImageCreateInfo create_info = {};
         create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         create_info.imageType = VK_IMAGE_TYPE_2D;
         create_info.format = format;
-        create_info.extent = (VkExtent3D){ w, h, 1 };
+        create_info.extent = (VkExtent3D){ width, height, 1 };
         create_info.mipLevels = 1;
         create_info.arrayLayers = 1;
         create_info.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -619,138 +1151,21 @@ Vgk_TextureBundle vgk_load_texture_from_pixels(void *pixels, u32 w, u32 h, VkDev
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
         );
 
-        VkResult result = vkAllocateMemory(device, &allocate_info, NULL, &memory);
+        VkResult result = vgk_allocate_memory(&allocate_info, VGK_MEMORY_TEXTURE, device, &memory);
         if (result != VK_SUCCESS) fatal("Failed to allocate memory for texture image");
 
         result = vkBindImageMemory(device, image, memory, 0);
         if (result != VK_SUCCESS) fatal("Failed to bind memory to texture image");
     }
 
-    VkCommandBuffer command_buffer;
-    {
-        VkCommandBufferAllocateInfo allocate_info = {};
-        allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocate_info.commandPool = command_pool;
-        allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocate_info.commandBufferCount = 1;
-
-        VkResult result = vkAllocateCommandBuffers(device, &allocate_info, &command_buffer);
-        if (result != VK_SUCCESS) fatal("Failed to allocate command buffer for texture");
-    }
-
-    // Copy texture from staging buffer to image (GPU side) -- record commands
-    {
-        {
-            VkCommandBufferBeginInfo begin_info = {};
-            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-            VkResult result = vkBeginCommandBuffer(command_buffer, &begin_info);
-            if (result != VK_SUCCESS) fatal("Failed to begin texture command buffer");
-        }
-
-        // Image layout: UNDEFINED -> TRANSFER_DST_OPTIMAL
-        {
-            VkImageMemoryBarrier barrier = {};
-            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.image = image;
-            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            barrier.subresourceRange.baseMipLevel = 0;
-            barrier.subresourceRange.levelCount = 1;
-            barrier.subresourceRange.baseArrayLayer = 0;
-            barrier.subresourceRange.layerCount = 1;
-
-            vkCmdPipelineBarrier(
-                command_buffer,
-                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                0,
-                0, NULL,
-                0, NULL,
-                1, &barrier
-            );
-        }
-
-        // Copy buffer to image
-        {
-            VkBufferImageCopy copy = {};
-            copy.bufferOffset = 0;
-            copy.bufferRowLength = 0;
-            copy.bufferImageHeight = 0;
-            copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            copy.imageSubresource.mipLevel = 0;
-            copy.imageSubresource.baseArrayLayer = 0;
-            copy.imageSubresource.layerCount = 1;
-            copy.imageOffset = (VkOffset3D){0, 0, 0};
-            copy.imageExtent = (VkExtent3D){w, h, 1};
-
-            vkCmdCopyBufferToImage(
-                command_buffer,
-                staging_buffer.buffer,
-                image,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                1,
-                &copy
-            );
-        }
-
-        // Image layout: TRANSFER_DST_OPTIMAL -> SHADER_READ_ONLY_OPTIMAL
-        {
-            VkImageMemoryBarrier barrier = {};
-            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            barrier.image = image;
-            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            barrier.subresourceRange.baseMipLevel = 0;
-            barrier.subresourceRange.levelCount = 1;
-            barrier.subresourceRange.baseArrayLayer = 0;
-            barrier.subresourceRange.layerCount = 1;
-
-            vkCmdPipelineBarrier(
-                command_buffer,
-                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                0,
-                0, NULL,
-                0, NULL,
-                1, &barrier
-            );
-        }
-
-        VkResult result = vkEndCommandBuffer(command_buffer);
-        if (result != VK_SUCCESS) fatal("Failed to end texture command buffer");
-    }
-
-    // Copy texture from staging buffer to image (GPU side) -- submit command buffer
-    {
-        VkSubmitInfo submit_info = {};
-        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers = &command_buffer;
-
-        VkResult result = vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE);
-        if (result != VK_SUCCESS) fatal("Failed to submit texture command buffer to queue");
-    }
-
-    // Wait until the queue is idle
-    {
-        VkResult result = vkQueueWaitIdle(queue);
-        if (result != VK_SUCCESS) fatal("Failed to wait idle for queue");
-    }
-
-    vgk_destroy_buffer_bundle(&staging_buffer, device);
-
-    VkImageView image_view;
+    VkImageView image_view;
     {
         VkImageViewCreateInfo create_info = {};
         create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
         create_info.image = image;
         create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
         create_info.format = format;
+        create_info.components = components;
         create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         create_info.subresourceRange.baseMipLevel = 0;
         create_info.subresourceRange.levelCount = 1;
@@ -787,29 +1202,43 @@ Vgk_TextureBundle vgk_load_texture_from_pixels(void *pixels, u32 w, u32 h, VkDev
     texture_bundle.image_view = image_view;
     texture_bundle.sampler = sampler;
     texture_bundle.format = format;
+    texture_bundle.extent = (VkExtent2D){ width, height };
+    texture_bundle.layout = VK_IMAGE_LAYOUT_UNDEFINED;
     return texture_bundle;
 }
 
+Vgk_TextureBundle vgk_create_texture_bundle(u32 width, u32 height, VkFormat format, VkDevice device, VkPhysicalDevice physical_device)
+{
+    return vgk_create_texture_bundle_internal(width, height, format, (VkComponentMapping){}, device, physical_device);
+}
+
 Vgk_DescriptorPoolBundle vgk_create_descriptor_pool_bundle(VkDevice device)
 {
     Vgk_DescriptorPoolBundle bundle = {};
     bundle.max_sets = MAX_DESCRIPTOR_SETS_IN_POOL;
     bundle.max_uniform_buffers = MAX_UNIFORM_BUFFERS_IN_POOL;
     bundle.max_image_samplers = MAX_IMAGE_SAMPLERS_IN_POOL;
+    bundle.max_storage_buffers = MAX_STORAGE_BUFFERS_IN_POOL;
+    bundle.max_storage_images = MAX_STORAGE_IMAGES_IN_POOL;
 
     VkDescriptorPool descriptor_pool;
     {
-        VkDescriptorPoolSize descriptor_pool_sizes[2] = {};
+        VkDescriptorPoolSize descriptor_pool_sizes[4] = {};
         descriptor_pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         descriptor_pool_sizes[0].descriptorCount = bundle.max_uniform_buffers;
         descriptor_pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         descriptor_pool_sizes[1].descriptorCount = bundle.max_image_samplers;
+        descriptor_pool_sizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptor_pool_sizes[2].descriptorCount = bundle.max_storage_buffers;
+        descriptor_pool_sizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        descriptor_pool_sizes[3].descriptorCount = bundle.max_storage_images;
 
         VkDescriptorPoolCreateInfo create_info = {};
         create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         create_info.poolSizeCount = array_count(descriptor_pool_sizes);
         create_info.pPoolSizes = descriptor_pool_sizes;
         create_info.maxSets = bundle.max_sets;
+        create_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT; // for deferred descriptor set frees
 
         VkResult result = vkCreateDescriptorPool(device, &create_info, NULL, &descriptor_pool);
         if (result != VK_SUCCESS) fatal("Failed to create descriptor pool");
@@ -841,6 +1270,20 @@ void vgk_check_descriptor_pool_availability(Vgk_DescriptorPoolBundle *descriptor
                 descriptor_pool_bundle->image_sampler_count = new_count;
             } break;
 
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+            {
+                u32 new_count = descriptor_pool_bundle->storage_buffer_count + binding_ref->descriptor_count;
+                bassert(new_count < descriptor_pool_bundle->max_storage_buffers);
+                descriptor_pool_bundle->storage_buffer_count = new_count;
+            } break;
+
+            case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+            {
+                u32 new_count = descriptor_pool_bundle->storage_image_count + binding_ref->descriptor_count;
+                bassert(new_count < descriptor_pool_bundle->max_storage_images);
+                descriptor_pool_bundle->storage_image_count = new_count;
+            } break;
+
             default: fatal("Descriptor type not implemented");
         }
     }
@@ -899,6 +1342,49 @@ Vgk_DescriptorSetBundle vgk_create_descriptor_set_bundle_from_spec(Vgk_Descripto
     return descriptor_set_bundle;
 }
 
+void vgk_update_buffer_descriptor(const Vgk_DescriptorSetBundle *descriptor_set_bundle, u32 binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range, VkDevice device)
+{
+    bassert(binding < descriptor_set_bundle->spec.binding_count);
+
+    VkDescriptorBufferInfo buffer_info = {};
+    buffer_info.buffer = buffer;
+    buffer_info.offset = offset;
+    buffer_info.range = range;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptor_set_bundle->descriptor_set;
+    write.dstBinding = binding;
+    write.dstArrayElement = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = descriptor_set_bundle->spec.bindings[binding].descriptor_type;
+    write.pBufferInfo = &buffer_info;
+
+    vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+}
+
+void vgk_update_image_descriptor(const Vgk_DescriptorSetBundle *descriptor_set_bundle, u32 binding, u32 array_index, VkImageView image_view, VkSampler sampler, VkImageLayout layout, VkDevice device)
+{
+    bassert(binding < descriptor_set_bundle->spec.binding_count);
+    bassert(array_index < descriptor_set_bundle->spec.bindings[binding].descriptor_count);
+
+    VkDescriptorImageInfo image_info = {};
+    image_info.imageView = image_view;
+    image_info.sampler = sampler;
+    image_info.imageLayout = layout;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptor_set_bundle->descriptor_set;
+    write.dstBinding = binding;
+    write.dstArrayElement = array_index;
+    write.descriptorCount = 1;
+    write.descriptorType = descriptor_set_bundle->spec.bindings[binding].descriptor_type;
+    write.pImageInfo = &image_info;
+
+    vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+}
+
 Vgk_VertInputSpec vgk_make_vert_input_spec(size_t stride)
 {
     Vgk_VertInputSpec description = {};
@@ -941,12 +1427,14 @@ Vgk_PipelineSpec vgk_make_pipeline_spec()
 
 void vgk_set_vert_shader_path(Vgk_PipelineSpec *spec, const char *path)
 {
-    spec->vert_shader_path = xstrdup(path);
+    bassertf(strlen(path) < MAX_SHADER_PATH_LENGTH, "Shader path too long: %s", path);
+    snprintf(spec->vert_shader_path, sizeof(spec->vert_shader_path), "%s", path);
 }
 
 void vgk_set_frag_shader_path(Vgk_PipelineSpec *spec, const char *path)
 {
-    spec->frag_shader_path = xstrdup(path);
+    bassertf(strlen(path) < MAX_SHADER_PATH_LENGTH, "Shader path too long: %s", path);
+    snprintf(spec->frag_shader_path, sizeof(spec->frag_shader_path), "%s", path);
 }
 
 void vgk_set_frame_count(Vgk_PipelineSpec *spec, u32 frame_count)
@@ -954,14 +1442,43 @@ void vgk_set_frame_count(Vgk_PipelineSpec *spec, u32 frame_count)
     spec->frame_count = frame_count;
 }
 
-void vgk_add_descriptor_set(Vgk_PipelineSpec *spec, const Vgk_DescriptorSetSpec *descriptor_set_spec)
+static void vgk_add_layout_descriptor_set(Vgk_PipelineLayoutSpec *layout_spec, const Vgk_DescriptorSetSpec *descriptor_set_spec)
 {
-    Vgk_PipelineLayoutSpec *layout_spec = &spec->pipeline_layout_spec;
     bassert(layout_spec->descriptor_set_count < MAX_DESCRIPTOR_SETS);
     layout_spec->descriptor_sets[layout_spec->descriptor_set_count++] = *descriptor_set_spec;
 }
 
-// void vgk_add_push_constant(Vgk_PipelineSpec *spec);
+static void vgk_add_layout_push_constant(Vgk_PipelineLayoutSpec *layout_spec, VkShaderStageFlags stage_flags, u32 size)
+{
+    bassert(layout_spec->push_constant_range_count < MAX_PUSH_CONSTANT_RANGES);
+    // Ranges are laid out back to back in the order they are added
+    u32 offset = 0;
+    for (u32 i = 0; i < layout_spec->push_constant_range_count; i++)
+    {
+        const VkPushConstantRange *range = &layout_spec->push_constant_ranges[i];
+        if (range->offset + range->size > offset) offset = range->offset + range->size;
+    }
+    // 128 bytes is the guaranteed minimum, used for specs built before the device exists
+    u32 max_size = vgk_device_caps.max_push_constants_size ? vgk_device_caps.max_push_constants_size : 128;
+    bassertf(size > 0 && size % 4 == 0, "Push constant size %u must be a non-zero multiple of 4", size);
+    bassertf(offset % 4 == 0, "Push constant offset %u must be a multiple of 4", offset);
+    bassertf(offset + size <= max_size, "Push constants end at %u, the device limit is %u bytes", offset + size, max_size);
+    VkPushConstantRange range = {};
+    range.stageFlags = stage_flags;
+    range.offset = offset;
+    range.size = size;
+    layout_spec->push_constant_ranges[layout_spec->push_constant_range_count++] = range;
+}
+
+void vgk_add_descriptor_set(Vgk_PipelineSpec *spec, const Vgk_DescriptorSetSpec *descriptor_set_spec)
+{
+    vgk_add_layout_descriptor_set(&spec->pipeline_layout_spec, descriptor_set_spec);
+}
+
+void vgk_add_push_constant(Vgk_PipelineSpec *spec, VkShaderStageFlags stage_flags, u32 size)
+{
+    vgk_add_layout_push_constant(&spec->pipeline_layout_spec, stage_flags, size);
+}
 
 void vgk_set_vert_input(Vgk_PipelineSpec *spec, const Vgk_VertInputSpec *vert_input)
 {
@@ -978,6 +1495,16 @@ void vgk_set_scissor(Vgk_PipelineSpec *spec, VkRect2D scissor)
     spec->scissor = scissor;
 }
 
+void vgk_set_dynamic_viewport(Vgk_PipelineSpec *spec, bool enable)
+{
+    spec->dynamic_viewport = enable;
+}
+
+void vgk_set_dynamic_scissor(Vgk_PipelineSpec *spec, bool enable)
+{
+    spec->dynamic_scissor = enable;
+}
+
 void vgk_set_rasterization_state(Vgk_PipelineSpec *spec, VkPolygonMode polygon_mode, f32 line_width, VkCullModeFlags cull_mode, VkFrontFace front_face)
 {
     spec->polygon_mode = polygon_mode;
@@ -1006,6 +1533,14 @@ void vgk_set_render_pass(Vgk_PipelineSpec *spec, VkRenderPass render_pass)
     spec->render_pass = render_pass;
 }
 
+void vgk_set_rendering_spec(Vgk_PipelineSpec *spec, const Vgk_RenderingSpec *rendering_spec)
+{
+    spec->render_pass = VK_NULL_HANDLE;
+    spec->color_format = rendering_spec->color_format;
+    spec->depth_format = rendering_spec->depth_format;
+    spec->rasterization_samples = rendering_spec->samples;
+}
+
 VkPipelineLayout vgk_create_pipeline_layout_from_spec(const Vgk_PipelineLayoutSpec *spec, VkDevice device)
 {
     VkPipelineLayout pipeline_layout;
@@ -1019,6 +1554,8 @@ VkPipelineLayout vgk_create_pipeline_layout_from_spec(const Vgk_PipelineLayoutSp
         create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         create_info.setLayoutCount = spec->descriptor_set_count;
         create_info.pSetLayouts = descriptor_set_layouts;
+        create_info.pushConstantRangeCount = spec->push_constant_range_count;
+        create_info.pPushConstantRanges = spec->push_constant_ranges;
 
         VkResult result = vkCreatePipelineLayout(device, &create_info, NULL, &pipeline_layout);
         if (result != VK_SUCCESS) fatal("Failed to create pipeline layout");
@@ -1034,8 +1571,10 @@ VkPipelineLayout vgk_create_pipeline_layout_from_spec(const Vgk_PipelineLayoutSp
 
 Vgk_PipelineBundle vgk_create_pipeline_from_spec(const Vgk_PipelineSpec *spec, VkDevice device)
 {
+    bassertf(spec->render_pass != VK_NULL_HANDLE || spec->color_format != VK_FORMAT_UNDEFINED, "Pipeline spec has neither a render pass nor a color format");
+    bassertf(spec->render_pass != VK_NULL_HANDLE || vgk_device_caps.dynamic_rendering, "Pipeline without a render pass needs dynamic rendering");
+
     Vgk_PipelineBundle pipeline_bundle = {};
-    pipeline_bundle.spec = *spec;
 
     pipeline_bundle.layout = vgk_create_pipeline_layout_from_spec(&spec->pipeline_layout_spec, device);
 
@@ -1127,6 +1666,15 @@ Vgk_PipelineBundle vgk_create_pipeline_from_spec(const Vgk_PipelineSpec *spec, V
             depth_stencil_state.stencilTestEnable = VK_FALSE;
         }
 
+        VkDynamicState dynamic_states[2];
+        u32 dynamic_state_count = 0;
+        if (spec->dynamic_viewport) dynamic_states[dynamic_state_count++] = VK_DYNAMIC_STATE_VIEWPORT;
+        if (spec->dynamic_scissor) dynamic_states[dynamic_state_count++] = VK_DYNAMIC_STATE_SCISSOR;
+        VkPipelineDynamicStateCreateInfo dynamic_state = {};
+        dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamic_state.dynamicStateCount = dynamic_state_count;
+        dynamic_state.pDynamicStates = dynamic_states;
+
         VkGraphicsPipelineCreateInfo create_info = {};
         create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
         create_info.stageCount = array_count(shader_stages);
@@ -1138,10 +1686,21 @@ Vgk_PipelineBundle vgk_create_pipeline_from_spec(const Vgk_PipelineSpec *spec, V
         create_info.pMultisampleState = &multisample_state;
         create_info.pColorBlendState = &color_blend_state;
         create_info.pDepthStencilState = &depth_stencil_state;
+        create_info.pDynamicState = dynamic_state_count > 0 ? &dynamic_state : NULL;
         create_info.layout = pipeline_bundle.layout;
         create_info.renderPass = spec->render_pass;
         create_info.subpass = 0;
-        
+
+        VkPipelineRenderingCreateInfo rendering_create_info = {};
+        if (spec->render_pass == VK_NULL_HANDLE)
+        {
+            rendering_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+            rendering_create_info.colorAttachmentCount = 1;
+            rendering_create_info.pColorAttachmentFormats = &spec->color_format;
+            rendering_create_info.depthAttachmentFormat = spec->depth_format;
+            create_info.pNext = &rendering_create_info;
+        }
+
         VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &create_info, NULL, &pipeline);
         if (result != VK_SUCCESS) fatal("Failed to create graphics pipeline");
 
@@ -1153,131 +1712,3702 @@ Vgk_PipelineBundle vgk_create_pipeline_from_spec(const Vgk_PipelineSpec *spec, V
     return pipeline_bundle;
 }
 
-// ==================== DESTROY =================================
+Vgk_ComputePipelineSpec vgk_make_compute_pipeline_spec()
+{
+    Vgk_ComputePipelineSpec spec = {};
+    return spec;
+}
 
-void vgk_destroy_swapchain_bundle(Vgk_SwapchainBundle *bundle, VkDevice device)
+void vgk_set_comp_shader_path(Vgk_ComputePipelineSpec *spec, const char *path)
 {
-    free(bundle->images);
-    for (u32 i = 0; i < bundle->image_count; i++)
+    bassertf(strlen(path) < MAX_SHADER_PATH_LENGTH, "Shader path too long: %s", path);
+    snprintf(spec->comp_shader_path, sizeof(spec->comp_shader_path), "%s", path);
+}
+
+void vgk_add_compute_descriptor_set(Vgk_ComputePipelineSpec *spec, const Vgk_DescriptorSetSpec *descriptor_set_spec)
+{
+    vgk_add_layout_descriptor_set(&spec->pipeline_layout_spec, descriptor_set_spec);
+}
+
+void vgk_add_compute_push_constant(Vgk_ComputePipelineSpec *spec, u32 size)
+{
+    vgk_add_layout_push_constant(&spec->pipeline_layout_spec, VK_SHADER_STAGE_COMPUTE_BIT, size);
+}
+
+Vgk_ComputePipelineBundle vgk_create_compute_pipeline_from_spec(const Vgk_ComputePipelineSpec *spec, VkDevice device)
+{
+    Vgk_ComputePipelineBundle pipeline_bundle = {};
+
+    pipeline_bundle.layout = vgk_create_pipeline_layout_from_spec(&spec->pipeline_layout_spec, device);
+
+    VkPipeline pipeline;
     {
-        vkDestroySemaphore(device, bundle->submit_semaphores[i], NULL);
-        vkDestroyImageView(device, bundle->image_views[i], NULL);
+        VkShaderModule comp_shader_module = vgk_create_shader_module(spec->comp_shader_path, device);
+
+        VkPipelineShaderStageCreateInfo shader_stage = {};
+        shader_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shader_stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        shader_stage.module = comp_shader_module;
+        shader_stage.pName = "main";
+
+        VkComputePipelineCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        create_info.stage = shader_stage;
+        create_info.layout = pipeline_bundle.layout;
+
+        VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &create_info, NULL, &pipeline);
+        if (result != VK_SUCCESS) fatal("Failed to create compute pipeline");
+
+        vkDestroyShaderModule(device, comp_shader_module, NULL);
     }
-    free(bundle->submit_semaphores);
-    free(bundle->image_views);
-    vkDestroySwapchainKHR(device, bundle->swapchain, NULL);
-    *bundle = (Vgk_SwapchainBundle){};
+    pipeline_bundle.pipeline = pipeline;
+
+    return pipeline_bundle;
 }
 
-void vgk_destroy_depth_image_bundle(Vgk_DepthImageBundle *bundle, VkDevice device)
+// ==================== PIPELINE TABLE =================================
+
+Vgk_PipelineTable vgk_create_pipeline_table(u32 capacity)
 {
-    for (u32 i = 0; i < bundle->image_count; i++)
+    Vgk_PipelineTable table = {};
+    table.slots = make_slot_map(capacity);
+    table.pipelines = (VkPipeline *)xcalloc(capacity * sizeof(table.pipelines[0]));
+    table.layouts = (VkPipelineLayout *)xcalloc(capacity * sizeof(table.layouts[0]));
+    table.pending = (bool *)xcalloc(capacity * sizeof(table.pending[0]));
+    table.fallbacks = (Vgk_PipelineHandle *)xcalloc(capacity * sizeof(table.fallbacks[0]));
+    table.specs = (Vgk_PipelineSpec *)xcalloc(capacity * sizeof(table.specs[0]));
+    return table;
+}
+
+Vgk_PipelineHandle vgk_pipeline_table_add(Vgk_PipelineTable *table, const Vgk_PipelineSpec *spec, VkDevice device)
+{
+    Vgk_PipelineBundle bundle = vgk_create_pipeline_from_spec(spec, device);
+
+    Vgk_PipelineHandle handle = slot_map_alloc(&table->slots);
+    u32 index = handle_index(handle);
+    table->pipelines[index] = bundle.pipeline;
+    table->layouts[index] = bundle.layout;
+    table->pending[index] = false;
+    table->fallbacks[index] = HANDLE_NULL;
+    table->specs[index] = *spec;
+    return handle;
+}
+
+// Destruction is deferred through the frame list, the handle is stale right away
+void vgk_pipeline_table_remove(Vgk_PipelineTable *table, Vgk_PipelineHandle handle, Vgk_FrameList *frame_list)
+{
+    u32 index = slot_map_get_index(&table->slots, handle);
+
+    Vgk_Deletion deletion = {};
+    deletion.type = VGK_DELETION_PIPELINE;
+    deletion.pipeline = table->pipelines[index];
+    vgk_defer_deletion(frame_list, &deletion);
+    deletion.type = VGK_DELETION_PIPELINE_LAYOUT;
+    deletion.pipeline_layout = table->layouts[index];
+    vgk_defer_deletion(frame_list, &deletion);
+
+    table->pipelines[index] = VK_NULL_HANDLE;
+    table->layouts[index] = VK_NULL_HANDLE;
+    table->pending[index] = false;
+    slot_map_free(&table->slots, handle);
+}
+
+// Index of the entry that stands in for handle: itself once ready, else its fallback (or -1)
+static i64 vgk_resolve_pipeline_index(const Vgk_PipelineTable *table, Vgk_PipelineHandle handle)
+{
+    u32 index = slot_map_get_index(&table->slots, handle);
+    if (!table->pending[index]) return index;
+
+    Vgk_PipelineHandle fallback = table->fallbacks[index];
+    if (fallback == HANDLE_NULL || !slot_map_is_valid(&table->slots, fallback)) return -1;
+    return handle_index(fallback);
+}
+
+// VK_NULL_HANDLE while the pipeline is still compiling and has no fallback; skip the draw then
+VkPipeline vgk_get_pipeline(const Vgk_PipelineTable *table, Vgk_PipelineHandle handle)
+{
+    i64 index = vgk_resolve_pipeline_index(table, handle);
+    return index >= 0 ? table->pipelines[index] : VK_NULL_HANDLE;
+}
+
+VkPipelineLayout vgk_get_pipeline_layout(const Vgk_PipelineTable *table, Vgk_PipelineHandle handle)
+{
+    i64 index = vgk_resolve_pipeline_index(table, handle);
+    return index >= 0 ? table->layouts[index] : VK_NULL_HANDLE;
+}
+
+bool vgk_is_pipeline_ready(const Vgk_PipelineTable *table, Vgk_PipelineHandle handle)
+{
+    return !table->pending[slot_map_get_index(&table->slots, handle)];
+}
+
+const Vgk_PipelineSpec *vgk_get_pipeline_spec(const Vgk_PipelineTable *table, Vgk_PipelineHandle handle)
+{
+    return &table->specs[slot_map_get_index(&table->slots, handle)];
+}
+
+// Cached per path, rehashed when the file's size or modification time changes so recompiled
+// shaders get new pipelines
+static u64 vgk_hash_shader_file(Vgk_PipelineRegistry *registry, const char *path)
+{
+    struct stat file_stat;
+    if (stat(path, &file_stat) != 0) fatal("Failed to stat shader %s", path);
+    i64 mtime_ns = (i64)file_stat.st_mtim.tv_sec * 1000000000 + file_stat.st_mtim.tv_nsec;
+
+    u64 path_hash = hash_fnv1a64(path, strlen(path), FNV1A64_SEED);
+    u32 mask = 2 * MAX_CACHED_SHADER_HASHES - 1;
+    u32 slot = (u32)path_hash & mask;
+    bool is_cached = false;
+    while (registry->shader_hashes[slot].path[0] != '\0')
     {
-        vkDestroyImage(device, bundle->images[i], NULL);
-        vkFreeMemory(device, bundle->memory_list[i], NULL);
-        vkDestroyImageView(device, bundle->image_views[i], NULL);
+        Vgk_ShaderHash *entry = &registry->shader_hashes[slot];
+        if (entry->path_hash == path_hash && strcmp(entry->path, path) == 0)
+        {
+            if (entry->size == (i64)file_stat.st_size && entry->mtime_ns == mtime_ns) return entry->hash;
+            is_cached = true;
+            break;
+        }
+        slot = (slot + 1) & mask;
     }
-    free(bundle->images);
-    free(bundle->memory_list);
-    free(bundle->image_views);
-    *bundle = (Vgk_DepthImageBundle){};
+
+    FILE *file = fopen(path, "rb");
+    if (!file) fatal("Failed to open shader %s", path);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    ArenaTemp scratch = arena_temp_begin(vgk_get_scratch_arena());
+    u8 *buffer = arena_alloc_array(scratch.arena, u8, (size_t)size);
+    fread(buffer, 1, size, file);
+    fclose(file);
+    u64 hash = hash_fnv1a64(buffer, (size_t)size, FNV1A64_SEED);
+    arena_temp_end(scratch);
+
+    Vgk_ShaderHash *entry = &registry->shader_hashes[slot];
+    if (!is_cached)
+    {
+        if (registry->shader_hash_count >= MAX_CACHED_SHADER_HASHES) fatal("Too many shaders in pipeline registry");
+        registry->shader_hash_count++;
+        snprintf(entry->path, sizeof(entry->path), "%s", path);
+        entry->path_hash = path_hash;
+    }
+    entry->size = (i64)file_stat.st_size;
+    entry->mtime_ns = mtime_ns;
+    entry->hash = hash;
+    return hash;
 }
 
-void vgk_destroy_render_pass_bundle(Vgk_RenderPassBundle *bundle, VkDevice device)
+Vgk_PipelineRegistry vgk_create_pipeline_registry(u32 capacity)
 {
-    for (u32 i = 0; i < bundle->framebuffer_count; i++)
+    Vgk_PipelineRegistry registry = {};
+    registry.table = vgk_create_pipeline_table(capacity);
+
+    // At most half full
+    registry.map_capacity = 1;
+    while (registry.map_capacity < capacity * 2) registry.map_capacity <<= 1;
+    registry.keys = (u64 *)xcalloc(registry.map_capacity * sizeof(registry.keys[0]));
+    registry.values = (Vgk_PipelineHandle *)xcalloc(registry.map_capacity * sizeof(registry.values[0]));
+
+    registry.shader_hashes = (Vgk_ShaderHash *)xcalloc(2 * MAX_CACHED_SHADER_HASHES * sizeof(registry.shader_hashes[0]));
+    return registry;
+}
+
+#define vgk_hash_field(HASH, FIELD) ((HASH) = hash_fnv1a64(&(FIELD), sizeof(FIELD), (HASH)))
+
+// Field by field, so padding and unused array tails never affect the result.
+// frame_count isn't pipeline state and is left out.
+u64 vgk_hash_pipeline_spec(Vgk_PipelineRegistry *registry, const Vgk_PipelineSpec *spec)
+{
+    u64 hash = FNV1A64_SEED;
+
+    u64 vert_hash = vgk_hash_shader_file(registry, spec->vert_shader_path);
+    u64 frag_hash = vgk_hash_shader_file(registry, spec->frag_shader_path);
+    vgk_hash_field(hash, vert_hash);
+    vgk_hash_field(hash, frag_hash);
+
+    const Vgk_PipelineLayoutSpec *layout = &spec->pipeline_layout_spec;
+    vgk_hash_field(hash, layout->descriptor_set_count);
+    for (u32 i = 0; i < layout->descriptor_set_count; i++)
     {
-        vkDestroyFramebuffer(device, bundle->framebuffers[i], NULL);
+        const Vgk_DescriptorSetSpec *set = &layout->descriptor_sets[i];
+        vgk_hash_field(hash, set->binding_count);
+        for (u32 j = 0; j < set->binding_count; j++)
+        {
+            vgk_hash_field(hash, set->bindings[j].descriptor_type);
+            vgk_hash_field(hash, set->bindings[j].descriptor_count);
+            vgk_hash_field(hash, set->bindings[j].stage_flags);
+        }
     }
-    free(bundle->framebuffers);
-    vkDestroyRenderPass(device, bundle->render_pass, NULL);
-    *bundle = (Vgk_RenderPassBundle){};
+    vgk_hash_field(hash, layout->push_constant_range_count);
+    for (u32 i = 0; i < layout->push_constant_range_count; i++)
+    {
+        vgk_hash_field(hash, layout->push_constant_ranges[i].stageFlags);
+        vgk_hash_field(hash, layout->push_constant_ranges[i].offset);
+        vgk_hash_field(hash, layout->push_constant_ranges[i].size);
+    }
+
+    vgk_hash_field(hash, spec->vert_input_spec.stride);
+    vgk_hash_field(hash, spec->vert_input_spec.attribute_count);
+    for (u32 i = 0; i < spec->vert_input_spec.attribute_count; i++)
+    {
+        vgk_hash_field(hash, spec->vert_input_spec.attributes[i].format);
+        vgk_hash_field(hash, spec->vert_input_spec.attributes[i].offset);
+    }
+
+    vgk_hash_field(hash, spec->viewport.x);
+    vgk_hash_field(hash, spec->viewport.y);
+    vgk_hash_field(hash, spec->viewport.width);
+    vgk_hash_field(hash, spec->viewport.height);
+    vgk_hash_field(hash, spec->viewport.minDepth);
+    vgk_hash_field(hash, spec->viewport.maxDepth);
+    vgk_hash_field(hash, spec->scissor.offset.x);
+    vgk_hash_field(hash, spec->scissor.offset.y);
+    vgk_hash_field(hash, spec->scissor.extent.width);
+    vgk_hash_field(hash, spec->scissor.extent.height);
+    vgk_hash_field(hash, spec->dynamic_viewport);
+    vgk_hash_field(hash, spec->dynamic_scissor);
+
+    vgk_hash_field(hash, spec->polygon_mode);
+    vgk_hash_field(hash, spec->line_width);
+    vgk_hash_field(hash, spec->cull_mode);
+    vgk_hash_field(hash, spec->front_face);
+    vgk_hash_field(hash, spec->rasterization_samples);
+    vgk_hash_field(hash, spec->enable_blending);
+    vgk_hash_field(hash, spec->enable_depth_testing);
+
+    vgk_hash_field(hash, spec->render_pass);
+    vgk_hash_field(hash, spec->color_format);
+    vgk_hash_field(hash, spec->depth_format);
+
+    // 0 marks an empty registry slot
+    return hash ? hash : 1;
 }
 
-void vgk_destroy_command_pool(VkCommandPool *command_pool, VkDevice device)
+// Same fields as vgk_hash_pipeline_spec
+static bool vgk_pipeline_specs_match(Vgk_PipelineRegistry *registry, const Vgk_PipelineSpec *a, const Vgk_PipelineSpec *b)
 {
-    vkDestroyCommandPool(device, *command_pool, NULL);
-    *command_pool = VK_NULL_HANDLE;
+    if (vgk_hash_shader_file(registry, a->vert_shader_path) != vgk_hash_shader_file(registry, b->vert_shader_path)) return false;
+    if (vgk_hash_shader_file(registry, a->frag_shader_path) != vgk_hash_shader_file(registry, b->frag_shader_path)) return false;
+
+    const Vgk_PipelineLayoutSpec *layout_a = &a->pipeline_layout_spec;
+    const Vgk_PipelineLayoutSpec *layout_b = &b->pipeline_layout_spec;
+    if (layout_a->descriptor_set_count != layout_b->descriptor_set_count) return false;
+    for (u32 i = 0; i < layout_a->descriptor_set_count; i++)
+    {
+        const Vgk_DescriptorSetSpec *set_a = &layout_a->descriptor_sets[i];
+        const Vgk_DescriptorSetSpec *set_b = &layout_b->descriptor_sets[i];
+        if (set_a->binding_count != set_b->binding_count) return false;
+        for (u32 j = 0; j < set_a->binding_count; j++)
+        {
+            if (set_a->bindings[j].descriptor_type != set_b->bindings[j].descriptor_type) return false;
+            if (set_a->bindings[j].descriptor_count != set_b->bindings[j].descriptor_count) return false;
+            if (set_a->bindings[j].stage_flags != set_b->bindings[j].stage_flags) return false;
+        }
+    }
+    if (layout_a->push_constant_range_count != layout_b->push_constant_range_count) return false;
+    for (u32 i = 0; i < layout_a->push_constant_range_count; i++)
+    {
+        if (layout_a->push_constant_ranges[i].stageFlags != layout_b->push_constant_ranges[i].stageFlags) return false;
+        if (layout_a->push_constant_ranges[i].offset != layout_b->push_constant_ranges[i].offset) return false;
+        if (layout_a->push_constant_ranges[i].size != layout_b->push_constant_ranges[i].size) return false;
+    }
+
+    if (a->vert_input_spec.stride != b->vert_input_spec.stride) return false;
+    if (a->vert_input_spec.attribute_count != b->vert_input_spec.attribute_count) return false;
+    for (u32 i = 0; i < a->vert_input_spec.attribute_count; i++)
+    {
+        if (a->vert_input_spec.attributes[i].format != b->vert_input_spec.attributes[i].format) return false;
+        if (a->vert_input_spec.attributes[i].offset != b->vert_input_spec.attributes[i].offset) return false;
+    }
+
+    // Neither struct has padding
+    if (memcmp(&a->viewport, &b->viewport, sizeof(a->viewport)) != 0) return false;
+    if (memcmp(&a->scissor, &b->scissor, sizeof(a->scissor)) != 0) return false;
+
+    return a->dynamic_viewport == b->dynamic_viewport &&
+           a->dynamic_scissor == b->dynamic_scissor &&
+           a->polygon_mode == b->polygon_mode &&
+           a->line_width == b->line_width &&
+           a->cull_mode == b->cull_mode &&
+           a->front_face == b->front_face &&
+           a->rasterization_samples == b->rasterization_samples &&
+           a->enable_blending == b->enable_blending &&
+           a->enable_depth_testing == b->enable_depth_testing &&
+           a->render_pass == b->render_pass &&
+           a->color_format == b->color_format &&
+           a->depth_format == b->depth_format;
 }
 
-void vgk_destroy_frame_list(Vgk_FrameList *list, VkDevice device)
+// Entries whose handle was removed from the table behind the registry's back are skipped
+static bool vgk_registry_slot_is_live(const Vgk_PipelineRegistry *registry, u32 slot, u64 spec_hash)
 {
-    for (u32 i = 0; i < list->count; i++)
+    return registry->keys[slot] == spec_hash && slot_map_is_valid(&registry->table.slots, registry->values[slot]);
+}
+
+// First live slot with the hash, or the empty slot ending its run
+static u32 vgk_registry_probe(const Vgk_PipelineRegistry *registry, u64 spec_hash)
+{
+    u32 mask = registry->map_capacity - 1;
+    u32 slot = (u32)spec_hash & mask;
+    while (registry->keys[slot] != 0 && !vgk_registry_slot_is_live(registry, slot, spec_hash))
     {
-        vkDestroySemaphore(device, list->frames[i].acquire_semaphore, NULL);
-        vkDestroyFence(device, list->frames[i].in_flight_fence, NULL);
+        slot = (slot + 1) & mask;
     }
+    return slot;
+}
 
-    free(list->frames);
-
-    *list = (Vgk_FrameList){};
+// Slot holding a pipeline for exactly this spec, or the empty slot to insert it at
+static u32 vgk_registry_probe_spec(Vgk_PipelineRegistry *registry, u64 spec_hash, const Vgk_PipelineSpec *spec)
+{
+    u32 mask = registry->map_capacity - 1;
+    u32 slot = (u32)spec_hash & mask;
+    while (registry->keys[slot] != 0)
+    {
+        if (vgk_registry_slot_is_live(registry, slot, spec_hash))
+        {
+            if (vgk_pipeline_specs_match(registry, spec, vgk_get_pipeline_spec(&registry->table, registry->values[slot]))) break;
+            warning("Pipeline spec hash collision: %016llx", (unsigned long long)spec_hash);
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
 }
 
-void vgk_destroy_buffer_bundle(Vgk_BufferBundle *bundle, VkDevice device)
+// Draw-time lookup: hash the spec once with vgk_hash_pipeline_spec, create it with vgk_registry_get_pipeline,
+// then resolve the cached hash here per draw, which skips rehashing and comparing the spec. If two specs
+// ever collide this returns the first one created; get_pipeline warns when that happens.
+// HANDLE_NULL if not created yet.
+Vgk_PipelineHandle vgk_registry_find_pipeline(const Vgk_PipelineRegistry *registry, u64 spec_hash)
 {
-    vkUnmapMemory(device, bundle->memory);
-    vkFreeMemory(device, bundle->memory, NULL);
-    vkDestroyBuffer(device, bundle->buffer, NULL);
-    *bundle = (Vgk_BufferBundle){};
+    u32 slot = vgk_registry_probe(registry, spec_hash);
+    return registry->keys[slot] ? registry->values[slot] : HANDLE_NULL;
 }
 
-void vgk_destroy_buffer_bundle_list(Vgk_BufferBundleList *list, VkDevice device)
+// Hashes and compares the whole spec; for setup and for specs that change, see vgk_registry_find_pipeline
+Vgk_PipelineHandle vgk_registry_get_pipeline(Vgk_PipelineRegistry *registry, const Vgk_PipelineSpec *spec, VkDevice device)
 {
-    for (u32 i = 0; i < list->count; i++)
+    u64 spec_hash = vgk_hash_pipeline_spec(registry, spec);
+    u32 slot = vgk_registry_probe_spec(registry, spec_hash, spec);
+    if (registry->keys[slot])
     {
-        vgk_destroy_buffer_bundle(&list->buffer_bundles[i], device);
+        registry->hit_count++;
+        return registry->values[slot];
     }
-    free(list->buffer_bundles);
-    *list = (Vgk_BufferBundleList){};
+
+    registry->miss_count++;
+    Vgk_PipelineHandle handle = vgk_pipeline_table_add(&registry->table, spec, device);
+    registry->keys[slot] = spec_hash;
+    registry->values[slot] = handle;
+    return handle;
 }
 
-void vgk_destroy_texture_bundle(Vgk_TextureBundle *bundle, VkDevice device)
+// Removes the pipeline from the registry and the table, destruction is deferred through the frame list.
+// Use this rather than vgk_pipeline_table_remove for pipelines the registry created.
+void vgk_registry_remove_pipeline(Vgk_PipelineRegistry *registry, Vgk_PipelineHandle handle, Vgk_FrameList *frame_list)
 {
-    vkDestroyImage(device, bundle->image, NULL);
-    vkFreeMemory(device, bundle->memory, NULL);
-    vkDestroyImageView(device, bundle->image_view, NULL);
-    vkDestroySampler(device, bundle->sampler, NULL);
+    u32 mask = registry->map_capacity - 1;
+    u32 hole = 0;
+    while (hole < registry->map_capacity && !(registry->keys[hole] != 0 && registry->values[hole] == handle)) hole++;
+    bassertf(hole < registry->map_capacity, "Pipeline isn't in the registry");
+
+    // Backward shift: pull later entries of the run into the hole unless that would move them before their home slot
+    u32 slot = (hole + 1) & mask;
+    while (registry->keys[slot] != 0)
+    {
+        u32 home = (u32)registry->keys[slot] & mask;
+        if (((slot - home) & mask) >= ((slot - hole) & mask))
+        {
+            registry->keys[hole] = registry->keys[slot];
+            registry->values[hole] = registry->values[slot];
+            hole = slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+    registry->keys[hole] = 0;
+    registry->values[hole] = HANDLE_NULL;
+
+    vgk_pipeline_table_remove(&registry->table, handle, frame_list);
 }
 
-// ============================ HELPERS ===============================
+// ==================== PIPELINE COMPILER =================================
 
-u32 vgk_get_queue_family_index(VkPhysicalDevice physical_device, VkSurfaceKHR surface)
+static void *vgk_pipeline_compiler_main(void *arg)
 {
-    u32 queue_family_index = UINT32_MAX;
+    Vgk_PipelineCompiler *compiler = (Vgk_PipelineCompiler *)arg;
+
+    pthread_mutex_lock(&compiler->mutex);
+    for (;;)
     {
-        u32 count;
-        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, NULL);
-        VkQueueFamilyProperties *queue_families = (VkQueueFamilyProperties *)xmalloc(count * sizeof(queue_families[0]));
-        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, queue_families);
-        for (u32 i = 0; i < count; i++)
+        while (compiler->queue_head == compiler->queue.size && !compiler->shutting_down)
         {
-            VkBool32 present_support;
-            vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &present_support);
-            if ((queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && present_support)
-            {
-                queue_family_index = i;
-            }
+            pthread_cond_wait(&compiler->work_cond, &compiler->mutex);
         }
-        free(queue_families);
-        assert(queue_family_index < UINT32_MAX);
+        if (compiler->shutting_down) break;
+
+        Vgk_PipelineCompileJob job = compiler->queue.data[compiler->queue_head++];
+        if (compiler->queue_head == compiler->queue.size)
+        {
+            list_clear(&compiler->queue);
+            compiler->queue_head = 0;
+        }
+        pthread_mutex_unlock(&compiler->mutex);
+
+        Vgk_PipelineCompileResult result = {};
+        result.handle = job.handle;
+        result.bundle = vgk_create_pipeline_from_spec(&job.spec, compiler->device);
+        result.on_ready = job.on_ready;
+        result.user_data = job.user_data;
+
+        pthread_mutex_lock(&compiler->mutex);
+        list_append(&compiler->completed, result);
     }
-    return queue_family_index;
+    pthread_mutex_unlock(&compiler->mutex);
+    return NULL;
 }
 
-u32 vgk_find_memory_type(VkPhysicalDevice physical_device, u32 type_filter, VkMemoryPropertyFlags props)
+Vgk_PipelineCompiler *vgk_create_pipeline_compiler(VkDevice device)
 {
-    VkPhysicalDeviceMemoryProperties mem_props;
-    vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_props);
-    for (u32 i = 0; i < mem_props.memoryTypeCount; i++)
+    Vgk_PipelineCompiler *compiler = (Vgk_PipelineCompiler *)xcalloc(sizeof(Vgk_PipelineCompiler));
+    compiler->device = device;
+    pthread_mutex_init(&compiler->mutex, NULL);
+    pthread_cond_init(&compiler->work_cond, NULL);
+    if (pthread_create(&compiler->thread, NULL, vgk_pipeline_compiler_main, compiler) != 0) fatal("Failed to create pipeline compiler thread");
+    return compiler;
+}
+
+// Returns right away with a pending handle. Until the compile lands through
+// vgk_pipeline_compiler_poll, lookups resolve to fallback, or VK_NULL_HANDLE if there is none.
+Vgk_PipelineHandle vgk_pipeline_table_add_async(Vgk_PipelineTable *table, Vgk_PipelineCompiler *compiler, const Vgk_PipelineSpec *spec, Vgk_PipelineHandle fallback, Vgk_PipelineReadyFn on_ready, void *user_data)
+{
+    bassertf(fallback == HANDLE_NULL || vgk_is_pipeline_ready(table, fallback), "Fallback pipeline must already be compiled");
+
+    Vgk_PipelineHandle handle = slot_map_alloc(&table->slots);
+    u32 index = handle_index(handle);
+    table->pipelines[index] = VK_NULL_HANDLE;
+    table->layouts[index] = VK_NULL_HANDLE;
+    table->pending[index] = true;
+    table->fallbacks[index] = fallback;
+    table->specs[index] = *spec;
+
+    Vgk_PipelineCompileJob job = {};
+    job.handle = handle;
+    job.spec = *spec;
+    job.on_ready = on_ready;
+    job.user_data = user_data;
+
+    pthread_mutex_lock(&compiler->mutex);
+    list_append(&compiler->queue, job);
+    compiler->in_flight_count++;
+    pthread_cond_signal(&compiler->work_cond);
+    pthread_mutex_unlock(&compiler->mutex);
+    return handle;
+}
+
+Vgk_PipelineHandle vgk_registry_get_pipeline_async(Vgk_PipelineRegistry *registry, Vgk_PipelineCompiler *compiler, const Vgk_PipelineSpec *spec, Vgk_PipelineHandle fallback)
+{
+    u64 spec_hash = vgk_hash_pipeline_spec(registry, spec);
+    u32 slot = vgk_registry_probe_spec(registry, spec_hash, spec);
+    if (registry->keys[slot])
     {
-        if ((type_filter & (1 << i)) &&
-            (mem_props.memoryTypes[i].propertyFlags & props) == props)
+        registry->hit_count++;
+        return registry->values[slot];
+    }
+
+    registry->miss_count++;
+    Vgk_PipelineHandle handle = vgk_pipeline_table_add_async(&registry->table, compiler, spec, fallback, NULL, NULL);
+    registry->keys[slot] = spec_hash;
+    registry->values[slot] = handle;
+    return handle;
+}
+
+// Call once per frame on the thread that owns the table. Installs finished pipelines and
+// runs their callbacks; results for handles removed while compiling are destroyed deferred.
+u32 vgk_pipeline_compiler_poll(Vgk_PipelineCompiler *compiler, Vgk_PipelineTable *table, Vgk_FrameList *frame_list)
+{
+    pthread_mutex_lock(&compiler->mutex);
+    Vgk_PipelineCompileResultList done = compiler->completed;
+    compiler->completed = compiler->installing;
+    compiler->installing = done;
+    compiler->in_flight_count -= (u32)done.size;
+    pthread_mutex_unlock(&compiler->mutex);
+
+    u32 installed_count = 0;
+    Vgk_PipelineCompileResult *result;
+    list_iterate(&compiler->installing, i, result)
+    {
+        if (!slot_map_is_valid(&table->slots, result->handle))
         {
-            return i;
+            vgk_defer_destroy_pipeline_bundle(frame_list, &result->bundle);
+            continue;
         }
+
+        u32 index = handle_index(result->handle);
+        table->pipelines[index] = result->bundle.pipeline;
+        table->layouts[index] = result->bundle.layout;
+        table->pending[index] = false;
+        table->fallbacks[index] = HANDLE_NULL;
+        installed_count++;
+
+        if (result->on_ready) result->on_ready(result->handle, result->user_data);
     }
-    fatal("Failed to find suitable memory type");
-    return 0;
+    list_clear(&compiler->installing);
+    return installed_count;
+}
+
+// ==================== STAGING =================================
+
+static VkDeviceSize vgk_align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static u32 vgk_get_format_texel_size(VkFormat format)
+{
+    switch (format)
+    {
+        case VK_FORMAT_R8_UNORM: return 1;
+        case VK_FORMAT_R8G8_UNORM: return 2;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB: return 4;
+        case VK_FORMAT_R16G16B16A16_SFLOAT: return 8;
+        case VK_FORMAT_R32G32B32A32_SFLOAT: return 16;
+        default: fatal("Unsupported texture format %d", format);
+    }
+}
+
+static void vgk_add_staging_chunk(Vgk_StagingPool *pool, VkDevice device, VkPhysicalDevice physical_device)
+{
+    Vgk_StagingChunk *chunk = &pool->chunks[pool->chunk_count++];
+    *chunk = (Vgk_StagingChunk){};
+    chunk->buffer = vgk_create_buffer_bundle(VGK_STAGING_CHUNK_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VGK_MEMORY_ACCESS_SEQUENTIAL_WRITE, device, physical_device);
+}
+
+Vgk_StagingPool vgk_create_staging_pool(u32 initial_chunk_count, VkDevice device, VkPhysicalDevice physical_device)
+{
+    bassert(initial_chunk_count > 0 && initial_chunk_count <= MAX_STAGING_CHUNKS);
+    Vgk_StagingPool pool = {};
+    for (u32 i = 0; i < initial_chunk_count; i++)
+    {
+        vgk_add_staging_chunk(&pool, device, physical_device);
+    }
+    return pool;
+}
+
+/*
+ * The memory must be consumed by the next submission on frame_list, or by the open frame's submission
+ * when allocated while recording one. The chunk is held until that submission completes, uploads
+ * submitted in between don't retire it. Never blocks unless every chunk is in flight and the pool
+ * is at MAX_STAGING_CHUNKS.
+ */
+Vgk_StagingAllocation vgk_staging_alloc(Vgk_StagingPool *pool, Vgk_FrameList *frame_list, VkDeviceSize size, VkDeviceSize alignment, VkDevice device, VkPhysicalDevice physical_device)
+{
+    u64 use_value = vgk_frame_list_get_use_value(frame_list);
+    Vgk_StagingAllocation allocation = {};
+
+    if (size > VGK_STAGING_CHUNK_SIZE)
+    {
+        Vgk_BufferBundle dedicated = vgk_create_buffer_bundle(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VGK_MEMORY_ACCESS_SEQUENTIAL_WRITE, device, physical_device);
+        allocation.buffer = dedicated.buffer;
+        allocation.data_ptr = dedicated.data_ptr;
+        vgk_defer_destroy_buffer_bundle(frame_list, &dedicated);
+        pool->dedicated_count++;
+        return allocation;
+    }
+
+    Vgk_StagingChunk *chunk = &pool->chunks[pool->current_chunk];
+    VkDeviceSize offset = vgk_align_up(chunk->offset, alignment);
+    if (offset + size > VGK_STAGING_CHUNK_SIZE)
+    {
+        u64 completed_value = vgk_frame_list_get_completed_value(frame_list, device);
+        u32 next = MAX_STAGING_CHUNKS;
+        u32 oldest = 0;
+        u64 oldest_retire_value = VGK_TIMELINE_PENDING;
+        for (u32 i = 0; i < pool->chunk_count; i++)
+        {
+            u64 retire_value = vgk_frame_list_resolve_use_value(frame_list, pool->chunks[i].retire_value);
+            if (retire_value <= completed_value && i != pool->current_chunk)
+            {
+                next = i;
+                break;
+            }
+            if (retire_value < oldest_retire_value)
+            {
+                oldest = i;
+                oldest_retire_value = retire_value;
+            }
+        }
+
+        if (next == MAX_STAGING_CHUNKS && pool->chunk_count < MAX_STAGING_CHUNKS)
+        {
+            next = pool->chunk_count;
+            vgk_add_staging_chunk(pool, device, physical_device);
+        }
+        else if (next == MAX_STAGING_CHUNKS)
+        {
+            next = oldest;
+            // Every chunk is held by the frame being recorded or by a submission not made yet
+            if (oldest_retire_value > frame_list->last_submitted_value) fatal("Staging pool exhausted by a single submission");
+            pool->stall_count++;
+            vgk_frame_list_wait_value(frame_list, oldest_retire_value, device);
+        }
+
+        pool->current_chunk = next;
+        chunk = &pool->chunks[next];
+        chunk->offset = 0;
+        offset = 0;
+    }
+
+    chunk->offset = offset + size;
+    chunk->retire_value = use_value;
+    allocation.buffer = chunk->buffer.buffer;
+    allocation.offset = offset;
+    allocation.data_ptr = (u8 *)chunk->buffer.data_ptr + offset;
+    return allocation;
+}
+
+// Pixels are tightly packed rows of width texels. Leaves the texture in SHADER_READ_ONLY_OPTIMAL.
+void vgk_cmd_upload_texture_region(VkCommandBuffer command_buffer, Vgk_TextureBundle *texture, Vgk_StagingPool *pool, Vgk_FrameList *frame_list, const void *pixels, u32 x, u32 y, u32 width, u32 height, VkDevice device, VkPhysicalDevice physical_device)
+{
+    bassert(x + width <= texture->extent.width && y + height <= texture->extent.height);
+
+    VkDeviceSize size = (VkDeviceSize)width * height * vgk_get_format_texel_size(texture->format);
+    // 16 covers the texel size of every supported format and the 4-byte copy offset rule
+    Vgk_StagingAllocation staging = vgk_staging_alloc(pool, frame_list, size, 16, device, physical_device);
+    memcpy(staging.data_ptr, pixels, (size_t)size);
+
+    bool was_sampled = texture->layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vgk_cmd_image_barrier(
+        command_buffer,
+        texture->image,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        texture->layout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        was_sampled ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        was_sampled ? VK_ACCESS_SHADER_READ_BIT : 0,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT
+    );
+
+    VkBufferImageCopy copy = {};
+    copy.bufferOffset = staging.offset;
+    copy.bufferRowLength = 0;
+    copy.bufferImageHeight = 0;
+    copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy.imageSubresource.mipLevel = 0;
+    copy.imageSubresource.baseArrayLayer = 0;
+    copy.imageSubresource.layerCount = 1;
+    copy.imageOffset = (VkOffset3D){ (i32)x, (i32)y, 0 };
+    copy.imageExtent = (VkExtent3D){ width, height, 1 };
+    vkCmdCopyBufferToImage(command_buffer, staging.buffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+    vgk_cmd_image_barrier(
+        command_buffer,
+        texture->image,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+    );
+    texture->layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+// Blocking convenience for load time; streaming code records vgk_cmd_upload_texture_region into the frame instead
+Vgk_TextureBundle vgk_load_texture_from_pixels(const void *pixels, u32 width, u32 height, VkFormat format, Vgk_StagingPool *pool, Vgk_FrameList *frame_list, VkDevice device, VkPhysicalDevice physical_device, VkCommandPool command_pool, VkQueue queue)
+{
+    Vgk_TextureBundle texture_bundle = vgk_create_texture_bundle(width, height, format, device, physical_device);
+
+    VkCommandBuffer command_buffer;
+    {
+        VkCommandBufferAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocate_info.commandPool = command_pool;
+        allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocate_info.commandBufferCount = 1;
+
+        VkResult result = vkAllocateCommandBuffers(device, &allocate_info, &command_buffer);
+        if (result != VK_SUCCESS) fatal("Failed to allocate command buffer for texture");
+    }
+
+    {
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VkResult result = vkBeginCommandBuffer(command_buffer, &begin_info);
+        if (result != VK_SUCCESS) fatal("Failed to begin texture command buffer");
+
+        vgk_cmd_upload_texture_region(command_buffer, &texture_bundle, pool, frame_list, pixels, 0, 0, width, height, device, physical_device);
+
+        result = vkEndCommandBuffer(command_buffer);
+        if (result != VK_SUCCESS) fatal("Failed to end texture command buffer");
+    }
+
+    u64 upload_value = vgk_frame_list_submit(frame_list, command_buffer, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, queue);
+    vgk_frame_list_wait_value(frame_list, upload_value, device);
+    vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
+
+    return texture_bundle;
+}
+
+// ==================== READBACK =================================
+
+Vgk_ReadbackRing vgk_create_readback_ring(u32 slot_count)
+{
+    bassert(slot_count > 0 && slot_count <= MAX_READBACK_SLOTS);
+    Vgk_ReadbackRing ring = {};
+    ring.slot_count = slot_count;
+    return ring;
+}
+
+/*
+ * Copies the whole image into the next ring slot. The copy must be in the next submission on
+ * frame_list, or in the open frame's submission when recorded while one is open. The image is moved from layout to TRANSFER_SRC_OPTIMAL
+ * and back; src_stage/src_access describe the last write to it. Returns false and records nothing
+ * when the next slot is still pending.
+ */
+bool vgk_cmd_readback_image(VkCommandBuffer command_buffer, Vgk_ReadbackRing *ring, Vgk_FrameList *frame_list, VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout, VkPipelineStageFlags src_stage, VkAccessFlags src_access, Vgk_ReadbackFn callback, void *user_data, VkDevice device, VkPhysicalDevice physical_device)
+{
+    Vgk_ReadbackSlot *slot = &ring->slots[ring->next_slot];
+    if (slot->is_pending)
+    {
+        ring->dropped_count++;
+        return false;
+    }
+
+    VkDeviceSize size = (VkDeviceSize)extent.width * extent.height * vgk_get_format_texel_size(format);
+    if (slot->buffer.size < size)
+    {
+        // A slot that isn't pending has no copy in flight, so the old buffer can go right away
+        if (slot->buffer.buffer != VK_NULL_HANDLE) vgk_destroy_buffer_bundle(&slot->buffer, device);
+        slot->buffer = vgk_create_buffer_bundle(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VGK_MEMORY_ACCESS_READBACK, device, physical_device);
+    }
+
+    vgk_cmd_image_barrier(
+        command_buffer,
+        image,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        src_stage, src_access,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT
+    );
+
+    VkBufferImageCopy copy = {};
+    copy.bufferOffset = 0;
+    copy.bufferRowLength = 0;
+    copy.bufferImageHeight = 0;
+    copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy.imageSubresource.mipLevel = 0;
+    copy.imageSubresource.baseArrayLayer = 0;
+    copy.imageSubresource.layerCount = 1;
+    copy.imageOffset = (VkOffset3D){ 0, 0, 0 };
+    copy.imageExtent = (VkExtent3D){ extent.width, extent.height, 1 };
+    vkCmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer.buffer, 1, &copy);
+
+    vgk_cmd_buffer_barrier(
+        command_buffer,
+        slot->buffer.buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT
+    );
+
+    // Whoever consumes the image next waits on its own semaphore or barrier, so no destination stage here
+    vgk_cmd_image_barrier(
+        command_buffer,
+        image,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0
+    );
+
+    slot->ready_value = vgk_frame_list_get_use_value(frame_list);
+    slot->extent = extent;
+    slot->format = format;
+    slot->callback = callback;
+    slot->user_data = user_data;
+    slot->is_pending = true;
+    ring->next_slot = (ring->next_slot + 1) % ring->slot_count;
+    return true;
+}
+
+// Record after the frame's rendering ends, while the image is in PRESENT_SRC_KHR
+bool vgk_cmd_readback_swapchain_image(VkCommandBuffer command_buffer, Vgk_ReadbackRing *ring, Vgk_FrameList *frame_list, const Vgk_SwapchainBundle *swapchain_bundle, u32 image_index, Vgk_ReadbackFn callback, void *user_data, VkDevice device, VkPhysicalDevice physical_device)
+{
+    if (!swapchain_bundle->supports_readback)
+    {
+        ring->dropped_count++;
+        return false;
+    }
+
+    return vgk_cmd_readback_image(
+        command_buffer,
+        ring,
+        frame_list,
+        swapchain_bundle->images[image_index],
+        swapchain_bundle->format.format,
+        swapchain_bundle->extent,
+        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        callback,
+        user_data,
+        device,
+        physical_device
+    );
+}
+
+// Runs the callbacks of every completed copy, oldest first. Never waits. Returns the number delivered.
+u32 vgk_readback_ring_poll(Vgk_ReadbackRing *ring, Vgk_FrameList *frame_list, VkDevice device)
+{
+    u64 completed_value = vgk_frame_list_get_completed_value(frame_list, device);
+    u32 delivered_count = 0;
+    for (u32 i = 0; i < ring->slot_count; i++)
+    {
+        Vgk_ReadbackSlot *slot = &ring->slots[(ring->next_slot + i) % ring->slot_count];
+        if (!slot->is_pending || vgk_frame_list_resolve_use_value(frame_list, slot->ready_value) > completed_value) continue;
+
+        VkDeviceSize size = (VkDeviceSize)slot->extent.width * slot->extent.height * vgk_get_format_texel_size(slot->format);
+        vgk_invalidate_buffer_bundle(&slot->buffer, 0, size, device);
+        slot->callback(slot->buffer.data_ptr, slot->extent.width, slot->extent.height, slot->format, slot->user_data);
+        slot->is_pending = false;
+        delivered_count++;
+    }
+    return delivered_count;
+}
+
+// ==================== TEXT =================================
+
+Vgk_UiBatch vgk_create_ui_batch(u32 max_quad_count, u32 frames_in_flight, VkDevice device, VkPhysicalDevice physical_device)
+{
+    Vgk_UiBatch batch = {};
+    batch.max_vertex_count = max_quad_count * 6;
+    batch.vertex_buffers = vgk_create_buffer_bundle_list(
+        batch.max_vertex_count * sizeof(Vgk_UiVertex),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VGK_MEMORY_ACCESS_SEQUENTIAL_WRITE,
+        frames_in_flight,
+        device,
+        physical_device);
+    return batch;
+}
+
+void vgk_ui_batch_begin(Vgk_UiBatch *batch, u32 frame_index)
+{
+    batch->frame_index = frame_index;
+    batch->vertex_count = 0;
+}
+
+void vgk_ui_batch_add_quad(Vgk_UiBatch *batch, f32 x0, f32 y0, f32 x1, f32 y1, f32 u0, f32 v0, f32 u1, f32 v1, v4 color, u32 tex_index)
+{
+    if (batch->vertex_count + 6 > batch->max_vertex_count)
+    {
+        bassertf(false, "UI batch is full: %u vertices", batch->max_vertex_count);
+        return;
+    }
+
+    Vgk_UiVertex *vertices = (Vgk_UiVertex *)batch->vertex_buffers.buffer_bundles[batch->frame_index].data_ptr + batch->vertex_count;
+    vertices[0] = (Vgk_UiVertex){ V3(x0, y0, 0), V2(u0, v0), color, tex_index };
+    vertices[1] = (Vgk_UiVertex){ V3(x1, y0, 0), V2(u1, v0), color, tex_index };
+    vertices[2] = (Vgk_UiVertex){ V3(x1, y1, 0), V2(u1, v1), color, tex_index };
+    vertices[3] = (Vgk_UiVertex){ V3(x0, y0, 0), V2(u0, v0), color, tex_index };
+    vertices[4] = (Vgk_UiVertex){ V3(x1, y1, 0), V2(u1, v1), color, tex_index };
+    vertices[5] = (Vgk_UiVertex){ V3(x0, y1, 0), V2(u0, v1), color, tex_index };
+    batch->vertex_count += 6;
+}
+
+// Expects the UI pipeline and its descriptor sets to be bound
+void vgk_cmd_draw_ui_batch(VkCommandBuffer command_buffer, const Vgk_UiBatch *batch)
+{
+    if (batch->vertex_count == 0) return;
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &batch->vertex_buffers.buffer_bundles[batch->frame_index].buffer, &offset);
+    vkCmdDraw(command_buffer, batch->vertex_count, 1, 0, 0);
+}
+
+Vgk_VertInputSpec vgk_make_ui_vert_input_spec()
+{
+    Vgk_VertInputSpec spec = vgk_make_vert_input_spec(sizeof(Vgk_UiVertex));
+    vgk_add_vert_attribute(&spec, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vgk_UiVertex, pos));
+    vgk_add_vert_attribute(&spec, VK_FORMAT_R32G32_SFLOAT, offsetof(Vgk_UiVertex, uv));
+    vgk_add_vert_attribute(&spec, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vgk_UiVertex, color));
+    vgk_add_vert_attribute(&spec, VK_FORMAT_R32_UINT, offsetof(Vgk_UiVertex, tex_index));
+    return spec;
+}
+
+static u32 vgk_glyph_map_home(const Vgk_GlyphCache *cache, u32 codepoint)
+{
+    return (codepoint * 0x9e3779b9u) & (cache->map_capacity - 1);
+}
+
+static u32 vgk_glyph_map_probe(const Vgk_GlyphCache *cache, u32 codepoint)
+{
+    u32 mask = cache->map_capacity - 1;
+    u32 slot = vgk_glyph_map_home(cache, codepoint);
+    while (cache->map_keys[slot] != VGK_GLYPH_NONE && cache->map_keys[slot] != codepoint)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Backward-shift removal, same as the memory tracker
+static void vgk_glyph_map_remove(Vgk_GlyphCache *cache, u32 codepoint)
+{
+    u32 mask = cache->map_capacity - 1;
+    u32 hole = vgk_glyph_map_probe(cache, codepoint);
+    if (cache->map_keys[hole] == VGK_GLYPH_NONE) return;
+
+    u32 next = hole;
+    for (;;)
+    {
+        next = (next + 1) & mask;
+        if (cache->map_keys[next] == VGK_GLYPH_NONE) break;
+        u32 home = vgk_glyph_map_home(cache, cache->map_keys[next]);
+        bool home_in_range = hole <= next ? (home > hole && home <= next) : (home > hole || home <= next);
+        if (home_in_range) continue;
+        cache->map_keys[hole] = cache->map_keys[next];
+        cache->map_cells[hole] = cache->map_cells[next];
+        hole = next;
+    }
+    cache->map_keys[hole] = VGK_GLYPH_NONE;
+}
+
+static void vgk_glyph_lru_unlink(Vgk_GlyphCache *cache, u32 cell)
+{
+    Vgk_Glyph *glyph = &cache->cells[cell];
+    if (glyph->lru_prev != VGK_GLYPH_NONE) cache->cells[glyph->lru_prev].lru_next = glyph->lru_next;
+    else cache->lru_head = glyph->lru_next;
+    if (glyph->lru_next != VGK_GLYPH_NONE) cache->cells[glyph->lru_next].lru_prev = glyph->lru_prev;
+    else cache->lru_tail = glyph->lru_prev;
+    glyph->lru_prev = VGK_GLYPH_NONE;
+    glyph->lru_next = VGK_GLYPH_NONE;
+}
+
+static void vgk_glyph_lru_push_head(Vgk_GlyphCache *cache, u32 cell)
+{
+    Vgk_Glyph *glyph = &cache->cells[cell];
+    glyph->lru_prev = VGK_GLYPH_NONE;
+    glyph->lru_next = cache->lru_head;
+    if (cache->lru_head != VGK_GLYPH_NONE) cache->cells[cache->lru_head].lru_prev = cell;
+    else cache->lru_tail = cell;
+    cache->lru_head = cell;
+}
+
+static void vgk_glyph_cache_mark_dirty(Vgk_GlyphCache *cache, u32 x0, u32 y0, u32 x1, u32 y1)
+{
+    if (cache->dirty_x0 >= cache->dirty_x1)
+    {
+        cache->dirty_x0 = x0;
+        cache->dirty_y0 = y0;
+        cache->dirty_x1 = x1;
+        cache->dirty_y1 = y1;
+        return;
+    }
+    if (x0 < cache->dirty_x0) cache->dirty_x0 = x0;
+    if (y0 < cache->dirty_y0) cache->dirty_y0 = y0;
+    if (x1 > cache->dirty_x1) cache->dirty_x1 = x1;
+    if (y1 > cache->dirty_y1) cache->dirty_y1 = y1;
+}
+
+// Next code point of a UTF-8 string, U+FFFD for malformed sequences
+static u32 vgk_decode_utf8(const char **cursor)
+{
+    const u8 *s = (const u8 *)*cursor;
+    u32 codepoint;
+    u32 extra;
+    if (s[0] < 0x80)               { codepoint = s[0]; extra = 0; }
+    else if ((s[0] & 0xe0) == 0xc0) { codepoint = s[0] & 0x1f; extra = 1; }
+    else if ((s[0] & 0xf0) == 0xe0) { codepoint = s[0] & 0x0f; extra = 2; }
+    else if ((s[0] & 0xf8) == 0xf0) { codepoint = s[0] & 0x07; extra = 3; }
+    else { *cursor += 1; return 0xfffd; }
+
+    for (u32 i = 1; i <= extra; i++)
+    {
+        if ((s[i] & 0xc0) != 0x80)
+        {
+            *cursor += i;
+            return 0xfffd;
+        }
+        codepoint = (codepoint << 6) | (s[i] & 0x3f);
+    }
+    *cursor += extra + 1;
+    return codepoint;
+}
+
+/*
+ * Cells are square, sized for the font's full ascent to descent plus padding, so any glyph of the font fits
+ * one cell. The atlas is R8, viewed as (1, 1, 1, R) so coverage lands in alpha, which is what ui.frag reads.
+ */
+Vgk_GlyphCache vgk_create_glyph_cache(const char *font_path, f32 pixel_height, u32 atlas_size, VkDevice device, VkPhysicalDevice physical_device)
+{
+    Vgk_GlyphCache cache = {};
+
+    {
+        FILE *file = fopen(font_path, "rb");
+        if (!file) fatal("Failed to open font %s", font_path);
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        rewind(file);
+        cache.font_data = (u8 *)xmalloc((size_t)size);
+        fread(cache.font_data, 1, size, file);
+        fclose(file);
+    }
+
+    cache.font_info = (stbtt_fontinfo *)xcalloc(sizeof(stbtt_fontinfo));
+    if (!stbtt_InitFont(cache.font_info, cache.font_data, stbtt_GetFontOffsetForIndex(cache.font_data, 0))) fatal("Failed to parse font %s", font_path);
+
+    int ascent, descent, line_gap;
+    stbtt_GetFontVMetrics(cache.font_info, &ascent, &descent, &line_gap);
+    cache.scale = stbtt_ScaleForPixelHeight(cache.font_info, pixel_height);
+    cache.ascent = ascent * cache.scale;
+    cache.descent = descent * cache.scale;
+    cache.line_gap = line_gap * cache.scale;
+
+    cache.atlas_size = atlas_size;
+    cache.cell_size = (u32)ceilf(cache.ascent - cache.descent) + 2 * VGK_GLYPH_PADDING;
+    cache.cells_per_row = atlas_size / cache.cell_size;
+    cache.cell_count = cache.cells_per_row * cache.cells_per_row;
+    bassert(cache.cell_count > 0);
+    cache.cells = (Vgk_Glyph *)xmalloc(cache.cell_count * sizeof(cache.cells[0]));
+    for (u32 i = 0; i < cache.cell_count; i++)
+    {
+        cache.cells[i] = (Vgk_Glyph){};
+        cache.cells[i].codepoint = VGK_GLYPH_NONE;
+        cache.cells[i].lru_prev = VGK_GLYPH_NONE;
+        cache.cells[i].lru_next = VGK_GLYPH_NONE;
+    }
+    cache.lru_head = VGK_GLYPH_NONE;
+    cache.lru_tail = VGK_GLYPH_NONE;
+
+    // At most half full
+    cache.map_capacity = 16;
+    while (cache.map_capacity < cache.cell_count * 2) cache.map_capacity *= 2;
+    cache.map_keys = (u32 *)xmalloc(cache.map_capacity * sizeof(cache.map_keys[0]));
+    cache.map_cells = (u32 *)xmalloc(cache.map_capacity * sizeof(cache.map_cells[0]));
+    memset(cache.map_keys, 0xff, cache.map_capacity * sizeof(cache.map_keys[0]));
+
+    VkComponentMapping coverage_to_alpha = { VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_R };
+    cache.atlas = vgk_create_texture_bundle_internal(atlas_size, atlas_size, VK_FORMAT_R8_UNORM, coverage_to_alpha, device, physical_device);
+    cache.atlas_pixels = (u8 *)xcalloc((size_t)atlas_size * atlas_size);
+    // First upload clears the whole atlas and takes it out of UNDEFINED
+    vgk_glyph_cache_mark_dirty(&cache, 0, 0, atlas_size, atlas_size);
+
+    cache.frame = 1;
+    return cache;
+}
+
+// Glyphs used from here on are protected from eviction until the next call
+void vgk_glyph_cache_begin_frame(Vgk_GlyphCache *cache)
+{
+    cache->frame++;
+}
+
+// NULL when the glyph isn't cached and every cell was used this frame
+const Vgk_Glyph *vgk_glyph_cache_get(Vgk_GlyphCache *cache, u32 codepoint)
+{
+    u32 slot = vgk_glyph_map_probe(cache, codepoint);
+    if (cache->map_keys[slot] == codepoint)
+    {
+        u32 cell = cache->map_cells[slot];
+        if (cache->lru_head != cell)
+        {
+            vgk_glyph_lru_unlink(cache, cell);
+            vgk_glyph_lru_push_head(cache, cell);
+        }
+        cache->cells[cell].last_used_frame = cache->frame;
+        return &cache->cells[cell];
+    }
+
+    u32 cell;
+    if (cache->used_cell_count < cache->cell_count)
+    {
+        cell = cache->used_cell_count++;
+    }
+    else
+    {
+        cell = cache->lru_tail;
+        if (cache->cells[cell].last_used_frame == cache->frame)
+        {
+            // Quads emitted this frame still point at every cell
+            cache->drop_count++;
+            return NULL;
+        }
+        vgk_glyph_map_remove(cache, cache->cells[cell].codepoint);
+        vgk_glyph_lru_unlink(cache, cell);
+        cache->evict_count++;
+    }
+
+    u32 cell_x = (cell % cache->cells_per_row) * cache->cell_size;
+    u32 cell_y = (cell / cache->cells_per_row) * cache->cell_size;
+    for (u32 row = 0; row < cache->cell_size; row++)
+    {
+        memset(&cache->atlas_pixels[(size_t)(cell_y + row) * cache->atlas_size + cell_x], 0, cache->cell_size);
+    }
+
+    int advance, left_side_bearing;
+    stbtt_GetCodepointHMetrics(cache->font_info, (int)codepoint, &advance, &left_side_bearing);
+    int x0, y0, x1, y1;
+    stbtt_GetCodepointBitmapBox(cache->font_info, (int)codepoint, cache->scale, cache->scale, &x0, &y0, &x1, &y1);
+
+    u32 max_extent = cache->cell_size - 2 * VGK_GLYPH_PADDING;
+    Vgk_Glyph *glyph = &cache->cells[cell];
+    glyph->codepoint = codepoint;
+    glyph->offset_x = x0;
+    glyph->offset_y = y0;
+    // Only a malformed font overflows the cell, clip rather than corrupt the neighbours
+    glyph->width = (u32)(x1 - x0) < max_extent ? (u32)(x1 - x0) : max_extent;
+    glyph->height = (u32)(y1 - y0) < max_extent ? (u32)(y1 - y0) : max_extent;
+    glyph->advance = advance * cache->scale;
+    glyph->last_used_frame = cache->frame;
+
+    if (glyph->width > 0 && glyph->height > 0)
+    {
+        u8 *dst = &cache->atlas_pixels[(size_t)(cell_y + VGK_GLYPH_PADDING) * cache->atlas_size + cell_x + VGK_GLYPH_PADDING];
+        ArenaTemp scratch = arena_temp_begin(vgk_get_scratch_arena());
+        cache->font_info->userdata = scratch.arena;
+        stbtt_MakeCodepointBitmap(cache->font_info, dst, (int)glyph->width, (int)glyph->height, (int)cache->atlas_size, cache->scale, cache->scale, (int)codepoint);
+        cache->font_info->userdata = NULL;
+        arena_temp_end(scratch);
+    }
+    vgk_glyph_cache_mark_dirty(cache, cell_x, cell_y, cell_x + cache->cell_size, cell_y + cache->cell_size);
+    cache->raster_count++;
+
+    vgk_glyph_lru_push_head(cache, cell);
+    // Eviction may have shifted the probe run
+    slot = vgk_glyph_map_probe(cache, codepoint);
+    cache->map_keys[slot] = codepoint;
+    cache->map_cells[slot] = cell;
+    return glyph;
+}
+
+// Record before the render pass of the frame that draws the text. Does nothing once the cache is warm.
+void vgk_cmd_upload_glyph_atlas(VkCommandBuffer command_buffer, Vgk_GlyphCache *cache, Vgk_StagingPool *pool, Vgk_FrameList *frame_list, VkDevice device, VkPhysicalDevice physical_device)
+{
+    if (cache->dirty_x0 >= cache->dirty_x1) return;
+
+    u32 width = cache->dirty_x1 - cache->dirty_x0;
+    u32 height = cache->dirty_y1 - cache->dirty_y0;
+    ArenaTemp scratch = arena_temp_begin(vgk_get_scratch_arena());
+    u8 *pixels = arena_alloc_array(scratch.arena, u8, (size_t)width * height);
+    for (u32 row = 0; row < height; row++)
+    {
+        memcpy(&pixels[(size_t)row * width], &cache->atlas_pixels[(size_t)(cache->dirty_y0 + row) * cache->atlas_size + cache->dirty_x0], width);
+    }
+    vgk_cmd_upload_texture_region(command_buffer, &cache->atlas, pool, frame_list, pixels, cache->dirty_x0, cache->dirty_y0, width, height, device, physical_device);
+    arena_temp_end(scratch);
+
+    cache->dirty_x0 = cache->dirty_x1 = 0;
+    cache->dirty_y0 = cache->dirty_y1 = 0;
+}
+
+// Lays out one line with kerning, pen starting at (x, baseline_y) in pixels. Returns the pen x after the run.
+f32 vgk_ui_batch_add_text(Vgk_UiBatch *batch, Vgk_GlyphCache *cache, const char *text, f32 x, f32 baseline_y, v4 color, u32 tex_index)
+{
+    f32 inv_atlas_size = 1.0f / cache->atlas_size;
+    u32 prev_codepoint = 0;
+    while (*text)
+    {
+        u32 codepoint = vgk_decode_utf8(&text);
+        if (prev_codepoint) x += stbtt_GetCodepointKernAdvance(cache->font_info, (int)prev_codepoint, (int)codepoint) * cache->scale;
+        prev_codepoint = codepoint;
+
+        const Vgk_Glyph *glyph = vgk_glyph_cache_get(cache, codepoint);
+        if (!glyph) continue;
+
+        if (glyph->width > 0 && glyph->height > 0)
+        {
+            u32 cell = (u32)(glyph - cache->cells);
+            f32 u0 = ((cell % cache->cells_per_row) * cache->cell_size + VGK_GLYPH_PADDING) * inv_atlas_size;
+            f32 v0 = ((cell / cache->cells_per_row) * cache->cell_size + VGK_GLYPH_PADDING) * inv_atlas_size;
+            f32 u1 = u0 + glyph->width * inv_atlas_size;
+            f32 v1 = v0 + glyph->height * inv_atlas_size;
+
+            // Snap to whole pixels, the bitmaps are rasterized at pixel scale
+            f32 x0 = floorf(x + 0.5f) + glyph->offset_x;
+            f32 y0 = floorf(baseline_y + 0.5f) + glyph->offset_y;
+            vgk_ui_batch_add_quad(batch, x0, y0, x0 + glyph->width, y0 + glyph->height, u0, v0, u1, v1, color, tex_index);
+        }
+        x += glyph->advance;
+    }
+    return x;
+}
+
+// Width of the line in pixels, from the font metrics without touching the cache
+f32 vgk_measure_text(Vgk_GlyphCache *cache, const char *text)
+{
+    f32 width = 0.0f;
+    u32 prev_codepoint = 0;
+    while (*text)
+    {
+        u32 codepoint = vgk_decode_utf8(&text);
+        if (prev_codepoint) width += stbtt_GetCodepointKernAdvance(cache->font_info, (int)prev_codepoint, (int)codepoint) * cache->scale;
+        prev_codepoint = codepoint;
+
+        int advance, left_side_bearing;
+        stbtt_GetCodepointHMetrics(cache->font_info, (int)codepoint, &advance, &left_side_bearing);
+        width += advance * cache->scale;
+    }
+    return width;
+}
+
+// ==================== TEXTURE ATLAS =================================
+
+Vgk_TextureAtlas vgk_create_texture_atlas(u32 page_size, u32 max_page_count, VkFormat format)
+{
+    bassert(max_page_count > 0 && max_page_count <= MAX_ATLAS_PAGES);
+    Vgk_TextureAtlas atlas = {};
+    atlas.page_size = page_size;
+    atlas.max_page_count = max_page_count;
+    atlas.format = format;
+    return atlas;
+}
+
+// Cleared to transparent, so texels that belong to no image sample as zero
+static void vgk_cmd_clear_atlas_page(VkCommandBuffer command_buffer, Vgk_TextureBundle *texture)
+{
+    // Earlier frames may still be sampling the page
+    vgk_cmd_image_barrier(
+        command_buffer,
+        texture->image,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        texture->layout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT
+    );
+
+    VkClearColorValue clear_color = {};
+    VkImageSubresourceRange range = {};
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.levelCount = 1;
+    range.layerCount = 1;
+    vkCmdClearColorImage(command_buffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clear_color, 1, &range);
+
+    vgk_cmd_image_barrier(
+        command_buffer,
+        texture->image,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+    );
+    texture->layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+static void vgk_cmd_add_atlas_page(VkCommandBuffer command_buffer, Vgk_TextureAtlas *atlas, VkDevice device, VkPhysicalDevice physical_device)
+{
+    u32 page = atlas->page_count++;
+    atlas->pages[page] = vgk_create_texture_bundle(atlas->page_size, atlas->page_size, atlas->format, device, physical_device);
+    atlas->packers[page] = make_skyline_packer(atlas->page_size, atlas->page_size);
+    vgk_cmd_clear_atlas_page(command_buffer, &atlas->pages[page]);
+}
+
+/*
+ * Packs the image into the first page with room, adding a page when none has, and records its upload.
+ * Record outside a render pass. Pixels are tightly packed rows in the atlas format. The image is uploaded
+ * with its edge pixels repeated VGK_ATLAS_PADDING times so linear filtering at the rect's border doesn't
+ * pick up the neighbours. Returns false when every page is full. out_new_page is set when the image
+ * started a new page, whose descriptor has to be written before the rect is drawn.
+ */
+bool vgk_cmd_texture_atlas_add(VkCommandBuffer command_buffer, Vgk_TextureAtlas *atlas, Vgk_StagingPool *pool, Vgk_FrameList *frame_list, const void *pixels, u32 width, u32 height, Vgk_AtlasRect *out_rect, bool *out_new_page, VkDevice device, VkPhysicalDevice physical_device)
+{
+    bassert(width > 0 && height > 0);
+    *out_new_page = false;
+    u32 padded_width = width + 2 * VGK_ATLAS_PADDING;
+    u32 padded_height = height + 2 * VGK_ATLAS_PADDING;
+    if (padded_width > atlas->page_size || padded_height > atlas->page_size) return false;
+
+    u32 page = 0;
+    u32 x = 0, y = 0;
+    for (; page < atlas->page_count; page++)
+    {
+        if (skyline_pack(&atlas->packers[page], padded_width, padded_height, &x, &y)) break;
+    }
+    if (page == atlas->page_count)
+    {
+        if (atlas->page_count >= atlas->max_page_count) return false;
+        vgk_cmd_add_atlas_page(command_buffer, atlas, device, physical_device);
+        *out_new_page = true;
+        bool packed = skyline_pack(&atlas->packers[page], padded_width, padded_height, &x, &y);
+        bassert(packed);
+    }
+
+    u32 texel_size = vgk_get_format_texel_size(atlas->format);
+    ArenaTemp scratch = arena_temp_begin(vgk_get_scratch_arena());
+    u8 *padded = arena_alloc_array(scratch.arena, u8, (size_t)padded_width * padded_height * texel_size);
+    for (u32 row = 0; row < padded_height; row++)
+    {
+        u32 src_row = row < VGK_ATLAS_PADDING ? 0 : (row - VGK_ATLAS_PADDING < height ? row - VGK_ATLAS_PADDING : height - 1);
+        const u8 *src = (const u8 *)pixels + (size_t)src_row * width * texel_size;
+        u8 *dst = padded + (size_t)row * padded_width * texel_size;
+        for (u32 i = 0; i < VGK_ATLAS_PADDING; i++)
+        {
+            memcpy(dst + i * texel_size, src, texel_size);
+            memcpy(dst + (VGK_ATLAS_PADDING + width + i) * texel_size, src + (width - 1) * texel_size, texel_size);
+        }
+        memcpy(dst + VGK_ATLAS_PADDING * texel_size, src, (size_t)width * texel_size);
+    }
+    vgk_cmd_upload_texture_region(command_buffer, &atlas->pages[page], pool, frame_list, padded, x, y, padded_width, padded_height, device, physical_device);
+    arena_temp_end(scratch);
+
+    f32 inv_size = 1.0f / atlas->page_size;
+    Vgk_AtlasRect rect = {};
+    rect.page = page;
+    rect.x = x + VGK_ATLAS_PADDING;
+    rect.y = y + VGK_ATLAS_PADDING;
+    rect.width = width;
+    rect.height = height;
+    rect.u0 = rect.x * inv_size;
+    rect.v0 = rect.y * inv_size;
+    rect.u1 = (rect.x + width) * inv_size;
+    rect.v1 = (rect.y + height) * inv_size;
+    *out_rect = rect;
+    return true;
+}
+
+// Forgets every image; their rects are invalid afterwards. Pages stay allocated and bound, so their
+// descriptors don't change. Record outside a render pass.
+void vgk_cmd_texture_atlas_reset(VkCommandBuffer command_buffer, Vgk_TextureAtlas *atlas)
+{
+    for (u32 i = 0; i < atlas->page_count; i++)
+    {
+        skyline_reset(&atlas->packers[i]);
+        vgk_cmd_clear_atlas_page(command_buffer, &atlas->pages[i]);
+    }
+}
+
+// first_tex_index is the descriptor array element page 0 is bound to. The image is tinted by color.
+void vgk_ui_batch_add_image(Vgk_UiBatch *batch, const Vgk_AtlasRect *rect, f32 x, f32 y, f32 width, f32 height, v4 color, u32 first_tex_index)
+{
+    u32 tex_index = (first_tex_index + rect->page) | VGK_UI_TINT_TEXTURE_BIT;
+    vgk_ui_batch_add_quad(batch, x, y, x + width, y + height, rect->u0, rect->v0, rect->u1, rect->v1, color, tex_index);
+}
+
+// ==================== DRAW LISTS =================================
+
+void vgk_indirect_draw_list_begin(Vgk_IndirectDrawList *list, u32 frame_index)
+{
+    bassert(frame_index < list->command_buffers.count);
+    list->frame_index = frame_index;
+    list->batch_count = 0;
+    list->command_count = 0;
+}
+
+void vgk_indirect_draw_list_set_pipeline(Vgk_IndirectDrawList *list, VkPipeline pipeline)
+{
+    if (list->batch_count > 0)
+    {
+        Vgk_IndirectBatch *current = &list->batches[list->batch_count - 1];
+        // GPU batches own their reserved range, CPU commands always go into a new batch
+        if (!current->gpu_count && current->pipeline == pipeline) return;
+        // An empty batch would only cost a bind, reuse it
+        if (!current->gpu_count && current->command_count == 0)
+        {
+            current->pipeline = pipeline;
+            return;
+        }
+    }
+
+    bassert(list->batch_count < MAX_INDIRECT_BATCHES);
+    Vgk_IndirectBatch batch = {};
+    batch.pipeline = pipeline;
+    batch.first_command = list->command_count;
+    list->batches[list->batch_count++] = batch;
+}
+
+void vgk_indirect_draw_list_add(Vgk_IndirectDrawList *list, u32 index_count, u32 instance_count, u32 first_index, i32 vertex_offset, u32 first_instance)
+{
+    bassert(list->batch_count > 0 && !list->batches[list->batch_count - 1].gpu_count);
+    bassertf(first_instance == 0 || list->allow_first_instance, "Device lacks drawIndirectFirstInstance");
+    if (list->command_count >= list->max_command_count)
+    {
+        bassertf(false, "Indirect draw list is full: %u commands", list->max_command_count);
+        return;
+    }
+
+    VkDrawIndexedIndirectCommand *commands = (VkDrawIndexedIndirectCommand *)list->upload_buffers.buffer_bundles[list->frame_index].data_ptr;
+    VkDrawIndexedIndirectCommand *command = &commands[list->command_count++];
+    command->indexCount = index_count;
+    command->instanceCount = instance_count;
+    command->firstIndex = first_index;
+    command->vertexOffset = vertex_offset;
+    command->firstInstance = first_instance;
+
+    list->batches[list->batch_count - 1].command_count++;
+}
+
+u32 vgk_indirect_draw_list_add_gpu_batch(Vgk_IndirectDrawList *list, VkPipeline pipeline, u32 max_command_count)
+{
+    bassert(list->batch_count < MAX_INDIRECT_BATCHES);
+    bassert(list->command_count + max_command_count <= list->max_command_count);
+
+    Vgk_IndirectBatch batch = {};
+    batch.pipeline = pipeline;
+    batch.first_command = list->command_count;
+    batch.command_count = max_command_count;
+    batch.gpu_count = true;
+
+    list->command_count += max_command_count;
+    list->batches[list->batch_count] = batch;
+    return list->batch_count++;
+}
+
+void vgk_indirect_draw_list_end(Vgk_IndirectDrawList *list)
+{
+    u8 *upload = (u8 *)list->upload_buffers.buffer_bundles[list->frame_index].data_ptr;
+    u32 *counts = (u32 *)(upload + list->max_command_count * sizeof(VkDrawIndexedIndirectCommand));
+    for (u32 i = 0; i < list->batch_count; i++)
+    {
+        if (list->batches[i].gpu_count) continue;
+        counts[i] = list->batches[i].command_count;
+    }
+}
+
+// Copies the CPU batches' commands and counts into the device-local buffers. Record after
+// vgk_indirect_draw_list_end, outside of a render pass and before the draws.
+void vgk_cmd_upload_indirect_list(VkCommandBuffer command_buffer, const Vgk_IndirectDrawList *list)
+{
+    VkBuffer upload_buffer = list->upload_buffers.buffer_bundles[list->frame_index].buffer;
+    VkBuffer indirect_buffer = list->command_buffers.buffer_bundles[list->frame_index].buffer;
+    VkBuffer count_buffer = list->count_buffers.buffer_bundles[list->frame_index].buffer;
+    u32 stride = sizeof(VkDrawIndexedIndirectCommand);
+    VkDeviceSize counts_offset = (VkDeviceSize)list->max_command_count * stride;
+
+    VkBufferCopy command_copies[MAX_INDIRECT_BATCHES];
+    VkBufferCopy count_copies[MAX_INDIRECT_BATCHES];
+    u32 copy_count = 0;
+    for (u32 i = 0; i < list->batch_count; i++)
+    {
+        const Vgk_IndirectBatch *batch = &list->batches[i];
+        if (batch->gpu_count || batch->command_count == 0) continue;
+
+        VkDeviceSize offset = (VkDeviceSize)batch->first_command * stride;
+        command_copies[copy_count] = (VkBufferCopy){ offset, offset, (VkDeviceSize)batch->command_count * stride };
+        count_copies[copy_count] = (VkBufferCopy){ counts_offset + i * sizeof(u32), i * sizeof(u32), sizeof(u32) };
+        copy_count++;
+    }
+    if (copy_count == 0) return;
+
+    vkCmdCopyBuffer(command_buffer, upload_buffer, indirect_buffer, copy_count, command_copies);
+    vgk_cmd_buffer_barrier(
+        command_buffer, indirect_buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    if (list->use_draw_count)
+    {
+        vkCmdCopyBuffer(command_buffer, upload_buffer, count_buffer, copy_count, count_copies);
+        vgk_cmd_buffer_barrier(
+            command_buffer, count_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    }
+}
+
+// CPU batches must have been copied in with vgk_cmd_upload_indirect_list
+void vgk_cmd_draw_indirect_list(VkCommandBuffer command_buffer, const Vgk_IndirectDrawList *list)
+{
+    VkBuffer indirect_buffer = list->command_buffers.buffer_bundles[list->frame_index].buffer;
+    VkBuffer count_buffer = list->count_buffers.buffer_bundles[list->frame_index].buffer;
+    u32 stride = sizeof(VkDrawIndexedIndirectCommand);
+
+    for (u32 i = 0; i < list->batch_count; i++)
+    {
+        const Vgk_IndirectBatch *batch = &list->batches[i];
+        if (batch->command_count == 0) continue;
+
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batch->pipeline);
+
+        // Without the count variant GPU batches draw their whole reserved range,
+        // the cull pass zero-fills it so unused commands have instanceCount = 0
+        VkDeviceSize offset = (VkDeviceSize)batch->first_command * stride;
+        if (list->use_draw_count || list->use_multi_draw)
+        {
+            // Split in case the batch exceeds maxDrawIndirectCount. Every chunk of a count draw reads the batch's
+            // count, so later chunks may draw past it; that only reaches the zero-filled tail of a GPU batch
+            for (u32 first = 0; first < batch->command_count; first += list->max_draw_indirect_count)
+            {
+                u32 count = batch->command_count - first;
+                if (count > list->max_draw_indirect_count) count = list->max_draw_indirect_count;
+                VkDeviceSize chunk_offset = offset + (VkDeviceSize)first * stride;
+                if (list->use_draw_count)
+                {
+                    vkCmdDrawIndexedIndirectCount(command_buffer, indirect_buffer, chunk_offset, count_buffer, i * sizeof(u32), count, stride);
+                }
+                else
+                {
+                    vkCmdDrawIndexedIndirect(command_buffer, indirect_buffer, chunk_offset, count, stride);
+                }
+            }
+        }
+        else
+        {
+            for (u32 j = 0; j < batch->command_count; j++)
+            {
+                vkCmdDrawIndexedIndirect(command_buffer, indirect_buffer, offset + (VkDeviceSize)j * stride, 1, stride);
+            }
+        }
+    }
+}
+
+// ==================== RENDER GRAPH =================================
+
+struct Vgk_RgAccessInfo
+{
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+    VkImageLayout layout;
+    VkImageUsageFlags usage;
+    bool is_write;
+};
+
+#define VGK_WRITE_ACCESS_MASK (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT)
+
+static Vgk_RgAccessInfo vgk_rg_get_access_info(Vgk_RgAccess access)
+{
+    Vgk_RgAccessInfo info = {};
+    switch (access)
+    {
+        case VGK_RG_ACCESS_COLOR_WRITE:
+        {
+            info.stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            info.access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            info.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+            info.is_write = true;
+        } break;
+
+        case VGK_RG_ACCESS_DEPTH_WRITE:
+        {
+            info.stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            info.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            info.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            info.is_write = true;
+        } break;
+
+        case VGK_RG_ACCESS_FRAGMENT_SAMPLED_READ:
+        {
+            info.stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            info.access = VK_ACCESS_SHADER_READ_BIT;
+            info.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            info.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+        } break;
+
+        case VGK_RG_ACCESS_COMPUTE_SAMPLED_READ:
+        {
+            info.stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            info.access = VK_ACCESS_SHADER_READ_BIT;
+            info.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            info.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+        } break;
+
+        case VGK_RG_ACCESS_COMPUTE_STORAGE_READ:
+        {
+            info.stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            info.access = VK_ACCESS_SHADER_READ_BIT;
+            info.layout = VK_IMAGE_LAYOUT_GENERAL;
+            info.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+        } break;
+
+        case VGK_RG_ACCESS_COMPUTE_STORAGE_WRITE:
+        {
+            info.stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            info.access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            info.layout = VK_IMAGE_LAYOUT_GENERAL;
+            info.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+            info.is_write = true;
+        } break;
+
+        case VGK_RG_ACCESS_TRANSFER_READ:
+        {
+            info.stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            info.access = VK_ACCESS_TRANSFER_READ_BIT;
+            info.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        } break;
+
+        case VGK_RG_ACCESS_TRANSFER_WRITE:
+        {
+            info.stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            info.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+            info.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            info.is_write = true;
+        } break;
+
+        case VGK_RG_ACCESS_INDIRECT_READ:
+        {
+            info.stage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+            info.access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        } break;
+
+        case VGK_RG_ACCESS_VERTEX_READ:
+        {
+            info.stage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+            info.access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        } break;
+
+        default: fatal("Render graph access not implemented");
+    }
+    return info;
+}
+
+static VkImageAspectFlags vgk_get_format_aspect(VkFormat format)
+{
+    switch (format)
+    {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+Vgk_RenderGraph vgk_make_render_graph()
+{
+    Vgk_RenderGraph graph = {};
+    return graph;
+}
+
+static u32 vgk_rg_add_resource(Vgk_RenderGraph *graph, const Vgk_RgResource *resource)
+{
+    if (graph->resource_count >= MAX_RG_RESOURCES) fatal("Too many render graph resources");
+    graph->resources[graph->resource_count] = *resource;
+    return graph->resource_count++;
+}
+
+u32 vgk_rg_import_image(Vgk_RenderGraph *graph, const char *name, const VkImage *images, const VkImageView *image_views, u32 variant_count, VkFormat format, VkExtent2D extent, VkImageLayout initial_layout, VkImageLayout final_layout)
+{
+    bassert(variant_count > 0 && variant_count <= MAX_RG_IMAGE_VARIANTS);
+
+    Vgk_RgResource resource = {};
+    resource.name = name;
+    resource.is_image = true;
+    resource.is_imported = true;
+    resource.is_output = (final_layout != VK_IMAGE_LAYOUT_UNDEFINED);
+    resource.format = format;
+    resource.extent = extent;
+    resource.aspect = vgk_get_format_aspect(format);
+    resource.initial_layout = initial_layout;
+    resource.final_layout = final_layout;
+    resource.variant_count = variant_count;
+    for (u32 i = 0; i < variant_count; i++)
+    {
+        resource.images[i] = images[i];
+        resource.image_views[i] = image_views[i];
+    }
+    return vgk_rg_add_resource(graph, &resource);
+}
+
+u32 vgk_rg_import_swapchain(Vgk_RenderGraph *graph, const Vgk_SwapchainBundle *swapchain_bundle)
+{
+    // Previous contents are never needed, the image is handed to present at the end
+    return vgk_rg_import_image(
+        graph, "swapchain",
+        swapchain_bundle->images, swapchain_bundle->image_views, swapchain_bundle->image_count,
+        swapchain_bundle->format.format, swapchain_bundle->extent,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+}
+
+u32 vgk_rg_import_buffer(Vgk_RenderGraph *graph, const char *name, VkBuffer buffer, bool is_output)
+{
+    Vgk_RgResource resource = {};
+    resource.name = name;
+    resource.is_imported = true;
+    resource.is_output = is_output;
+    resource.buffer = buffer;
+    resource.variant_count = 1;
+    return vgk_rg_add_resource(graph, &resource);
+}
+
+u32 vgk_rg_create_image(Vgk_RenderGraph *graph, const char *name, VkFormat format, VkExtent2D extent)
+{
+    Vgk_RgResource resource = {};
+    resource.name = name;
+    resource.is_image = true;
+    resource.format = format;
+    resource.extent = extent;
+    resource.aspect = vgk_get_format_aspect(format);
+    resource.variant_count = 1;
+    return vgk_rg_add_resource(graph, &resource);
+}
+
+u32 vgk_rg_add_pass(Vgk_RenderGraph *graph, const char *name, Vgk_RgExecuteFn fn, void *user_data)
+{
+    if (graph->pass_count >= MAX_RG_PASSES) fatal("Too many render graph passes");
+    Vgk_RgPass *pass = &graph->passes[graph->pass_count];
+    *pass = (Vgk_RgPass){};
+    pass->name = name;
+    pass->fn = fn;
+    pass->user_data = user_data;
+    return graph->pass_count++;
+}
+
+static void vgk_rg_add_access(Vgk_RenderGraph *graph, u32 pass_index, const Vgk_RgPassAccess *access)
+{
+    bassert(pass_index < graph->pass_count && access->resource < graph->resource_count);
+    Vgk_RgPass *pass = &graph->passes[pass_index];
+    if (pass->access_count >= MAX_RG_PASS_ACCESSES) fatal("Too many accesses in render graph pass %s", pass->name);
+    pass->accesses[pass->access_count++] = *access;
+}
+
+void vgk_rg_write_color(Vgk_RenderGraph *graph, u32 pass, u32 image, bool clear, VkClearColorValue clear_color)
+{
+    Vgk_RgPassAccess access = {};
+    access.resource = image;
+    access.access = VGK_RG_ACCESS_COLOR_WRITE;
+    access.clear = clear;
+    access.clear_value.color = clear_color;
+    vgk_rg_add_access(graph, pass, &access);
+}
+
+void vgk_rg_write_depth(Vgk_RenderGraph *graph, u32 pass, u32 image, bool clear, f32 clear_depth)
+{
+    Vgk_RgPassAccess access = {};
+    access.resource = image;
+    access.access = VGK_RG_ACCESS_DEPTH_WRITE;
+    access.clear = clear;
+    access.clear_value.depthStencil.depth = clear_depth;
+    vgk_rg_add_access(graph, pass, &access);
+}
+
+void vgk_rg_use(Vgk_RenderGraph *graph, u32 pass, u32 resource, Vgk_RgAccess access_type)
+{
+    bassert(access_type != VGK_RG_ACCESS_COLOR_WRITE && access_type != VGK_RG_ACCESS_DEPTH_WRITE);
+    Vgk_RgPassAccess access = {};
+    access.resource = resource;
+    access.access = access_type;
+    vgk_rg_add_access(graph, pass, &access);
+}
+
+// Walks passes backwards from the outputs, a pass survives only if something later needs what it writes
+static void vgk_rg_cull_passes(Vgk_RenderGraph *graph)
+{
+    bool needed[MAX_RG_RESOURCES] = {};
+    for (u32 i = 0; i < graph->resource_count; i++)
+    {
+        needed[i] = graph->resources[i].is_output;
+    }
+
+    for (u32 p = graph->pass_count; p-- > 0;)
+    {
+        Vgk_RgPass *pass = &graph->passes[p];
+        pass->is_alive = false;
+        for (u32 a = 0; a < pass->access_count; a++)
+        {
+            const Vgk_RgPassAccess *access = &pass->accesses[a];
+            if (vgk_rg_get_access_info(access->access).is_write && needed[access->resource]) pass->is_alive = true;
+        }
+        if (!pass->is_alive) continue;
+
+        for (u32 a = 0; a < pass->access_count; a++)
+        {
+            const Vgk_RgPassAccess *access = &pass->accesses[a];
+            // A cleared write doesn't depend on earlier contents, anything else does
+            bool overwrites = vgk_rg_get_access_info(access->access).is_write && access->clear;
+            needed[access->resource] = !overwrites;
+        }
+    }
+}
+
+static bool vgk_rg_lifetimes_overlap(const Vgk_RgResource *a, const Vgk_RgResource *b)
+{
+    return a->first_pass <= b->last_pass && b->first_pass <= a->last_pass;
+}
+
+// Transient images whose lifetimes don't overlap share one VkDeviceMemory block
+static void vgk_rg_allocate_transients(Vgk_RenderGraph *graph, VkDevice device, VkPhysicalDevice physical_device)
+{
+    u32 order[MAX_RG_RESOURCES];
+    u32 order_count = 0;
+    for (u32 i = 0; i < graph->resource_count; i++)
+    {
+        Vgk_RgResource *resource = &graph->resources[i];
+        if (resource->is_imported || !resource->is_used) continue;
+
+        VkImageCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        create_info.imageType = VK_IMAGE_TYPE_2D;
+        create_info.format = resource->format;
+        create_info.extent = (VkExtent3D){ resource->extent.width, resource->extent.height, 1 };
+        create_info.mipLevels = 1;
+        create_info.arrayLayers = 1;
+        create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        create_info.usage = resource->usage;
+        create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkResult result = vkCreateImage(device, &create_info, NULL, &resource->images[0]);
+        if (result != VK_SUCCESS) fatal("Failed to create render graph image %s", resource->name);
+        vkGetImageMemoryRequirements(device, resource->images[0], &resource->memory_requirements);
+        graph->transient_memory_size_unaliased += resource->memory_requirements.size;
+
+        // Insertion sort, largest first
+        u32 j = order_count++;
+        while (j > 0 && graph->resources[order[j - 1]].memory_requirements.size < resource->memory_requirements.size)
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    VkDeviceSize block_sizes[MAX_RG_RESOURCES] = {};
+    u32 block_type_bits[MAX_RG_RESOURCES] = {};
+    for (u32 o = 0; o < order_count; o++)
+    {
+        Vgk_RgResource *resource = &graph->resources[order[o]];
+        u32 block = graph->memory_block_count;
+        for (u32 b = 0; b < graph->memory_block_count && block == graph->memory_block_count; b++)
+        {
+            if ((block_type_bits[b] & resource->memory_requirements.memoryTypeBits) == 0) continue;
+            bool fits = true;
+            for (u32 k = 0; k < o; k++)
+            {
+                const Vgk_RgResource *other = &graph->resources[order[k]];
+                if (other->memory_block == b && vgk_rg_lifetimes_overlap(resource, other)) fits = false;
+            }
+            if (fits) block = b;
+        }
+
+        if (block == graph->memory_block_count)
+        {
+            graph->memory_block_count++;
+            block_type_bits[block] = resource->memory_requirements.memoryTypeBits;
+        }
+        block_type_bits[block] &= resource->memory_requirements.memoryTypeBits;
+        resource->memory_block = block;
+
+        // Sorted by size, so the first occupant sizes the block; alignment still has to hold at offset 0
+        if (resource->memory_requirements.size > block_sizes[block]) block_sizes[block] = resource->memory_requirements.size;
+    }
+
+    for (u32 b = 0; b < graph->memory_block_count; b++)
+    {
+        VkMemoryAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocate_info.allocationSize = block_sizes[b];
+        allocate_info.memoryTypeIndex = vgk_find_memory_type(physical_device, block_type_bits[b], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        VkResult result = vgk_allocate_memory(&allocate_info, VGK_MEMORY_RENDER_GRAPH, device, &graph->memory_blocks[b]);
+        if (result != VK_SUCCESS) fatal("Failed to allocate render graph memory block");
+        graph->transient_memory_size += block_sizes[b];
+    }
+
+    for (u32 o = 0; o < order_count; o++)
+    {
+        Vgk_RgResource *resource = &graph->resources[order[o]];
+        VkResult result = vkBindImageMemory(device, resource->images[0], graph->memory_blocks[resource->memory_block], 0);
+        if (result != VK_SUCCESS) fatal("Failed to bind render graph image %s", resource->name);
+
+        VkImageViewCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        create_info.image = resource->images[0];
+        create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        create_info.format = resource->format;
+        create_info.subresourceRange.aspectMask = resource->aspect;
+        create_info.subresourceRange.baseMipLevel = 0;
+        create_info.subresourceRange.levelCount = 1;
+        create_info.subresourceRange.baseArrayLayer = 0;
+        create_info.subresourceRange.layerCount = 1;
+
+        result = vkCreateImageView(device, &create_info, NULL, &resource->image_views[0]);
+        if (result != VK_SUCCESS) fatal("Failed to create render graph image view %s", resource->name);
+    }
+}
+
+struct Vgk_RgState
+{
+    VkImageLayout layout;
+    VkPipelineStageFlags writer_stage;
+    VkAccessFlags write_access;
+    VkPipelineStageFlags reader_stages;
+    VkPipelineStageFlags visible_stages;
+    VkAccessFlags visible_access;
+};
+
+static void vgk_rg_create_render_pass(Vgk_RenderGraph *graph, Vgk_RgPass *pass, const bool *has_contents, const u32 *last_use, VkDevice device)
+{
+    VkAttachmentDescription attachments[MAX_RG_PASS_ACCESSES] = {};
+    VkAttachmentReference color_references[MAX_RG_PASS_ACCESSES] = {};
+    VkAttachmentReference depth_reference = {};
+    u32 resource_indices[MAX_RG_PASS_ACCESSES];
+    u32 attachment_count = 0;
+    u32 color_count = 0;
+    bool with_depth = false;
+    u32 pass_index = (u32)(pass - graph->passes);
+
+    pass->framebuffer_count = 1;
+    pass->clear_value_count = 0;
+    for (u32 a = 0; a < pass->access_count; a++)
+    {
+        const Vgk_RgPassAccess *access = &pass->accesses[a];
+        if (access->access != VGK_RG_ACCESS_COLOR_WRITE && access->access != VGK_RG_ACCESS_DEPTH_WRITE) continue;
+
+        const Vgk_RgResource *resource = &graph->resources[access->resource];
+        Vgk_RgAccessInfo info = vgk_rg_get_access_info(access->access);
+        bool is_read_later = (last_use[access->resource] > pass_index) || resource->is_output;
+
+        VkAttachmentDescription *description = &attachments[attachment_count];
+        description->format = resource->format;
+        description->samples = VK_SAMPLE_COUNT_1_BIT;
+        description->loadOp = access->clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : (has_contents[access->resource] ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+        description->storeOp = is_read_later ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        description->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        description->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        // Layout transitions are done by the graph's barriers
+        description->initialLayout = info.layout;
+        description->finalLayout = info.layout;
+
+        if (access->access == VGK_RG_ACCESS_COLOR_WRITE)
+        {
+            color_references[color_count].attachment = attachment_count;
+            color_references[color_count].layout = info.layout;
+            color_count++;
+        }
+        else
+        {
+            depth_reference.attachment = attachment_count;
+            depth_reference.layout = info.layout;
+            with_depth = true;
+        }
+
+        pass->clear_values[attachment_count] = access->clear_value;
+        pass->extent = resource->extent;
+        if (resource->variant_count > pass->framebuffer_count) pass->framebuffer_count = resource->variant_count;
+        resource_indices[attachment_count] = access->resource;
+        attachment_count++;
+    }
+    pass->clear_value_count = attachment_count;
+
+    VkSubpassDescription subpass_description = {};
+    subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass_description.colorAttachmentCount = color_count;
+    subpass_description.pColorAttachments = color_references;
+    if (with_depth)
+    {
+        subpass_description.pDepthStencilAttachment = &depth_reference;
+    }
+
+    VkRenderPassCreateInfo render_pass_create_info = {};
+    render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_create_info.attachmentCount = attachment_count;
+    render_pass_create_info.pAttachments = attachments;
+    render_pass_create_info.subpassCount = 1;
+    render_pass_create_info.pSubpasses = &subpass_description;
+
+    VkResult result = vkCreateRenderPass(device, &render_pass_create_info, NULL, &pass->render_pass);
+    if (result != VK_SUCCESS) fatal("Failed to create render pass for %s", pass->name);
+
+    for (u32 v = 0; v < pass->framebuffer_count; v++)
+    {
+        VkImageView views[MAX_RG_PASS_ACCESSES];
+        for (u32 i = 0; i < attachment_count; i++)
+        {
+            const Vgk_RgResource *resource = &graph->resources[resource_indices[i]];
+            bassertf(resource->variant_count == 1 || resource->variant_count == pass->framebuffer_count, "Mismatched variant count for %s", resource->name);
+            views[i] = resource->image_views[v % resource->variant_count];
+        }
+
+        VkFramebufferCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        create_info.renderPass = pass->render_pass;
+        create_info.attachmentCount = attachment_count;
+        create_info.pAttachments = views;
+        create_info.width = pass->extent.width;
+        create_info.height = pass->extent.height;
+        create_info.layers = 1;
+
+        result = vkCreateFramebuffer(device, &create_info, NULL, &pass->framebuffers[v]);
+        if (result != VK_SUCCESS) fatal("Failed to create framebuffer for %s", pass->name);
+    }
+}
+
+void vgk_rg_compile(Vgk_RenderGraph *graph, VkDevice device, VkPhysicalDevice physical_device)
+{
+    bassert(!graph->is_compiled);
+
+    vgk_rg_cull_passes(graph);
+
+    // Lifetimes and usage over the surviving passes
+    u32 last_use[MAX_RG_RESOURCES] = {};
+    graph->alive_pass_count = 0;
+    for (u32 p = 0; p < graph->pass_count; p++)
+    {
+        Vgk_RgPass *pass = &graph->passes[p];
+        if (!pass->is_alive) continue;
+        graph->alive_pass_count++;
+
+        pass->is_raster = false;
+        for (u32 a = 0; a < pass->access_count; a++)
+        {
+            const Vgk_RgPassAccess *access = &pass->accesses[a];
+            Vgk_RgResource *resource = &graph->resources[access->resource];
+            if (!resource->is_used) resource->first_pass = p;
+            resource->is_used = true;
+            resource->last_pass = p;
+            resource->usage |= vgk_rg_get_access_info(access->access).usage;
+            last_use[access->resource] = p;
+            if (access->access == VGK_RG_ACCESS_COLOR_WRITE || access->access == VGK_RG_ACCESS_DEPTH_WRITE) pass->is_raster = true;
+        }
+    }
+
+    vgk_rg_allocate_transients(graph, device, physical_device);
+
+    // Before its first use a transient has to wait for everything that touches its memory block,
+    // including the previous frame's use of the same block
+    VkPipelineStageFlags block_stages[MAX_RG_RESOURCES] = {};
+    VkAccessFlags block_write_access[MAX_RG_RESOURCES] = {};
+    for (u32 p = 0; p < graph->pass_count; p++)
+    {
+        const Vgk_RgPass *pass = &graph->passes[p];
+        if (!pass->is_alive) continue;
+        for (u32 a = 0; a < pass->access_count; a++)
+        {
+            const Vgk_RgResource *resource = &graph->resources[pass->accesses[a].resource];
+            if (resource->is_imported) continue;
+            Vgk_RgAccessInfo info = vgk_rg_get_access_info(pass->accesses[a].access);
+            block_stages[resource->memory_block] |= info.stage;
+            block_write_access[resource->memory_block] |= info.access & VGK_WRITE_ACCESS_MASK;
+        }
+    }
+
+    Vgk_RgState states[MAX_RG_RESOURCES] = {};
+    bool has_contents[MAX_RG_RESOURCES] = {};
+    for (u32 i = 0; i < graph->resource_count; i++)
+    {
+        const Vgk_RgResource *resource = &graph->resources[i];
+        Vgk_RgState *state = &states[i];
+        if (resource->is_imported)
+        {
+            state->layout = resource->initial_layout;
+            state->writer_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            state->write_access = VK_ACCESS_MEMORY_WRITE_BIT;
+            has_contents[i] = !resource->is_image || resource->initial_layout != VK_IMAGE_LAYOUT_UNDEFINED;
+        }
+        else
+        {
+            state->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            state->writer_stage = block_stages[resource->memory_block];
+            state->write_access = block_write_access[resource->memory_block];
+        }
+    }
+
+    graph->barrier_batch_count = 0;
+    for (u32 p = 0; p < graph->pass_count; p++)
+    {
+        Vgk_RgPass *pass = &graph->passes[p];
+        if (!pass->is_alive) continue;
+
+        pass->barrier_count = 0;
+        pass->src_stage = 0;
+        pass->dst_stage = 0;
+        for (u32 a = 0; a < pass->access_count; a++)
+        {
+            const Vgk_RgPassAccess *access = &pass->accesses[a];
+            const Vgk_RgResource *resource = &graph->resources[access->resource];
+            Vgk_RgAccessInfo info = vgk_rg_get_access_info(access->access);
+            Vgk_RgState *state = &states[access->resource];
+            VkImageLayout new_layout = resource->is_image ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+
+            // Reads of already visible data in the right layout need no barrier
+            bool is_visible = ((info.stage & ~state->visible_stages) == 0) && ((info.access & ~state->visible_access) == 0);
+            if (!info.is_write && state->layout == new_layout && is_visible)
+            {
+                state->reader_stages |= info.stage;
+                continue;
+            }
+
+            Vgk_RgBarrier *barrier = &pass->barriers[pass->barrier_count++];
+            barrier->resource = access->resource;
+            barrier->old_layout = state->layout;
+            barrier->new_layout = new_layout;
+            barrier->src_access = state->write_access;
+            barrier->dst_access = info.access;
+            pass->src_stage |= state->writer_stage | state->reader_stages;
+            pass->dst_stage |= info.stage;
+
+            state->layout = new_layout;
+            if (info.is_write)
+            {
+                state->writer_stage = info.stage;
+                state->write_access = info.access & VGK_WRITE_ACCESS_MASK;
+                state->reader_stages = 0;
+                state->visible_stages = 0;
+                state->visible_access = 0;
+            }
+            else
+            {
+                state->reader_stages |= info.stage;
+                state->visible_stages |= info.stage;
+                state->visible_access |= info.access;
+            }
+        }
+        if (pass->barrier_count > 0) graph->barrier_batch_count++;
+
+        if (pass->is_raster)
+        {
+            vgk_rg_create_render_pass(graph, pass, has_contents, last_use, device);
+        }
+
+        for (u32 a = 0; a < pass->access_count; a++)
+        {
+            if (vgk_rg_get_access_info(pass->accesses[a].access).is_write) has_contents[pass->accesses[a].resource] = true;
+        }
+    }
+
+    // Hand imported images back in the layout the caller expects
+    graph->final_barrier_count = 0;
+    graph->final_src_stage = 0;
+    graph->final_dst_stage = 0;
+    for (u32 i = 0; i < graph->resource_count; i++)
+    {
+        const Vgk_RgResource *resource = &graph->resources[i];
+        const Vgk_RgState *state = &states[i];
+        if (!resource->is_imported || !resource->is_image || !resource->is_used) continue;
+        if (resource->final_layout == VK_IMAGE_LAYOUT_UNDEFINED || resource->final_layout == state->layout) continue;
+
+        Vgk_RgBarrier *barrier = &graph->final_barriers[graph->final_barrier_count++];
+        barrier->resource = i;
+        barrier->old_layout = state->layout;
+        barrier->new_layout = resource->final_layout;
+        barrier->src_access = state->write_access;
+        barrier->dst_access = 0;
+        graph->final_src_stage |= state->writer_stage | state->reader_stages;
+        graph->final_dst_stage |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    }
+    if (graph->final_barrier_count > 0) graph->barrier_batch_count++;
+
+    graph->is_compiled = true;
+}
+
+VkRenderPass vgk_rg_get_render_pass(const Vgk_RenderGraph *graph, u32 pass)
+{
+    bassert(graph->is_compiled && pass < graph->pass_count);
+    return graph->passes[pass].render_pass;
+}
+
+static void vgk_rg_cmd_barriers(VkCommandBuffer command_buffer, const Vgk_RenderGraph *graph, const Vgk_RgBarrier *barriers, u32 barrier_count, VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage, u32 variant_index)
+{
+    VkImageMemoryBarrier image_barriers[MAX_RG_RESOURCES];
+    VkBufferMemoryBarrier buffer_barriers[MAX_RG_RESOURCES];
+    u32 image_barrier_count = 0;
+    u32 buffer_barrier_count = 0;
+
+    for (u32 i = 0; i < barrier_count; i++)
+    {
+        const Vgk_RgBarrier *barrier = &barriers[i];
+        const Vgk_RgResource *resource = &graph->resources[barrier->resource];
+        if (resource->is_image)
+        {
+            VkImageMemoryBarrier *image_barrier = &image_barriers[image_barrier_count++];
+            *image_barrier = (VkImageMemoryBarrier){};
+            image_barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            image_barrier->oldLayout = barrier->old_layout;
+            image_barrier->newLayout = barrier->new_layout;
+            image_barrier->srcAccessMask = barrier->src_access;
+            image_barrier->dstAccessMask = barrier->dst_access;
+            image_barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            image_barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            image_barrier->image = resource->images[variant_index % resource->variant_count];
+            image_barrier->subresourceRange.aspectMask = resource->aspect;
+            image_barrier->subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+            image_barrier->subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        }
+        else
+        {
+            VkBufferMemoryBarrier *buffer_barrier = &buffer_barriers[buffer_barrier_count++];
+            *buffer_barrier = (VkBufferMemoryBarrier){};
+            buffer_barrier->sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            buffer_barrier->srcAccessMask = barrier->src_access;
+            buffer_barrier->dstAccessMask = barrier->dst_access;
+            buffer_barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            buffer_barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            buffer_barrier->buffer = resource->buffer;
+            buffer_barrier->offset = 0;
+            buffer_barrier->size = VK_WHOLE_SIZE;
+        }
+    }
+
+    vkCmdPipelineBarrier(
+        command_buffer,
+        src_stage ? src_stage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dst_stage,
+        0,
+        0, NULL,
+        buffer_barrier_count, buffer_barriers,
+        image_barrier_count, image_barriers
+    );
+}
+
+// variant_index selects the image of multi-image imports, e.g. the acquired swapchain image
+void vgk_cmd_execute_render_graph(VkCommandBuffer command_buffer, const Vgk_RenderGraph *graph, u32 variant_index)
+{
+    bassert(graph->is_compiled);
+
+    for (u32 p = 0; p < graph->pass_count; p++)
+    {
+        const Vgk_RgPass *pass = &graph->passes[p];
+        if (!pass->is_alive) continue;
+
+        if (pass->barrier_count > 0)
+        {
+            vgk_rg_cmd_barriers(command_buffer, graph, pass->barriers, pass->barrier_count, pass->src_stage, pass->dst_stage, variant_index);
+        }
+
+        if (pass->is_raster)
+        {
+            VkRenderPassBeginInfo begin_info = {};
+            begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            begin_info.renderPass = pass->render_pass;
+            begin_info.framebuffer = pass->framebuffers[variant_index % pass->framebuffer_count];
+            begin_info.renderArea.extent = pass->extent;
+            begin_info.clearValueCount = pass->clear_value_count;
+            begin_info.pClearValues = pass->clear_values;
+            vkCmdBeginRenderPass(command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        }
+
+        if (pass->fn) pass->fn(command_buffer, pass->user_data);
+
+        if (pass->is_raster)
+        {
+            vkCmdEndRenderPass(command_buffer);
+        }
+    }
+
+    if (graph->final_barrier_count > 0)
+    {
+        vgk_rg_cmd_barriers(command_buffer, graph, graph->final_barriers, graph->final_barrier_count, graph->final_src_stage, graph->final_dst_stage, variant_index);
+    }
+}
+
+// ==================== RECORDING =================================
+
+// Same load/store and layout behaviour as the render pass from vgk_create_render_pass_bundle,
+// the transitions the render pass did implicitly are recorded as barriers here.
+void vgk_cmd_begin_rendering(VkCommandBuffer command_buffer, const Vgk_RenderingSpec *spec, const Vgk_RenderingTarget *target, VkClearColorValue clear_color, bool with_secondary_command_buffers)
+{
+    bassertf(vgk_device_caps.dynamic_rendering, "Device doesn't support dynamic rendering, use a render pass bundle");
+    bool with_depth = (spec->depth_format != VK_FORMAT_UNDEFINED);
+    bool with_msaa = (spec->samples > VK_SAMPLE_COUNT_1_BIT);
+
+    vgk_cmd_image_barrier(
+        command_buffer, target->color_image, VK_IMAGE_ASPECT_COLOR_BIT,
+        spec->with_clear ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, spec->with_clear ? 0 : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+    if (with_msaa)
+    {
+        bassert(target->resolve_image != VK_NULL_HANDLE);
+        vgk_cmd_image_barrier(
+            command_buffer, target->resolve_image, VK_IMAGE_ASPECT_COLOR_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+    }
+
+    if (with_depth)
+    {
+        VkPipelineStageFlags depth_stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        vgk_cmd_image_barrier(
+            command_buffer, target->depth_image, VK_IMAGE_ASPECT_DEPTH_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            depth_stages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            depth_stages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+    }
+
+    VkRenderingAttachmentInfo color_attachment = {};
+    color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    color_attachment.imageView = target->color_image_view;
+    color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachment.loadOp = spec->with_clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment.clearValue.color = clear_color;
+    if (with_msaa)
+    {
+        color_attachment.storeOp = spec->is_final ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+        color_attachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+        color_attachment.resolveImageView = target->resolve_image_view;
+        color_attachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+
+    VkRenderingAttachmentInfo depth_attachment = {};
+    depth_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    depth_attachment.imageView = target->depth_image_view;
+    depth_attachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.clearValue.depthStencil.depth = 1.0f;
+
+    VkRenderingInfo rendering_info = {};
+    rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    rendering_info.flags = with_secondary_command_buffers ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+    rendering_info.renderArea.extent = target->extent;
+    rendering_info.layerCount = 1;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachments = &color_attachment;
+    rendering_info.pDepthAttachment = with_depth ? &depth_attachment : NULL;
+
+    vkCmdBeginRendering(command_buffer, &rendering_info);
+}
+
+void vgk_cmd_end_rendering(VkCommandBuffer command_buffer, const Vgk_RenderingSpec *spec, const Vgk_RenderingTarget *target)
+{
+    vkCmdEndRendering(command_buffer);
+
+    if (spec->is_final)
+    {
+        VkImage presented_image = (spec->samples > VK_SAMPLE_COUNT_1_BIT) ? target->resolve_image : target->color_image;
+        vgk_cmd_image_barrier(
+            command_buffer, presented_image, VK_IMAGE_ASPECT_COLOR_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+    }
+}
+
+// Call once the frame's previous submission has completed
+void vgk_parallel_recorder_begin_frame(Vgk_ParallelRecorder *recorder, u32 frame_index, VkDevice device)
+{
+    bassert(frame_index < recorder->frame_count);
+    for (u32 i = 0; i < recorder->thread_count; i++)
+    {
+        Vgk_RecordSlot *slot = &recorder->slots[frame_index * recorder->thread_count + i];
+        VkResult result = vkResetCommandPool(device, slot->command_pool, 0);
+        if (result != VK_SUCCESS) fatal("Failed to reset per-thread command pool");
+        slot->used_count = 0;
+    }
+}
+
+struct Vgk_RecordJob
+{
+    Vgk_ParallelRecorder *recorder;
+    u32 frame_index;
+    const Vgk_InheritanceSpec *inheritance;
+    u32 item_count;
+    u32 chunk_size;
+    Vgk_RecordChunkFn fn;
+    void *user_data;
+    VkCommandBuffer *recorded; // [job_index]
+};
+
+static void vgk_record_chunk_job(void *user_data, u32 job_index, u32 thread_index)
+{
+    Vgk_RecordJob *job = (Vgk_RecordJob *)user_data;
+    u32 first = job_index * job->chunk_size;
+    u32 count = job->item_count - first;
+    if (count > job->chunk_size) count = job->chunk_size;
+
+    // Each job owns one slot, so the slot's pool is never touched by two threads at once
+    Vgk_RecordSlot *slot = &job->recorder->slots[job->frame_index * job->recorder->thread_count + job_index];
+    VkCommandBuffer command_buffer = slot->command_buffers[slot->used_count++];
+
+    VkCommandBufferInheritanceInfo inheritance_info = {};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.renderPass = job->inheritance->render_pass;
+    inheritance_info.subpass = job->inheritance->subpass;
+    inheritance_info.framebuffer = job->inheritance->framebuffer;
+
+    VkCommandBufferInheritanceRenderingInfo inheritance_rendering_info = {};
+    if (job->inheritance->render_pass == VK_NULL_HANDLE)
+    {
+        inheritance_rendering_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+        inheritance_rendering_info.colorAttachmentCount = 1;
+        inheritance_rendering_info.pColorAttachmentFormats = &job->inheritance->color_format;
+        inheritance_rendering_info.depthAttachmentFormat = job->inheritance->depth_format;
+        inheritance_rendering_info.rasterizationSamples = job->inheritance->samples ? job->inheritance->samples : VK_SAMPLE_COUNT_1_BIT;
+        inheritance_info.pNext = &inheritance_rendering_info;
+    }
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    begin_info.pInheritanceInfo = &inheritance_info;
+
+    VkResult result = vkBeginCommandBuffer(command_buffer, &begin_info);
+    if (result != VK_SUCCESS) fatal("Failed to begin secondary command buffer");
+
+    job->fn(command_buffer, first, count, job->user_data);
+
+    result = vkEndCommandBuffer(command_buffer);
+    if (result != VK_SUCCESS) fatal("Failed to end secondary command buffer");
+
+    job->recorded[job_index] = command_buffer;
+}
+
+// Records item_count items split into one chunk per thread and executes the chunks in order.
+// The primary must be inside a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS,
+// or inside vgk_cmd_begin_rendering with with_secondary_command_buffers set.
+void vgk_cmd_record_parallel(VkCommandBuffer primary_command_buffer, Vgk_ParallelRecorder *recorder, u32 frame_index, const Vgk_InheritanceSpec *inheritance, u32 item_count, Vgk_RecordChunkFn fn, void *user_data, VkDevice device)
+{
+    bassert(frame_index < recorder->frame_count);
+    if (item_count == 0) return;
+
+    u32 chunk_size = (item_count + recorder->thread_count - 1) / recorder->thread_count;
+    u32 job_count = (item_count + chunk_size - 1) / chunk_size;
+
+    // Secondary buffers are allocated up front on this thread, so workers only record
+    for (u32 i = 0; i < job_count; i++)
+    {
+        Vgk_RecordSlot *slot = &recorder->slots[frame_index * recorder->thread_count + i];
+        if (slot->used_count < slot->allocated_count) continue;
+        if (slot->allocated_count >= MAX_SECONDARY_COMMAND_BUFFERS_PER_SLOT) fatal("Out of secondary command buffers in slot %u", i);
+
+        VkCommandBufferAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocate_info.commandPool = slot->command_pool;
+        allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocate_info.commandBufferCount = 1;
+
+        VkResult result = vkAllocateCommandBuffers(device, &allocate_info, &slot->command_buffers[slot->allocated_count]);
+        if (result != VK_SUCCESS) fatal("Failed to allocate secondary command buffer");
+        slot->allocated_count++;
+    }
+
+    VkCommandBuffer recorded[MAX_RECORDING_THREADS];
+    bassert(job_count <= MAX_RECORDING_THREADS);
+
+    Vgk_RecordJob job = {};
+    job.recorder = recorder;
+    job.frame_index = frame_index;
+    job.inheritance = inheritance;
+    job.item_count = item_count;
+    job.chunk_size = chunk_size;
+    job.fn = fn;
+    job.user_data = user_data;
+    job.recorded = recorded;
+
+    thread_pool_run(recorder->thread_pool, job_count, vgk_record_chunk_job, &job);
+
+    vkCmdExecuteCommands(primary_command_buffer, job_count, recorded);
+}
+
+// ==================== DAMAGE =================================
+
+static u64 vgk_rect_area(VkRect2D rect)
+{
+    return (u64)rect.extent.width * rect.extent.height;
+}
+
+static VkRect2D vgk_rect_union(VkRect2D a, VkRect2D b)
+{
+    i32 x0 = a.offset.x < b.offset.x ? a.offset.x : b.offset.x;
+    i32 y0 = a.offset.y < b.offset.y ? a.offset.y : b.offset.y;
+    i32 ax1 = a.offset.x + (i32)a.extent.width, bx1 = b.offset.x + (i32)b.extent.width;
+    i32 ay1 = a.offset.y + (i32)a.extent.height, by1 = b.offset.y + (i32)b.extent.height;
+    i32 x1 = ax1 > bx1 ? ax1 : bx1;
+    i32 y1 = ay1 > by1 ? ay1 : by1;
+    return (VkRect2D){ { x0, y0 }, { (u32)(x1 - x0), (u32)(y1 - y0) } };
+}
+
+// Overlapping or sharing an edge
+static bool vgk_rects_touch(VkRect2D a, VkRect2D b)
+{
+    return a.offset.x <= b.offset.x + (i32)b.extent.width && b.offset.x <= a.offset.x + (i32)a.extent.width &&
+           a.offset.y <= b.offset.y + (i32)b.extent.height && b.offset.y <= a.offset.y + (i32)a.extent.height;
+}
+
+static void vgk_damage_region_set_full(Vgk_DamageRegion *region)
+{
+    region->is_full = true;
+    region->rect_count = 0;
+}
+
+// Keeps the rects disjoint by merging touching ones; past MAX_DAMAGE_RECTS the cheapest pair is merged
+static void vgk_damage_region_add(Vgk_DamageRegion *region, VkRect2D rect, VkExtent2D extent)
+{
+    if (region->is_full) return;
+
+    for (u32 i = 0; i < region->rect_count;)
+    {
+        if (vgk_rects_touch(region->rects[i], rect))
+        {
+            rect = vgk_rect_union(region->rects[i], rect);
+            region->rects[i] = region->rects[--region->rect_count];
+            i = 0;
+            continue;
+        }
+        i++;
+    }
+
+    if (region->rect_count == MAX_DAMAGE_RECTS)
+    {
+        u32 best = 0;
+        u64 best_growth = UINT64_MAX;
+        for (u32 i = 0; i < region->rect_count; i++)
+        {
+            u64 growth = vgk_rect_area(vgk_rect_union(region->rects[i], rect)) - vgk_rect_area(region->rects[i]);
+            if (growth < best_growth)
+            {
+                best_growth = growth;
+                best = i;
+            }
+        }
+        VkRect2D merged = vgk_rect_union(region->rects[best], rect);
+        region->rects[best] = region->rects[--region->rect_count];
+        // The union can reach other rects
+        vgk_damage_region_add(region, merged, extent);
+        return;
+    }
+    region->rects[region->rect_count++] = rect;
+
+    u64 damaged_area = 0;
+    for (u32 i = 0; i < region->rect_count; i++) damaged_area += vgk_rect_area(region->rects[i]);
+    if (damaged_area > (u64)(VGK_DAMAGE_FULL_RATIO * extent.width * extent.height)) vgk_damage_region_set_full(region);
+}
+
+Vgk_DamageTracker vgk_create_damage_tracker(const Vgk_SwapchainBundle *swapchain_bundle)
+{
+    bassert(swapchain_bundle->image_count <= MAX_DAMAGE_IMAGES);
+    Vgk_DamageTracker tracker = {};
+    tracker.image_count = swapchain_bundle->image_count;
+    tracker.extent = swapchain_bundle->extent;
+    vgk_damage_add_full(&tracker);
+    return tracker;
+}
+
+void vgk_damage_add_rect(Vgk_DamageTracker *tracker, VkRect2D rect)
+{
+    // Clip to the screen
+    i32 x0 = rect.offset.x > 0 ? rect.offset.x : 0;
+    i32 y0 = rect.offset.y > 0 ? rect.offset.y : 0;
+    i32 x1 = rect.offset.x + (i32)rect.extent.width;
+    i32 y1 = rect.offset.y + (i32)rect.extent.height;
+    if (x1 > (i32)tracker->extent.width) x1 = (i32)tracker->extent.width;
+    if (y1 > (i32)tracker->extent.height) y1 = (i32)tracker->extent.height;
+    if (x1 <= x0 || y1 <= y0) return;
+    rect = (VkRect2D){ { x0, y0 }, { (u32)(x1 - x0), (u32)(y1 - y0) } };
+
+    for (u32 i = 0; i < tracker->image_count; i++)
+    {
+        vgk_damage_region_add(&tracker->images[i], rect, tracker->extent);
+    }
+    tracker->has_pending = true;
+}
+
+void vgk_damage_add_full(Vgk_DamageTracker *tracker)
+{
+    for (u32 i = 0; i < tracker->image_count; i++)
+    {
+        vgk_damage_region_set_full(&tracker->images[i]);
+    }
+    tracker->has_pending = true;
+}
+
+bool vgk_damage_has_pending(const Vgk_DamageTracker *tracker)
+{
+    return tracker->has_pending;
+}
+
+// Call once the image is acquired; the region is what has to be redrawn in it. A full region gets the whole extent as its one rect.
+Vgk_DamageRegion vgk_damage_take(Vgk_DamageTracker *tracker, u32 image_index)
+{
+    bassert(image_index < tracker->image_count);
+    Vgk_DamageRegion region = tracker->images[image_index];
+    if (region.is_full)
+    {
+        region.rects[0] = (VkRect2D){ { 0, 0 }, tracker->extent };
+        region.rect_count = 1;
+    }
+    tracker->images[image_index] = (Vgk_DamageRegion){};
+    tracker->has_pending = false;
+    return region;
+}
+
+VkRect2D vgk_damage_get_bounds(const Vgk_DamageRegion *region)
+{
+    if (region->rect_count == 0) return (VkRect2D){};
+    VkRect2D bounds = region->rects[0];
+    for (u32 i = 1; i < region->rect_count; i++) bounds = vgk_rect_union(bounds, region->rects[i]);
+    return bounds;
+}
+
+/*
+ * Full regions begin full_pass over the whole extent. Otherwise damage_pass begins over the region's bounds
+ * and every rect is cleared. Draw once per rect with it as the scissor (pipelines need vgk_set_dynamic_scissor):
+ * drawing outside the rects would blend over pixels that were kept. Each draw costs the frame's vertex work, so
+ * rects are merged into their bounds unless that redraws more than VGK_DAMAGE_MERGE_RATIO times their area,
+ * and callers should skip geometry that misses the rect. With MSAA the samples can't be loaded, so the region
+ * always collapses to its bounds, which the pass clears. The region must not be empty.
+ */
+void vgk_cmd_begin_damage_render_pass(VkCommandBuffer command_buffer, const Vgk_RenderPassBundle *full_pass, const Vgk_RenderPassBundle *damage_pass, Vgk_DamageRegion *region, u32 image_index, u32 frame_index, VkExtent2D extent, VkClearColorValue clear_color)
+{
+    // vkCmdClearAttachments takes at least one rect
+    bassert(region->is_full || region->rect_count > 0);
+
+    bool is_msaa = damage_pass->samples > VK_SAMPLE_COUNT_1_BIT;
+    const Vgk_RenderPassBundle *pass = region->is_full ? full_pass : damage_pass;
+    VkRect2D render_area = region->is_full ? (VkRect2D){ { 0, 0 }, extent } : vgk_damage_get_bounds(region);
+    if (!region->is_full && region->rect_count > 1)
+    {
+        u64 damaged_area = 0;
+        for (u32 i = 0; i < region->rect_count; i++) damaged_area += vgk_rect_area(region->rects[i]);
+        if (is_msaa || vgk_rect_area(render_area) <= (u64)(VGK_DAMAGE_MERGE_RATIO * damaged_area))
+        {
+            region->rects[0] = render_area;
+            region->rect_count = 1;
+        }
+    }
+
+    // Color, depth, resolve; the resolve value is unused
+    VkClearValue clear_values[3] = {};
+    clear_values[0].color = clear_color;
+    clear_values[1].depthStencil = (VkClearDepthStencilValue){ 1.0f, 0 };
+
+    VkRenderPassBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    begin_info.renderPass = pass->render_pass;
+    begin_info.framebuffer = vgk_get_framebuffer(pass, image_index, frame_index);
+    begin_info.renderArea = render_area;
+    begin_info.clearValueCount = array_count(clear_values);
+    begin_info.pClearValues = clear_values;
+    vkCmdBeginRenderPass(command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+    if (!region->is_full && !is_msaa)
+    {
+        VkClearAttachment clear_attachment = {};
+        clear_attachment.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        clear_attachment.colorAttachment = 0;
+        clear_attachment.clearValue.color = clear_color;
+
+        VkClearRect clear_rects[MAX_DAMAGE_RECTS];
+        for (u32 i = 0; i < region->rect_count; i++)
+        {
+            clear_rects[i] = (VkClearRect){ region->rects[i], 0, 1 };
+        }
+        vkCmdClearAttachments(command_buffer, 1, &clear_attachment, region->rect_count, clear_rects);
+    }
+}
+
+// ==================== COMPUTE =================================
+
+void vgk_cmd_bind_compute_pipeline(VkCommandBuffer command_buffer, const Vgk_ComputePipelineBundle *bundle, const Vgk_DescriptorSetBundle *descriptor_sets, u32 descriptor_set_count)
+{
+    bassert(descriptor_set_count <= MAX_DESCRIPTOR_SETS);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, bundle->pipeline);
+
+    if (descriptor_set_count > 0)
+    {
+        VkDescriptorSet sets[MAX_DESCRIPTOR_SETS];
+        for (u32 i = 0; i < descriptor_set_count; i++)
+        {
+            sets[i] = descriptor_sets[i].descriptor_set;
+        }
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, bundle->layout, 0, descriptor_set_count, sets, 0, NULL);
+    }
+}
+
+u32 vgk_get_group_count(u32 item_count, u32 local_size)
+{
+    bassert(local_size > 0);
+    u32 group_count = (item_count + local_size - 1) / local_size;
+    return group_count;
+}
+
+void vgk_cmd_dispatch_1d(VkCommandBuffer command_buffer, u32 item_count, u32 local_size)
+{
+    u32 group_count = vgk_get_group_count(item_count, local_size);
+    if (group_count == 0) return;
+    vkCmdDispatch(command_buffer, group_count, 1, 1);
+}
+
+void vgk_cmd_dispatch_2d(VkCommandBuffer command_buffer, u32 width, u32 height, u32 local_size_x, u32 local_size_y)
+{
+    u32 group_count_x = vgk_get_group_count(width, local_size_x);
+    u32 group_count_y = vgk_get_group_count(height, local_size_y);
+    if (group_count_x == 0 || group_count_y == 0) return;
+    vkCmdDispatch(command_buffer, group_count_x, group_count_y, 1);
+}
+
+void vgk_cmd_buffer_barrier(VkCommandBuffer command_buffer, VkBuffer buffer, VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+{
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(
+        command_buffer,
+        src_stage, dst_stage,
+        0,
+        0, NULL,
+        1, &barrier,
+        0, NULL
+    );
+}
+
+void vgk_cmd_image_barrier(VkCommandBuffer command_buffer, VkImage image, VkImageAspectFlags aspect, VkImageLayout old_layout, VkImageLayout new_layout, VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+{
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = aspect;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+    vkCmdPipelineBarrier(
+        command_buffer,
+        src_stage, dst_stage,
+        0,
+        0, NULL,
+        0, NULL,
+        1, &barrier
+    );
+}
+
+// ==================== CULLING =================================
+
+void vgk_cull_pass_set_objects(Vgk_CullPass *pass, u32 frame_index, const Vgk_CullObject *objects, u32 object_count)
+{
+    bassert(frame_index < pass->frame_count);
+    if (object_count > pass->max_object_count)
+    {
+        bassertf(false, "Too many cull objects: %u, max %u", object_count, pass->max_object_count);
+        object_count = pass->max_object_count;
+    }
+    memcpy(pass->object_buffers.buffer_bundles[frame_index].data_ptr, objects, object_count * sizeof(objects[0]));
+    pass->object_counts[frame_index] = object_count;
+}
+
+// Must be recorded outside of a render pass, before the draws that consume the batch
+void vgk_cmd_cull_to_indirect_list(VkCommandBuffer command_buffer, const Vgk_CullPass *pass, const Vgk_IndirectDrawList *list, u32 batch_index, m4 view_proj)
+{
+    bassert(batch_index < list->batch_count && list->batches[batch_index].gpu_count);
+    bassert(list->frame_index < pass->frame_count);
+
+    const Vgk_IndirectBatch *batch = &list->batches[batch_index];
+    VkBuffer indirect_buffer = list->command_buffers.buffer_bundles[list->frame_index].buffer;
+    VkBuffer count_buffer = list->count_buffers.buffer_bundles[list->frame_index].buffer;
+    u32 stride = sizeof(VkDrawIndexedIndirectCommand);
+
+    // Reset the batch range and its count
+    vkCmdFillBuffer(command_buffer, indirect_buffer, (VkDeviceSize)batch->first_command * stride, (VkDeviceSize)batch->command_count * stride, 0);
+    vkCmdFillBuffer(command_buffer, count_buffer, batch_index * sizeof(u32), sizeof(u32), 0);
+    vgk_cmd_buffer_barrier(
+        command_buffer, indirect_buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+    vgk_cmd_buffer_barrier(
+        command_buffer, count_buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    Vgk_CullPushConstants push_constants = {};
+    m4_frustum_planes(view_proj, push_constants.planes);
+    push_constants.object_count = pass->object_counts[list->frame_index];
+    push_constants.first_command = batch->first_command;
+    push_constants.count_index = batch_index;
+    push_constants.max_command_count = batch->command_count;
+
+    vgk_cmd_bind_compute_pipeline(command_buffer, &pass->pipeline_bundle, &pass->descriptor_sets[list->frame_index], 1);
+    vkCmdPushConstants(command_buffer, pass->pipeline_bundle.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+    vgk_cmd_dispatch_1d(command_buffer, push_constants.object_count, CULL_LOCAL_SIZE);
+
+    vgk_cmd_buffer_barrier(
+        command_buffer, indirect_buffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    vgk_cmd_buffer_barrier(
+        command_buffer, count_buffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+}
+
+// Reference for validating the cull pass. The GPU appends with atomics, so compare the
+// resulting sets, not the order.
+u32 vgk_cull_objects_cpu(const Vgk_CullObject *objects, u32 object_count, m4 view_proj, VkDrawIndexedIndirectCommand *out_commands, u32 max_command_count)
+{
+    v4 planes[6];
+    m4_frustum_planes(view_proj, planes);
+
+    u32 count = 0;
+    for (u32 i = 0; i < object_count; i++)
+    {
+        v4 sphere = objects[i].bounding_sphere;
+        if (!sphere_in_frustum(planes, V3(sphere.x, sphere.y, sphere.z), sphere.w)) continue;
+        if (count >= max_command_count) break;
+        out_commands[count++] = objects[i].draw;
+    }
+    return count;
+}
+
+// ==================== DESTROY =================================
+
+void vgk_destroy_swapchain_bundle(Vgk_SwapchainBundle *bundle, VkDevice device)
+{
+    free(bundle->images);
+    for (u32 i = 0; i < bundle->image_count; i++)
+    {
+        vkDestroySemaphore(device, bundle->submit_semaphores[i], NULL);
+        vkDestroyImageView(device, bundle->image_views[i], NULL);
+    }
+    free(bundle->submit_semaphores);
+    free(bundle->image_views);
+    vkDestroySwapchainKHR(device, bundle->swapchain, NULL);
+    *bundle = (Vgk_SwapchainBundle){};
+}
+
+void vgk_destroy_depth_image_bundle(Vgk_DepthImageBundle *bundle, VkDevice device)
+{
+    for (u32 i = 0; i < bundle->image_count; i++)
+    {
+        vkDestroyImage(device, bundle->images[i], NULL);
+        vgk_free_memory(bundle->memory_list[i], device);
+        vkDestroyImageView(device, bundle->image_views[i], NULL);
+    }
+    free(bundle->images);
+    free(bundle->memory_list);
+    free(bundle->image_views);
+    *bundle = (Vgk_DepthImageBundle){};
+}
+
+void vgk_destroy_msaa_image_bundle(Vgk_MsaaImageBundle *bundle, VkDevice device)
+{
+    for (u32 i = 0; i < bundle->image_count; i++)
+    {
+        vkDestroyImage(device, bundle->images[i], NULL);
+        vgk_free_memory(bundle->memory_list[i], device);
+        vkDestroyImageView(device, bundle->image_views[i], NULL);
+    }
+    free(bundle->images);
+    free(bundle->memory_list);
+    free(bundle->image_views);
+    *bundle = (Vgk_MsaaImageBundle){};
+}
+
+void vgk_destroy_render_pass_bundle(Vgk_RenderPassBundle *bundle, VkDevice device)
+{
+    for (u32 i = 0; i < bundle->framebuffer_count; i++)
+    {
+        vkDestroyFramebuffer(device, bundle->framebuffers[i], NULL);
+    }
+    free(bundle->framebuffers);
+    vkDestroyRenderPass(device, bundle->render_pass, NULL);
+    *bundle = (Vgk_RenderPassBundle){};
+}
+
+void vgk_destroy_command_pool(VkCommandPool *command_pool, VkDevice device)
+{
+    vkDestroyCommandPool(device, *command_pool, NULL);
+    *command_pool = VK_NULL_HANDLE;
+}
+
+void vgk_destroy_frame_list(Vgk_FrameList *list, VkDevice device)
+{
+    for (u32 i = 0; i < list->count; i++)
+    {
+        vkDestroySemaphore(device, list->frames[i].acquire_semaphore, NULL);
+        destroy_arena(&list->frames[i].arena);
+    }
+    vkDestroySemaphore(device, list->timeline_semaphore, NULL);
+
+    // The device is idle by now, everything still queued can go
+    vgk_frame_list_flush_deletions(list, UINT64_MAX, device);
+    list_free(&list->deletion_queue);
+
+    free(list->frames);
+
+    *list = (Vgk_FrameList){};
+}
+
+void vgk_destroy_parallel_recorder(Vgk_ParallelRecorder *recorder, VkDevice device)
+{
+    destroy_thread_pool(recorder->thread_pool);
+    for (u32 i = 0; i < recorder->thread_count * recorder->frame_count; i++)
+    {
+        // Destroying the pool frees its command buffers
+        vkDestroyCommandPool(device, recorder->slots[i].command_pool, NULL);
+    }
+    free(recorder->slots);
+    *recorder = (Vgk_ParallelRecorder){};
+}
+
+void vgk_destroy_render_graph(Vgk_RenderGraph *graph, VkDevice device)
+{
+    for (u32 p = 0; p < graph->pass_count; p++)
+    {
+        Vgk_RgPass *pass = &graph->passes[p];
+        if (pass->render_pass == VK_NULL_HANDLE) continue;
+        for (u32 v = 0; v < pass->framebuffer_count; v++)
+        {
+            vkDestroyFramebuffer(device, pass->framebuffers[v], NULL);
+        }
+        vkDestroyRenderPass(device, pass->render_pass, NULL);
+    }
+    for (u32 i = 0; i < graph->resource_count; i++)
+    {
+        Vgk_RgResource *resource = &graph->resources[i];
+        if (resource->is_imported || !resource->is_used) continue;
+        vkDestroyImageView(device, resource->image_views[0], NULL);
+        vkDestroyImage(device, resource->images[0], NULL);
+    }
+    for (u32 b = 0; b < graph->memory_block_count; b++)
+    {
+        vgk_free_memory(graph->memory_blocks[b], device);
+    }
+    *graph = (Vgk_RenderGraph){};
+}
+
+void vgk_destroy_buffer_bundle(Vgk_BufferBundle *bundle, VkDevice device)
+{
+    if (bundle->data_ptr) vkUnmapMemory(device, bundle->memory);
+    vgk_free_memory(bundle->memory, device);
+    vkDestroyBuffer(device, bundle->buffer, NULL);
+    *bundle = (Vgk_BufferBundle){};
+}
+
+void vgk_destroy_buffer_bundle_list(Vgk_BufferBundleList *list, VkDevice device)
+{
+    for (u32 i = 0; i < list->count; i++)
+    {
+        vgk_destroy_buffer_bundle(&list->buffer_bundles[i], device);
+    }
+    free(list->buffer_bundles);
+    *list = (Vgk_BufferBundleList){};
+}
+
+void vgk_destroy_staging_pool(Vgk_StagingPool *pool, VkDevice device)
+{
+    for (u32 i = 0; i < pool->chunk_count; i++)
+    {
+        vgk_destroy_buffer_bundle(&pool->chunks[i].buffer, device);
+    }
+    *pool = (Vgk_StagingPool){};
+}
+
+// Pending callbacks are dropped; wait for the device to go idle first
+void vgk_destroy_readback_ring(Vgk_ReadbackRing *ring, VkDevice device)
+{
+    for (u32 i = 0; i < ring->slot_count; i++)
+    {
+        if (ring->slots[i].buffer.buffer != VK_NULL_HANDLE) vgk_destroy_buffer_bundle(&ring->slots[i].buffer, device);
+    }
+    *ring = (Vgk_ReadbackRing){};
+}
+
+void vgk_destroy_ui_batch(Vgk_UiBatch *batch, VkDevice device)
+{
+    vgk_destroy_buffer_bundle_list(&batch->vertex_buffers, device);
+    *batch = (Vgk_UiBatch){};
+}
+
+void vgk_destroy_glyph_cache(Vgk_GlyphCache *cache, VkDevice device)
+{
+    vgk_destroy_texture_bundle(&cache->atlas, device);
+    free(cache->atlas_pixels);
+    free(cache->map_keys);
+    free(cache->map_cells);
+    free(cache->cells);
+    free(cache->font_info);
+    free(cache->font_data);
+    *cache = (Vgk_GlyphCache){};
+}
+
+void vgk_destroy_texture_atlas(Vgk_TextureAtlas *atlas, VkDevice device)
+{
+    for (u32 i = 0; i < atlas->page_count; i++)
+    {
+        vgk_destroy_texture_bundle(&atlas->pages[i], device);
+        destroy_skyline_packer(&atlas->packers[i]);
+    }
+    *atlas = (Vgk_TextureAtlas){};
+}
+
+void vgk_destroy_texture_bundle(Vgk_TextureBundle *bundle, VkDevice device)
+{
+    vkDestroyImage(device, bundle->image, NULL);
+    vgk_free_memory(bundle->memory, device);
+    vkDestroyImageView(device, bundle->image_view, NULL);
+    vkDestroySampler(device, bundle->sampler, NULL);
+}
+
+void vgk_destroy_pipeline_bundle(Vgk_PipelineBundle *bundle, VkDevice device)
+{
+    vkDestroyPipeline(device, bundle->pipeline, NULL);
+    vkDestroyPipelineLayout(device, bundle->layout, NULL);
+    *bundle = (Vgk_PipelineBundle){};
+}
+
+void vgk_destroy_pipeline_table(Vgk_PipelineTable *table, VkDevice device)
+{
+    for (u32 i = 0; i < table->slots.used_count; i++)
+    {
+        if (!slot_map_is_alive_index(&table->slots, i)) continue;
+        vkDestroyPipeline(device, table->pipelines[i], NULL);
+        vkDestroyPipelineLayout(device, table->layouts[i], NULL);
+    }
+    destroy_slot_map(&table->slots);
+    free(table->pipelines);
+    free(table->layouts);
+    free(table->pending);
+    free(table->fallbacks);
+    free(table->specs);
+    *table = (Vgk_PipelineTable){};
+}
+
+// Queued jobs that haven't started are dropped, their handles stay pending
+void vgk_destroy_pipeline_compiler(Vgk_PipelineCompiler *compiler, VkDevice device)
+{
+    pthread_mutex_lock(&compiler->mutex);
+    compiler->shutting_down = true;
+    pthread_cond_signal(&compiler->work_cond);
+    pthread_mutex_unlock(&compiler->mutex);
+    pthread_join(compiler->thread, NULL);
+
+    Vgk_PipelineCompileResult *result;
+    list_iterate(&compiler->completed, i, result)
+    {
+        vgk_destroy_pipeline_bundle(&result->bundle, device);
+    }
+
+    list_free(&compiler->queue);
+    list_free(&compiler->completed);
+    list_free(&compiler->installing);
+    pthread_mutex_destroy(&compiler->mutex);
+    pthread_cond_destroy(&compiler->work_cond);
+    free(compiler);
+}
+
+void vgk_destroy_pipeline_registry(Vgk_PipelineRegistry *registry, VkDevice device)
+{
+    vgk_destroy_pipeline_table(&registry->table, device);
+    free(registry->keys);
+    free(registry->values);
+    free(registry->shader_hashes);
+    *registry = (Vgk_PipelineRegistry){};
+}
+
+void vgk_destroy_compute_pipeline_bundle(Vgk_ComputePipelineBundle *bundle, VkDevice device)
+{
+    vkDestroyPipeline(device, bundle->pipeline, NULL);
+    vkDestroyPipelineLayout(device, bundle->layout, NULL);
+    *bundle = (Vgk_ComputePipelineBundle){};
+}
+
+void vgk_destroy_cull_pass(Vgk_CullPass *pass, VkDevice device)
+{
+    // Descriptor sets go back to the pool with the pool itself
+    for (u32 i = 0; i < pass->frame_count; i++)
+    {
+        vkDestroyDescriptorSetLayout(device, pass->descriptor_sets[i].layout, NULL);
+    }
+    free(pass->descriptor_sets);
+    free(pass->object_counts);
+    vgk_destroy_buffer_bundle_list(&pass->object_buffers, device);
+    vgk_destroy_compute_pipeline_bundle(&pass->pipeline_bundle, device);
+    *pass = (Vgk_CullPass){};
+}
+
+void vgk_destroy_indirect_draw_list(Vgk_IndirectDrawList *list, VkDevice device)
+{
+    vgk_destroy_buffer_bundle_list(&list->command_buffers, device);
+    vgk_destroy_buffer_bundle_list(&list->count_buffers, device);
+    vgk_destroy_buffer_bundle_list(&list->upload_buffers, device);
+    *list = (Vgk_IndirectDrawList){};
+}
+
+// ==================== DEFERRED DESTROY =================================
+
+// Resources handed over here may still be referenced by submitted or currently recorded work.
+// They are destroyed once the timeline passes the next submission, or the open frame's submission
+// when deferred while recording one, so nothing waits for the device to idle.
+void vgk_defer_deletion(Vgk_FrameList *frame_list, const Vgk_Deletion *deletion)
+{
+    Vgk_Deletion queued = *deletion;
+    queued.timeline_value = vgk_frame_list_get_use_value(frame_list);
+    list_append(&frame_list->deletion_queue, queued);
+}
+
+void vgk_defer_destroy_buffer_bundle(Vgk_FrameList *frame_list, Vgk_BufferBundle *bundle)
+{
+    Vgk_Deletion deletion = {};
+    deletion.type = VGK_DELETION_BUFFER;
+    deletion.buffer = bundle->buffer;
+    vgk_defer_deletion(frame_list, &deletion);
+    // Freeing the memory unmaps it
+    deletion.type = VGK_DELETION_MEMORY;
+    deletion.memory = bundle->memory;
+    vgk_defer_deletion(frame_list, &deletion);
+    *bundle = (Vgk_BufferBundle){};
+}
+
+void vgk_defer_destroy_texture_bundle(Vgk_FrameList *frame_list, Vgk_TextureBundle *bundle)
+{
+    Vgk_Deletion deletion = {};
+    deletion.type = VGK_DELETION_IMAGE_VIEW;
+    deletion.image_view = bundle->image_view;
+    vgk_defer_deletion(frame_list, &deletion);
+    deletion.type = VGK_DELETION_SAMPLER;
+    deletion.sampler = bundle->sampler;
+    vgk_defer_deletion(frame_list, &deletion);
+    deletion.type = VGK_DELETION_IMAGE;
+    deletion.image = bundle->image;
+    vgk_defer_deletion(frame_list, &deletion);
+    deletion.type = VGK_DELETION_MEMORY;
+    deletion.memory = bundle->memory;
+    vgk_defer_deletion(frame_list, &deletion);
+    *bundle = (Vgk_TextureBundle){};
+}
+
+void vgk_defer_destroy_pipeline_bundle(Vgk_FrameList *frame_list, Vgk_PipelineBundle *bundle)
+{
+    Vgk_Deletion deletion = {};
+    deletion.type = VGK_DELETION_PIPELINE;
+    deletion.pipeline = bundle->pipeline;
+    vgk_defer_deletion(frame_list, &deletion);
+    deletion.type = VGK_DELETION_PIPELINE_LAYOUT;
+    deletion.pipeline_layout = bundle->layout;
+    vgk_defer_deletion(frame_list, &deletion);
+    *bundle = (Vgk_PipelineBundle){};
+}
+
+void vgk_defer_destroy_compute_pipeline_bundle(Vgk_FrameList *frame_list, Vgk_ComputePipelineBundle *bundle)
+{
+    Vgk_Deletion deletion = {};
+    deletion.type = VGK_DELETION_PIPELINE;
+    deletion.pipeline = bundle->pipeline;
+    vgk_defer_deletion(frame_list, &deletion);
+    deletion.type = VGK_DELETION_PIPELINE_LAYOUT;
+    deletion.pipeline_layout = bundle->layout;
+    vgk_defer_deletion(frame_list, &deletion);
+    *bundle = (Vgk_ComputePipelineBundle){};
+}
+
+// The set's descriptors are returned to pool_bundle's accounting when the set is actually freed
+void vgk_defer_destroy_descriptor_set_bundle(Vgk_FrameList *frame_list, Vgk_DescriptorPoolBundle *pool_bundle, Vgk_DescriptorSetBundle *bundle)
+{
+    Vgk_Deletion deletion = {};
+    deletion.type = VGK_DELETION_DESCRIPTOR_SET;
+    deletion.descriptor.descriptor_set = bundle->descriptor_set;
+    deletion.descriptor.pool_bundle = pool_bundle;
+    for (u32 i = 0; i < bundle->spec.binding_count; i++)
+    {
+        const Vgk_DescriptorBinding *binding = &bundle->spec.bindings[i];
+        switch (binding->descriptor_type)
+        {
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER: deletion.descriptor.uniform_buffer_count += binding->descriptor_count; break;
+            case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER: deletion.descriptor.image_sampler_count += binding->descriptor_count; break;
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER: deletion.descriptor.storage_buffer_count += binding->descriptor_count; break;
+            case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE: deletion.descriptor.storage_image_count += binding->descriptor_count; break;
+            default: fatal("Descriptor type not implemented");
+        }
+    }
+    vgk_defer_deletion(frame_list, &deletion);
+
+    deletion = (Vgk_Deletion){};
+    deletion.type = VGK_DELETION_DESCRIPTOR_SET_LAYOUT;
+    deletion.descriptor_set_layout = bundle->layout;
+    vgk_defer_deletion(frame_list, &deletion);
+    *bundle = (Vgk_DescriptorSetBundle){};
+}
+
+void vgk_defer_destroy_render_pass_bundle(Vgk_FrameList *frame_list, Vgk_RenderPassBundle *bundle)
+{
+    Vgk_Deletion deletion = {};
+    for (u32 i = 0; i < bundle->framebuffer_count; i++)
+    {
+        deletion.type = VGK_DELETION_FRAMEBUFFER;
+        deletion.framebuffer = bundle->framebuffers[i];
+        vgk_defer_deletion(frame_list, &deletion);
+    }
+    free(bundle->framebuffers);
+    deletion.type = VGK_DELETION_RENDER_PASS;
+    deletion.render_pass = bundle->render_pass;
+    vgk_defer_deletion(frame_list, &deletion);
+    *bundle = (Vgk_RenderPassBundle){};
+}
+
+static void vgk_destroy_deletion(const Vgk_Deletion *deletion, VkDevice device)
+{
+    switch (deletion->type)
+    {
+        case VGK_DELETION_BUFFER: vkDestroyBuffer(device, deletion->buffer, NULL); break;
+        case VGK_DELETION_IMAGE: vkDestroyImage(device, deletion->image, NULL); break;
+        case VGK_DELETION_IMAGE_VIEW: vkDestroyImageView(device, deletion->image_view, NULL); break;
+        case VGK_DELETION_SAMPLER: vkDestroySampler(device, deletion->sampler, NULL); break;
+        case VGK_DELETION_MEMORY: vgk_free_memory(deletion->memory, device); break;
+        case VGK_DELETION_PIPELINE: vkDestroyPipeline(device, deletion->pipeline, NULL); break;
+        case VGK_DELETION_PIPELINE_LAYOUT: vkDestroyPipelineLayout(device, deletion->pipeline_layout, NULL); break;
+        case VGK_DELETION_DESCRIPTOR_SET_LAYOUT: vkDestroyDescriptorSetLayout(device, deletion->descriptor_set_layout, NULL); break;
+        case VGK_DELETION_FRAMEBUFFER: vkDestroyFramebuffer(device, deletion->framebuffer, NULL); break;
+        case VGK_DELETION_RENDER_PASS: vkDestroyRenderPass(device, deletion->render_pass, NULL); break;
+
+        case VGK_DELETION_DESCRIPTOR_SET:
+        {
+            Vgk_DescriptorPoolBundle *pool_bundle = deletion->descriptor.pool_bundle;
+            VkResult result = vkFreeDescriptorSets(device, pool_bundle->descriptor_pool, 1, &deletion->descriptor.descriptor_set);
+            if (result != VK_SUCCESS) fatal("Failed to free descriptor set");
+            pool_bundle->uniform_buffer_count -= deletion->descriptor.uniform_buffer_count;
+            pool_bundle->image_sampler_count -= deletion->descriptor.image_sampler_count;
+            pool_bundle->storage_buffer_count -= deletion->descriptor.storage_buffer_count;
+            pool_bundle->storage_image_count -= deletion->descriptor.storage_image_count;
+        } break;
+
+        default: fatal("Deletion type not implemented");
+    }
+}
+
+// Destroys every queued resource whose timeline value has completed, keeps the rest in order
+void vgk_frame_list_flush_deletions(Vgk_FrameList *frame_list, u64 completed_value, VkDevice device)
+{
+    Vgk_DeletionQueue *queue = &frame_list->deletion_queue;
+    size_t kept_count = 0;
+    for (size_t i = 0; i < queue->size; i++)
+    {
+        const Vgk_Deletion *deletion = &queue->data[i];
+        if (vgk_frame_list_resolve_use_value(frame_list, deletion->timeline_value) <= completed_value)
+        {
+            vgk_destroy_deletion(deletion, device);
+        }
+        else
+        {
+            queue->data[kept_count++] = *deletion;
+        }
+    }
+    queue->size = kept_count;
+}
+
+// ==================== MEMORY =================================
+
+struct Vgk_MemoryAllocation
+{
+    VkDeviceMemory memory; // VK_NULL_HANDLE marks an empty slot
+    VkDeviceSize size;
+    Vgk_MemoryCategory category;
+    u32 heap_index;
+};
+
+// Live allocations keyed by VkDeviceMemory (open addressing, linear probing, backward-shift
+// removal) so frees can be attributed without callers carrying size and category around.
+// Device memory is only allocated and freed from the main thread.
+struct Vgk_MemoryTracker
+{
+    VkPhysicalDevice physical_device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    Vgk_MemoryStats stats;
+
+    Vgk_MemoryAllocation *slots;
+    u32 capacity; // power of two
+    u32 count;
+
+    f64 last_log_time;
+};
+
+static Vgk_MemoryTracker vgk_memory_tracker;
+
+static const char *vgk_memory_category_names[VGK_MEMORY_CATEGORY_COUNT] = {
+    "depth", "color", "texture", "vertex", "index", "uniform", "storage", "staging", "render graph", "other"
+};
+
+static void vgk_init_memory_tracker(VkPhysicalDevice physical_device, bool has_budget)
+{
+    Vgk_MemoryTracker *tracker = &vgk_memory_tracker;
+    free(tracker->slots);
+    *tracker = (Vgk_MemoryTracker){};
+    tracker->physical_device = physical_device;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &tracker->memory_properties);
+
+    tracker->stats.has_budget = has_budget;
+    tracker->stats.heap_count = tracker->memory_properties.memoryHeapCount;
+    for (u32 i = 0; i < tracker->stats.heap_count; i++)
+    {
+        tracker->stats.heaps[i].size = tracker->memory_properties.memoryHeaps[i].size;
+        tracker->stats.heaps[i].flags = tracker->memory_properties.memoryHeaps[i].flags;
+    }
+
+    tracker->capacity = 256;
+    tracker->slots = (Vgk_MemoryAllocation *)xcalloc(tracker->capacity * sizeof(tracker->slots[0]));
+}
+
+static u32 vgk_memory_tracker_home(const Vgk_MemoryTracker *tracker, VkDeviceMemory memory)
+{
+    return (u32)hash_fnv1a64(&memory, sizeof(memory), FNV1A64_SEED) & (tracker->capacity - 1);
+}
+
+static u32 vgk_memory_tracker_probe(const Vgk_MemoryTracker *tracker, VkDeviceMemory memory)
+{
+    u32 mask = tracker->capacity - 1;
+    u32 slot = vgk_memory_tracker_home(tracker, memory);
+    while (tracker->slots[slot].memory != VK_NULL_HANDLE && tracker->slots[slot].memory != memory)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void vgk_memory_tracker_insert(Vgk_MemoryTracker *tracker, const Vgk_MemoryAllocation *allocation)
+{
+    if ((tracker->count + 1) * 4 > tracker->capacity * 3)
+    {
+        Vgk_MemoryAllocation *old_slots = tracker->slots;
+        u32 old_capacity = tracker->capacity;
+        tracker->capacity *= 2;
+        tracker->slots = (Vgk_MemoryAllocation *)xcalloc(tracker->capacity * sizeof(tracker->slots[0]));
+        for (u32 i = 0; i < old_capacity; i++)
+        {
+            if (old_slots[i].memory == VK_NULL_HANDLE) continue;
+            tracker->slots[vgk_memory_tracker_probe(tracker, old_slots[i].memory)] = old_slots[i];
+        }
+        free(old_slots);
+    }
+
+    tracker->slots[vgk_memory_tracker_probe(tracker, allocation->memory)] = *allocation;
+    tracker->count++;
+}
+
+static bool vgk_memory_tracker_remove(Vgk_MemoryTracker *tracker, VkDeviceMemory memory, Vgk_MemoryAllocation *out_allocation)
+{
+    u32 mask = tracker->capacity - 1;
+    u32 hole = vgk_memory_tracker_probe(tracker, memory);
+    if (tracker->slots[hole].memory == VK_NULL_HANDLE) return false;
+    *out_allocation = tracker->slots[hole];
+
+    // Pull later entries of the probe run back into the hole when their home allows it
+    u32 next = hole;
+    for (;;)
+    {
+        next = (next + 1) & mask;
+        if (tracker->slots[next].memory == VK_NULL_HANDLE) break;
+        u32 home = vgk_memory_tracker_home(tracker, tracker->slots[next].memory);
+        bool home_in_range = hole <= next ? (home > hole && home <= next) : (home > hole || home <= next);
+        if (home_in_range) continue;
+        tracker->slots[hole] = tracker->slots[next];
+        hole = next;
+    }
+    tracker->slots[hole] = (Vgk_MemoryAllocation){};
+    tracker->count--;
+    return true;
+}
+
+static void vgk_memory_counter_add(Vgk_MemoryCounter *counter, VkDeviceSize size)
+{
+    counter->bytes += size;
+    counter->allocation_count++;
+    if (counter->bytes > counter->peak_bytes) counter->peak_bytes = counter->bytes;
+}
+
+static void vgk_memory_counter_sub(Vgk_MemoryCounter *counter, VkDeviceSize size)
+{
+    counter->bytes -= size;
+    counter->allocation_count--;
+}
+
+VkResult vgk_allocate_memory(const VkMemoryAllocateInfo *allocate_info, Vgk_MemoryCategory category, VkDevice device, VkDeviceMemory *out_memory)
+{
+    VkResult result = vkAllocateMemory(device, allocate_info, NULL, out_memory);
+    if (result != VK_SUCCESS) return result;
+
+    Vgk_MemoryTracker *tracker = &vgk_memory_tracker;
+    bassertf(tracker->slots, "vgk_create_device sets up memory tracking");
+    if (!tracker->slots) return result;
+
+    Vgk_MemoryAllocation allocation = {};
+    allocation.memory = *out_memory;
+    allocation.size = allocate_info->allocationSize;
+    allocation.category = category;
+    allocation.heap_index = tracker->memory_properties.memoryTypes[allocate_info->memoryTypeIndex].heapIndex;
+    vgk_memory_tracker_insert(tracker, &allocation);
+
+    vgk_memory_counter_add(&tracker->stats.total, allocation.size);
+    vgk_memory_counter_add(&tracker->stats.categories[category], allocation.size);
+    vgk_memory_counter_add(&tracker->stats.heaps[allocation.heap_index].allocated, allocation.size);
+    return result;
+}
+
+void vgk_free_memory(VkDeviceMemory memory, VkDevice device)
+{
+    if (memory == VK_NULL_HANDLE) return;
+    vkFreeMemory(device, memory, NULL);
+
+    Vgk_MemoryTracker *tracker = &vgk_memory_tracker;
+    Vgk_MemoryAllocation allocation;
+    if (!tracker->slots || !vgk_memory_tracker_remove(tracker, memory, &allocation))
+    {
+        warning("Freed device memory that wasn't allocated through vgk_allocate_memory");
+        return;
+    }
+
+    vgk_memory_counter_sub(&tracker->stats.total, allocation.size);
+    vgk_memory_counter_sub(&tracker->stats.categories[allocation.category], allocation.size);
+    vgk_memory_counter_sub(&tracker->stats.heaps[allocation.heap_index].allocated, allocation.size);
+}
+
+// Most specific usage wins, buffers that are only copied from are staging
+Vgk_MemoryCategory vgk_get_buffer_memory_category(VkBufferUsageFlags usage)
+{
+    if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) return VGK_MEMORY_VERTEX;
+    if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) return VGK_MEMORY_INDEX;
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) return VGK_MEMORY_UNIFORM;
+    if (usage & (VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT)) return VGK_MEMORY_STORAGE;
+    if (usage == VK_BUFFER_USAGE_TRANSFER_SRC_BIT) return VGK_MEMORY_STAGING;
+    return VGK_MEMORY_OTHER;
+}
+
+// Expands [offset, offset + size) to nonCoherentAtomSize boundaries, clamped to the allocation
+static VkMappedMemoryRange vgk_get_mapped_range(const Vgk_BufferBundle *bundle, VkDeviceSize offset, VkDeviceSize size)
+{
+    VkDeviceSize atom = bundle->atom_size ? bundle->atom_size : 1;
+    VkDeviceSize begin = offset / atom * atom;
+    VkDeviceSize end = size == VK_WHOLE_SIZE ? bundle->allocation_size : (offset + size + atom - 1) / atom * atom;
+    if (end > bundle->allocation_size) end = bundle->allocation_size;
+
+    VkMappedMemoryRange range = {};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = bundle->memory;
+    range.offset = begin;
+    range.size = end - begin;
+    return range;
+}
+
+// After CPU writes, before the GPU reads them. No-op on coherent memory.
+void vgk_flush_buffer_bundle(const Vgk_BufferBundle *bundle, VkDeviceSize offset, VkDeviceSize size, VkDevice device)
+{
+    if (bundle->is_coherent) return;
+    VkMappedMemoryRange range = vgk_get_mapped_range(bundle, offset, size);
+    VkResult result = vkFlushMappedMemoryRanges(device, 1, &range);
+    if (result != VK_SUCCESS) fatal("Failed to flush mapped memory");
+}
+
+// After the GPU writes are complete, before the CPU reads them. No-op on coherent memory.
+void vgk_invalidate_buffer_bundle(const Vgk_BufferBundle *bundle, VkDeviceSize offset, VkDeviceSize size, VkDevice device)
+{
+    if (bundle->is_coherent) return;
+    VkMappedMemoryRange range = vgk_get_mapped_range(bundle, offset, size);
+    VkResult result = vkInvalidateMappedMemoryRanges(device, 1, &range);
+    if (result != VK_SUCCESS) fatal("Failed to invalidate mapped memory");
+}
+
+// Copy of the counters, with live budget and usage per heap when VK_EXT_memory_budget is enabled
+Vgk_MemoryStats vgk_get_memory_stats()
+{
+    Vgk_MemoryTracker *tracker = &vgk_memory_tracker;
+    Vgk_MemoryStats stats = tracker->stats;
+    if (stats.has_budget)
+    {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+        budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+        VkPhysicalDeviceMemoryProperties2 props = {};
+        props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        props.pNext = &budget;
+        vkGetPhysicalDeviceMemoryProperties2(tracker->physical_device, &props);
+
+        for (u32 i = 0; i < stats.heap_count; i++)
+        {
+            stats.heaps[i].budget = budget.heapBudget[i];
+            stats.heaps[i].usage = budget.heapUsage[i];
+        }
+    }
+    return stats;
+}
+
+#define VGK_MB(BYTES) ((f64)(BYTES) / (f64)megabytes(1))
+
+// One line: totals, non-empty categories, then every heap
+void vgk_log_memory_stats()
+{
+    Vgk_MemoryStats stats = vgk_get_memory_stats();
+
+    char line[1024];
+    int len = snprintf(line, sizeof(line), "GPU memory %.1f MB in %u allocs (peak %.1f MB) |",
+        VGK_MB(stats.total.bytes), stats.total.allocation_count, VGK_MB(stats.total.peak_bytes));
+    for (u32 i = 0; i < VGK_MEMORY_CATEGORY_COUNT && len < (int)sizeof(line); i++)
+    {
+        if (stats.categories[i].allocation_count == 0) continue;
+        len += snprintf(line + len, sizeof(line) - len, " %s %.1f", vgk_memory_category_names[i], VGK_MB(stats.categories[i].bytes));
+    }
+    for (u32 i = 0; i < stats.heap_count && len < (int)sizeof(line); i++)
+    {
+        const Vgk_MemoryHeapStats *heap = &stats.heaps[i];
+        const char *kind = heap->flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? "device" : "host";
+        if (stats.has_budget)
+        {
+            len += snprintf(line + len, sizeof(line) - len, " | heap %u (%s) ours %.1f, usage %.1f / budget %.1f MB",
+                i, kind, VGK_MB(heap->allocated.bytes), VGK_MB(heap->usage), VGK_MB(heap->budget));
+        }
+        else
+        {
+            len += snprintf(line + len, sizeof(line) - len, " | heap %u (%s) %.1f / %.1f MB",
+                i, kind, VGK_MB(heap->allocated.bytes), VGK_MB(heap->size));
+        }
+    }
+    trace("%s", line);
+}
+
+// Call every frame; logs at most once per VGK_MEMORY_LOG_INTERVAL
+void vgk_maybe_log_memory_stats(f64 now_seconds)
+{
+    Vgk_MemoryTracker *tracker = &vgk_memory_tracker;
+    if (tracker->last_log_time != 0.0 && now_seconds - tracker->last_log_time < VGK_MEMORY_LOG_INTERVAL) return;
+    tracker->last_log_time = now_seconds;
+    vgk_log_memory_stats();
+}
+
+// ============================ HELPERS ===============================
+
+// Per-thread arena for temporaries that don't outlive the call, used through arena_temp_begin/arena_temp_end
+Arena *vgk_get_scratch_arena()
+{
+    static thread_local Arena scratch_arena;
+    if (!scratch_arena.base)
+    {
+        scratch_arena = make_arena(VGK_SCRATCH_ARENA_RESERVE);
+    }
+    return &scratch_arena;
+}
+
+Vgk_DeviceCaps vgk_get_device_caps(VkPhysicalDevice physical_device)
+{
+    VkPhysicalDeviceVulkan12Features vulkan12_features = {};
+    vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceVulkan13Features vulkan13_features = {};
+    vulkan13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    vulkan13_features.pNext = &vulkan12_features;
+
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &vulkan13_features;
+    vkGetPhysicalDeviceFeatures2(physical_device, &features);
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physical_device, &props);
+
+    Vgk_DeviceCaps caps = {};
+    caps.multi_draw_indirect = features.features.multiDrawIndirect;
+    caps.draw_indirect_count = vulkan12_features.drawIndirectCount;
+    caps.draw_indirect_first_instance = features.features.drawIndirectFirstInstance;
+    caps.max_draw_indirect_count = caps.multi_draw_indirect ? props.limits.maxDrawIndirectCount : 1;
+    caps.max_push_constants_size = props.limits.maxPushConstantsSize;
+    caps.dynamic_rendering = vulkan13_features.dynamicRendering;
+
+    {
+        u32 count;
+        vkEnumerateDeviceExtensionProperties(physical_device, NULL, &count, NULL);
+        ArenaTemp scratch = arena_temp_begin(vgk_get_scratch_arena());
+        VkExtensionProperties *extensions = arena_alloc_array(scratch.arena, VkExtensionProperties, count);
+        vkEnumerateDeviceExtensionProperties(physical_device, NULL, &count, extensions);
+        for (u32 i = 0; i < count; i++)
+        {
+            if (strcmp(extensions[i].extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) caps.memory_budget = true;
+        }
+        arena_temp_end(scratch);
+    }
+    return caps;
+}
+
+u32 vgk_get_queue_family_index(VkPhysicalDevice physical_device, VkSurfaceKHR surface)
+{
+    u32 queue_family_index = UINT32_MAX;
+    {
+        u32 count;
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, NULL);
+        ArenaTemp scratch = arena_temp_begin(vgk_get_scratch_arena());
+        VkQueueFamilyProperties *queue_families = arena_alloc_array(scratch.arena, VkQueueFamilyProperties, count);
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, queue_families);
+        for (u32 i = 0; i < count; i++)
+        {
+            VkBool32 present_support;
+            vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &present_support);
+            // Compute work is recorded on the same queue, a graphics family with compute is guaranteed to exist
+            VkQueueFlags required_flags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+            if ((queue_families[i].queueFlags & required_flags) == required_flags && present_support)
+            {
+                queue_family_index = i;
+            }
+        }
+        arena_temp_end(scratch);
+        assert(queue_family_index < UINT32_MAX);
+    }
+    return queue_family_index;
+}
+
+u32 vgk_find_memory_type(VkPhysicalDevice physical_device, u32 type_filter, VkMemoryPropertyFlags props)
+{
+    u32 type_index;
+    if (!vgk_try_find_memory_type(physical_device, type_filter, props, &type_index)) fatal("Failed to find suitable memory type");
+    return type_index;
+}
+
+bool vgk_try_find_memory_type(VkPhysicalDevice physical_device, u32 type_filter, VkMemoryPropertyFlags props, u32 *out_type_index)
+{
+    VkPhysicalDeviceMemoryProperties mem_props;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_props);
+    for (u32 i = 0; i < mem_props.memoryTypeCount; i++)
+    {
+        if ((type_filter & (1 << i)) &&
+            (mem_props.memoryTypes[i].propertyFlags & props) == props)
+        {
+            *out_type_index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Best scoring type with all required flags: preferred counts most, then secondary, avoided costs one.
+// Ties go to the lower index, the driver's own performance order.
+bool vgk_try_find_preferred_memory_type(VkPhysicalDevice physical_device, u32 type_filter, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags secondary, VkMemoryPropertyFlags avoided, u32 *out_type_index)
+{
+    VkPhysicalDeviceMemoryProperties mem_props;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_props);
+
+    i32 best_score = -1;
+    for (u32 i = 0; i < mem_props.memoryTypeCount; i++)
+    {
+        VkMemoryPropertyFlags flags = mem_props.memoryTypes[i].propertyFlags;
+        if (!(type_filter & (1 << i)) || (flags & required) != required) continue;
+
+        i32 score = 1;
+        if (preferred && (flags & preferred) == preferred) score += 4;
+        if (secondary && (flags & secondary) == secondary) score += 2;
+        if (flags & avoided) score -= 1;
+        if (score > best_score)
+        {
+            best_score = score;
+            *out_type_index = i;
+        }
+    }
+    return best_score >= 0;
+}
+
+// Highest supported count not above the requested one, for both color and depth attachments
+VkSampleCountFlagBits vgk_clamp_sample_count(VkPhysicalDevice physical_device, VkSampleCountFlagBits requested)
+{
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physical_device, &props);
+    VkSampleCountFlags supported = props.limits.framebufferColorSampleCounts & props.limits.framebufferDepthSampleCounts;
+
+    u32 samples = (u32)requested;
+    while (samples > 1 && (supported & samples) == 0)
+    {
+        samples >>= 1;
+    }
+    return (VkSampleCountFlagBits)samples;
+}
+
+VkFramebuffer vgk_get_framebuffer(const Vgk_RenderPassBundle *bundle, u32 image_index, u32 frame_index)
+{
+    u32 index = image_index * bundle->frame_attachment_count + (frame_index % bundle->frame_attachment_count);
+    bassert(index < bundle->framebuffer_count);
+    return bundle->framebuffers[index];
 }
 
 VkViewport vgk_get_viewport_for_extent(VkExtent2D extent)
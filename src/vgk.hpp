@@ -9,10 +9,101 @@
 #define MAX_DESCRIPTOR_SETS 4
 #define MAX_DESCRIPTOR_BINDINGS 16
 #define MAX_VERT_ATTRIBUTES 16
+#define MAX_PUSH_CONSTANT_RANGES 4
+#define MAX_SHADER_PATH_LENGTH 256
+#define MAX_CACHED_SHADER_HASHES 256
 
 #define MAX_DESCRIPTOR_SETS_IN_POOL 256
 #define MAX_UNIFORM_BUFFERS_IN_POOL 128
 #define MAX_IMAGE_SAMPLERS_IN_POOL 128
+#define MAX_STORAGE_BUFFERS_IN_POOL 128
+#define MAX_STORAGE_IMAGES_IN_POOL 64
+
+#define MAX_INDIRECT_BATCHES 256
+#define CULL_LOCAL_SIZE 64
+
+#define MAX_RG_PASSES 16
+#define MAX_RG_RESOURCES 32
+#define MAX_RG_PASS_ACCESSES 8
+#define MAX_RG_IMAGE_VARIANTS 8
+
+#define VGK_TIMELINE_PENDING UINT64_MAX // the submission isn't made yet, see vgk_frame_list_resolve_use_value
+
+#define VGK_SCRATCH_ARENA_RESERVE gigabytes(1)
+#define VGK_FRAME_ARENA_RESERVE gigabytes(1)
+
+#define VGK_STAGING_CHUNK_SIZE megabytes(8)
+#define MAX_STAGING_CHUNKS 16
+
+#define MAX_READBACK_SLOTS 8
+
+#define VGK_GLYPH_PADDING 1 // px of empty border around each atlas cell so linear filtering doesn't bleed
+#define VGK_GLYPH_NONE 0xffffffffu
+
+#define MAX_ATLAS_PAGES 2 // ui.frag addresses two samplers
+#define VGK_ATLAS_PADDING 1 // px of edge pixels repeated around each image
+
+#define VGK_MEMORY_LOG_INTERVAL 10.0 // seconds between vgk_maybe_log_memory_stats lines
+
+#define MAX_DAMAGE_RECTS 8
+#define MAX_DAMAGE_IMAGES 8
+#define VGK_DAMAGE_FULL_RATIO 0.5f // damage covering more of the screen than this is redrawn whole
+#define VGK_DAMAGE_MERGE_RATIO 2.0f // rects are redrawn as their bounds unless that grows the redrawn area past this
+
+#define MAX_RECORDING_THREADS 64
+#define MAX_SECONDARY_COMMAND_BUFFERS_PER_SLOT 8
+
+struct Vgk_DeviceCaps
+{
+    bool multi_draw_indirect;
+    bool draw_indirect_count;
+    bool draw_indirect_first_instance;
+    u32 max_draw_indirect_count;
+    u32 max_push_constants_size;
+    bool dynamic_rendering;
+    bool memory_budget; // VK_EXT_memory_budget
+};
+
+enum Vgk_MemoryCategory
+{
+    VGK_MEMORY_DEPTH,
+    VGK_MEMORY_COLOR_ATTACHMENT,
+    VGK_MEMORY_TEXTURE,
+    VGK_MEMORY_VERTEX,
+    VGK_MEMORY_INDEX,
+    VGK_MEMORY_UNIFORM,
+    VGK_MEMORY_STORAGE,
+    VGK_MEMORY_STAGING,
+    VGK_MEMORY_RENDER_GRAPH,
+    VGK_MEMORY_OTHER,
+    VGK_MEMORY_CATEGORY_COUNT
+};
+
+struct Vgk_MemoryCounter
+{
+    VkDeviceSize bytes;
+    VkDeviceSize peak_bytes;
+    u32 allocation_count;
+};
+
+struct Vgk_MemoryHeapStats
+{
+    VkDeviceSize size;
+    VkMemoryHeapFlags flags;
+    Vgk_MemoryCounter allocated; // what vgk allocated from this heap
+    // From VK_EXT_memory_budget, zero without it. Usage includes other processes and driver internals.
+    VkDeviceSize budget;
+    VkDeviceSize usage;
+};
+
+struct Vgk_MemoryStats
+{
+    Vgk_MemoryCounter total;
+    Vgk_MemoryCounter categories[VGK_MEMORY_CATEGORY_COUNT];
+    Vgk_MemoryHeapStats heaps[VK_MAX_MEMORY_HEAPS];
+    u32 heap_count;
+    bool has_budget;
+};
 
 struct Vgk_SwapchainBundle
 {
@@ -23,8 +114,11 @@ struct Vgk_SwapchainBundle
     VkImageView *image_views;
     VkSemaphore *submit_semaphores;
     u32 image_count;
+    bool supports_readback; // images were created with TRANSFER_SRC usage
 };
 
+// One image per frame in flight. Depth is never stored, so the images are transient attachments
+// and live in lazily allocated memory where the device has it (tile-based GPUs).
 struct Vgk_DepthImageBundle
 {
     VkImage *images;
@@ -32,29 +126,295 @@ struct Vgk_DepthImageBundle
     VkImageView *image_views;
     u32 image_count;
     VkFormat depth_format;
+    VkSampleCountFlagBits samples;
+    bool is_lazily_allocated;
+};
+
+// Multisampled color targets, one per frame in flight, resolved into the swapchain image at the end of the pass.
+// Same transient/lazily allocated memory as the depth images.
+struct Vgk_MsaaImageBundle
+{
+    VkImage *images;
+    VkDeviceMemory *memory_list;
+    VkImageView *image_views;
+    u32 image_count;
+    VkFormat color_format;
+    VkSampleCountFlagBits samples;
+    bool is_lazily_allocated;
 };
 
 struct Vgk_RenderPassBundle
 {
     VkRenderPass render_pass;
-    VkFramebuffer *framebuffers;
+    VkFramebuffer *framebuffers;  // [image_index * frame_attachment_count + frame_index], see vgk_get_framebuffer
     u32 framebuffer_count;
+    u32 frame_attachment_count;   // depth/MSAA images per swapchain image, 1 without either
     VkFormat color_format;
     VkFormat depth_format;
+    VkSampleCountFlagBits samples;
+};
+
+struct Vgk_DamageRegion
+{
+    VkRect2D rects[MAX_DAMAGE_RECTS]; // disjoint, clipped to the swapchain extent
+    u32 rect_count;
+    bool is_full;
+};
+
+// Render on demand. A swapchain image still holds what was last drawn into it, so damage is accumulated
+// per image and an acquired image repaints everything that changed since it was last presented.
+// Images start out fully damaged, their contents are undefined until the first full redraw.
+struct Vgk_DamageTracker
+{
+    Vgk_DamageRegion images[MAX_DAMAGE_IMAGES];
+    u32 image_count;
+    VkExtent2D extent;
+    bool has_pending; // damage added since the last vgk_damage_take, the screen is out of date
+};
+
+// Dynamic rendering counterpart of Vgk_RenderPassBundle. Holds no Vulkan objects,
+// so nothing has to be rebuilt on resize and any target with matching formats can be used.
+struct Vgk_RenderingSpec
+{
+    VkFormat color_format;
+    VkFormat depth_format; // VK_FORMAT_UNDEFINED without depth
+    VkSampleCountFlagBits samples;
+    bool with_clear;
+    bool is_final;
+};
+
+struct Vgk_RenderingTarget
+{
+    VkImage color_image;
+    VkImageView color_image_view;
+    VkImage resolve_image; // VK_NULL_HANDLE without MSAA
+    VkImageView resolve_image_view;
+    VkImage depth_image;
+    VkImageView depth_image_view;
+    VkExtent2D extent;
+};
+
+enum Vgk_DeletionType
+{
+    VGK_DELETION_BUFFER,
+    VGK_DELETION_IMAGE,
+    VGK_DELETION_IMAGE_VIEW,
+    VGK_DELETION_SAMPLER,
+    VGK_DELETION_MEMORY,
+    VGK_DELETION_PIPELINE,
+    VGK_DELETION_PIPELINE_LAYOUT,
+    VGK_DELETION_DESCRIPTOR_SET_LAYOUT,
+    VGK_DELETION_DESCRIPTOR_SET,
+    VGK_DELETION_FRAMEBUFFER,
+    VGK_DELETION_RENDER_PASS,
+};
+
+struct Vgk_DescriptorPoolBundle;
+
+struct Vgk_Deletion
+{
+    Vgk_DeletionType type;
+    u64 timeline_value; // use value from vgk_frame_list_get_use_value, resolved when flushing
+    union
+    {
+        VkBuffer buffer;
+        VkImage image;
+        VkImageView image_view;
+        VkSampler sampler;
+        VkDeviceMemory memory;
+        VkPipeline pipeline;
+        VkPipelineLayout pipeline_layout;
+        VkDescriptorSetLayout descriptor_set_layout;
+        VkFramebuffer framebuffer;
+        VkRenderPass render_pass;
+        struct
+        {
+            VkDescriptorSet descriptor_set;
+            Vgk_DescriptorPoolBundle *pool_bundle;
+            u32 uniform_buffer_count;
+            u32 image_sampler_count;
+            u32 storage_buffer_count;
+            u32 storage_image_count;
+        } descriptor;
+    };
 };
 
+list_define_type(Vgk_DeletionQueue, Vgk_Deletion);
+
 struct Vgk_Frame
 {
     VkCommandBuffer command_buffer;
-    VkFence in_flight_fence;
-    bool should_wait_on_fence;
     VkSemaphore acquire_semaphore;
+    u64 timeline_value; // signaled once the frame's last submission completes, 0 if never submitted
+    u64 open_value;     // next timeline value when the frame was begun, 0 if never begun
+    Arena arena;        // transient CPU memory for this frame, reset by vgk_frame_list_begin_frame
 };
 
+// GPU progress is tracked by a single timeline semaphore. Every submission through the frame list
+// signals the next value, so any work can be waited on by its value, on the CPU or on the queue.
+// Submissions are expected to come from one thread.
 struct Vgk_FrameList
 {
     Vgk_Frame *frames;
     u32 count;
+    u32 frame_index;
+    VkSemaphore timeline_semaphore;
+    u64 last_submitted_value;
+    bool is_frame_open; // between vgk_frame_list_begin_frame and vgk_frame_list_submit_frame
+    Vgk_DeletionQueue deletion_queue;
+
+    // Heap allocations made between the last two vgk_frame_list_begin_frame calls
+    u64 frame_heap_alloc_start;
+    u64 last_frame_heap_alloc_count;
+};
+
+// One per recording thread per frame in flight. The pool is reset as a whole,
+// command buffers stay allocated and are handed out again after the reset.
+struct Vgk_RecordSlot
+{
+    VkCommandPool command_pool;
+    VkCommandBuffer command_buffers[MAX_SECONDARY_COMMAND_BUFFERS_PER_SLOT];
+    u32 allocated_count;
+    u32 used_count;
+};
+
+struct Vgk_ParallelRecorder
+{
+    ThreadPool *thread_pool;
+    Vgk_RecordSlot *slots; // [frame_index * thread_count + thread_index]
+    u32 thread_count;      // recording threads, the calling thread included
+    u32 frame_count;
+};
+
+struct Vgk_InheritanceSpec
+{
+    VkRenderPass render_pass;
+    u32 subpass;
+    VkFramebuffer framebuffer;
+
+    // Used instead of the render pass when it is VK_NULL_HANDLE (dynamic rendering)
+    VkFormat color_format;
+    VkFormat depth_format;
+    VkSampleCountFlagBits samples;
+};
+
+// Secondary command buffers don't inherit bound state, the callback binds its own pipeline, sets and buffers
+typedef void (*Vgk_RecordChunkFn)(VkCommandBuffer command_buffer, u32 first, u32 count, void *user_data);
+
+// ====================================================================
+
+enum Vgk_RgAccess
+{
+    VGK_RG_ACCESS_COLOR_WRITE,
+    VGK_RG_ACCESS_DEPTH_WRITE,
+    VGK_RG_ACCESS_FRAGMENT_SAMPLED_READ,
+    VGK_RG_ACCESS_COMPUTE_SAMPLED_READ,
+    VGK_RG_ACCESS_COMPUTE_STORAGE_READ,
+    VGK_RG_ACCESS_COMPUTE_STORAGE_WRITE,
+    VGK_RG_ACCESS_TRANSFER_READ,
+    VGK_RG_ACCESS_TRANSFER_WRITE,
+    VGK_RG_ACCESS_INDIRECT_READ,
+    VGK_RG_ACCESS_VERTEX_READ,
+};
+
+struct Vgk_RgResource
+{
+    const char *name;
+    bool is_image;
+    bool is_imported;
+    bool is_output; // must hold valid contents after the graph, roots pass culling
+
+    VkFormat format;
+    VkExtent2D extent;
+    VkImageAspectFlags aspect;
+    VkImageUsageFlags usage;
+    VkImageLayout initial_layout;
+    VkImageLayout final_layout;
+    VkImage images[MAX_RG_IMAGE_VARIANTS];
+    VkImageView image_views[MAX_RG_IMAGE_VARIANTS];
+    u32 variant_count;
+
+    VkBuffer buffer;
+
+    // Filled in by vgk_rg_compile
+    bool is_used;
+    u32 first_pass;
+    u32 last_pass;
+    VkMemoryRequirements memory_requirements;
+    u32 memory_block;
+};
+
+struct Vgk_RgPassAccess
+{
+    u32 resource;
+    Vgk_RgAccess access;
+    bool clear;
+    VkClearValue clear_value;
+};
+
+struct Vgk_RgBarrier
+{
+    u32 resource;
+    VkImageLayout old_layout;
+    VkImageLayout new_layout;
+    VkAccessFlags src_access;
+    VkAccessFlags dst_access;
+};
+
+typedef void (*Vgk_RgExecuteFn)(VkCommandBuffer command_buffer, void *user_data);
+
+struct Vgk_RgPass
+{
+    const char *name;
+    Vgk_RgExecuteFn fn;
+    void *user_data;
+    Vgk_RgPassAccess accesses[MAX_RG_PASS_ACCESSES];
+    u32 access_count;
+
+    // Filled in by vgk_rg_compile
+    bool is_alive;
+    bool is_raster;
+    Vgk_RgBarrier barriers[MAX_RG_PASS_ACCESSES];
+    u32 barrier_count;
+    VkPipelineStageFlags src_stage;
+    VkPipelineStageFlags dst_stage;
+    VkRenderPass render_pass;
+    VkFramebuffer framebuffers[MAX_RG_IMAGE_VARIANTS];
+    u32 framebuffer_count;
+    VkExtent2D extent;
+    VkClearValue clear_values[MAX_RG_PASS_ACCESSES];
+    u32 clear_value_count;
+};
+
+struct Vgk_RenderGraph
+{
+    Vgk_RgResource resources[MAX_RG_RESOURCES];
+    u32 resource_count;
+    Vgk_RgPass passes[MAX_RG_PASSES];
+    u32 pass_count;
+
+    // Filled in by vgk_rg_compile
+    VkDeviceMemory memory_blocks[MAX_RG_RESOURCES];
+    u32 memory_block_count;
+    Vgk_RgBarrier final_barriers[MAX_RG_RESOURCES];
+    u32 final_barrier_count;
+    VkPipelineStageFlags final_src_stage;
+    VkPipelineStageFlags final_dst_stage;
+
+    u32 alive_pass_count;
+    u32 barrier_batch_count;
+    VkDeviceSize transient_memory_size;
+    VkDeviceSize transient_memory_size_unaliased;
+    bool is_compiled;
+};
+
+// How the CPU touches a buffer, picks the memory type in vgk_create_buffer_bundle
+enum Vgk_MemoryAccess
+{
+    VGK_MEMORY_ACCESS_SEQUENTIAL_WRITE, // CPU fills, GPU reads. Always coherent, prefers uncached (write-combined).
+    VGK_MEMORY_ACCESS_RANDOM,           // CPU reads and writes. Prefers cached; flush after writes, invalidate before reads.
+    VGK_MEMORY_ACCESS_READBACK,         // GPU writes, CPU reads. Prefers cached host memory; invalidate before reads.
+    VGK_MEMORY_ACCESS_GPU_ONLY,         // Not mapped, data_ptr is NULL. Device local, written by transfers and shaders.
 };
 
 struct Vgk_BufferBundle
@@ -63,6 +423,12 @@ struct Vgk_BufferBundle
     VkDeviceMemory memory;
     void *data_ptr;
     VkDeviceSize size;
+
+    // Needed for vgk_flush_buffer_bundle / vgk_invalidate_buffer_bundle on non-coherent memory
+    VkDeviceSize allocation_size;
+    VkDeviceSize atom_size;
+    bool is_coherent;
+    bool is_cached;
 };
 
 struct Vgk_BufferBundleList
@@ -78,6 +444,151 @@ struct Vgk_TextureBundle
     VkImageView image_view;
     VkSampler sampler;
     VkFormat format;
+    VkExtent2D extent;
+    VkImageLayout layout; // as of the last recorded upload
+};
+
+struct Vgk_StagingChunk
+{
+    Vgk_BufferBundle buffer;
+    VkDeviceSize offset;
+    u64 retire_value; // use value of the last allocation, see vgk_frame_list_resolve_use_value
+};
+
+// Persistently mapped upload chunks, filled linearly and recycled once the frame list's timeline
+// passes their resolved retire value. Requests larger than a chunk get a dedicated buffer destroyed deferred.
+struct Vgk_StagingPool
+{
+    Vgk_StagingChunk chunks[MAX_STAGING_CHUNKS];
+    u32 chunk_count;
+    u32 current_chunk;
+    u32 dedicated_count;
+    u32 stall_count; // times every chunk was in flight and the pool had to wait
+};
+
+struct Vgk_StagingAllocation
+{
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    void *data_ptr;
+};
+
+// Pixels are tightly packed rows of width texels in format, valid only during the call
+typedef void (*Vgk_ReadbackFn)(const void *pixels, u32 width, u32 height, VkFormat format, void *user_data);
+
+struct Vgk_ReadbackSlot
+{
+    Vgk_BufferBundle buffer; // host-cached, grown on demand
+    u64 ready_value;         // use value of the copy, see vgk_frame_list_resolve_use_value
+    VkExtent2D extent;
+    VkFormat format;
+    Vgk_ReadbackFn callback;
+    void *user_data;
+    bool is_pending;
+};
+
+// Image-to-buffer copies recorded into the frame, handed to their callback by vgk_readback_ring_poll
+// once the frame list's timeline passes their value. Slots are used in ring order; when the next slot
+// is still pending the request is dropped rather than waited on.
+struct Vgk_ReadbackRing
+{
+    Vgk_ReadbackSlot slots[MAX_READBACK_SLOTS];
+    u32 slot_count;
+    u32 next_slot;
+    u32 dropped_count;
+};
+
+struct stbtt_fontinfo;
+
+// Vertex layout of the UI pipeline (ui.vert)
+struct Vgk_UiVertex
+{
+    v3 pos;
+    v2 uv;
+    v4 color;
+    u32 tex_index; // sampler array element, optionally with VGK_UI_TINT_TEXTURE_BIT
+};
+
+// ui.frag outputs the vertex color with the texel's alpha by default (glyph coverage). With this bit set
+// in tex_index it outputs the texel multiplied by the vertex color instead (atlas images).
+#define VGK_UI_TINT_TEXTURE_BIT 0x80000000u
+
+// Unindexed quads (6 vertices each) written straight into the frame's mapped vertex buffer, drawn with one vkCmdDraw
+struct Vgk_UiBatch
+{
+    Vgk_BufferBundleList vertex_buffers;
+    u32 frame_index;
+    u32 vertex_count;
+    u32 max_vertex_count;
+};
+
+struct Vgk_Glyph
+{
+    u32 codepoint;       // VGK_GLYPH_NONE for a free cell
+    i32 offset_x;        // bitmap top-left relative to the pen on the baseline, px
+    i32 offset_y;
+    u32 width;
+    u32 height;
+    f32 advance;
+    u64 last_used_frame;
+    u32 lru_prev;        // VGK_GLYPH_NONE at the ends
+    u32 lru_next;
+};
+
+// Glyphs rasterized on demand with stb_truetype into fixed-size cells of an R8 atlas. A CPU copy of the
+// atlas takes the rasterized pixels and the dirty rect is uploaded once per frame by vgk_cmd_upload_glyph_atlas.
+// When every cell is taken the least recently used glyph is evicted; glyphs used in the current frame never are.
+struct Vgk_GlyphCache
+{
+    stbtt_fontinfo *font_info;
+    u8 *font_data;
+    f32 scale;
+    f32 ascent;    // px above the baseline
+    f32 descent;   // px below the baseline, negative
+    f32 line_gap;
+
+    Vgk_Glyph *cells;
+    u32 cell_size;
+    u32 cells_per_row;
+    u32 cell_count;
+    u32 used_cell_count;
+    u32 lru_head;  // most recently used
+    u32 lru_tail;
+
+    // codepoint -> cell, open addressing
+    u32 *map_keys;
+    u32 *map_cells;
+    u32 map_capacity;
+
+    Vgk_TextureBundle atlas;
+    u8 *atlas_pixels;
+    u32 atlas_size;
+    u32 dirty_x0, dirty_y0, dirty_x1, dirty_y1; // empty when x0 >= x1
+
+    u64 frame;
+    u32 raster_count;
+    u32 evict_count;
+    u32 drop_count; // glyphs skipped because every cell was used this frame
+};
+
+struct Vgk_AtlasRect
+{
+    u32 page;
+    u32 x, y, width, height; // px inside the page, without padding
+    f32 u0, v0, u1, v1;
+};
+
+// Images packed into a few large textures (pages) with a skyline packer, so icons and sprites
+// share samplers and batch together. Pages are added as the previous ones fill up. Single images
+// can't be removed; reset the atlas and add the ones still needed.
+struct Vgk_TextureAtlas
+{
+    Vgk_TextureBundle pages[MAX_ATLAS_PAGES];
+    SkylinePacker packers[MAX_ATLAS_PAGES];
+    u32 page_count;
+    u32 max_page_count;
+    u32 page_size;
+    VkFormat format;
 };
 
 struct Vgk_DescriptorPoolBundle
@@ -92,6 +603,12 @@ struct Vgk_DescriptorPoolBundle
 
     u32 image_sampler_count;
     u32 max_image_samplers;
+
+    u32 storage_buffer_count;
+    u32 max_storage_buffers;
+
+    u32 storage_image_count;
+    u32 max_storage_images;
 };
 
 struct Vgk_DescriptorBinding
@@ -130,17 +647,19 @@ struct Vgk_VertInputSpec
 
 struct Vgk_PipelineLayoutSpec
 {
-    // TODO: Push constants
     Vgk_DescriptorSetSpec descriptor_sets[MAX_DESCRIPTOR_SETS];
     u32 descriptor_set_count;
+
+    VkPushConstantRange push_constant_ranges[MAX_PUSH_CONSTANT_RANGES];
+    u32 push_constant_range_count;
 };
 
 // ====================================================================
 
 struct Vgk_PipelineSpec
 {
-    const char *vert_shader_path;
-    const char *frag_shader_path;
+    char vert_shader_path[MAX_SHADER_PATH_LENGTH];
+    char frag_shader_path[MAX_SHADER_PATH_LENGTH];
 
     u32 frame_count;
 
@@ -152,6 +671,8 @@ struct Vgk_PipelineSpec
 
     VkViewport viewport;
     VkRect2D scissor;
+    bool dynamic_viewport; // viewport set with vkCmdSetViewport, the static one is ignored
+    bool dynamic_scissor; // scissor set with vkCmdSetScissor, the static one is ignored
 
     VkPolygonMode polygon_mode;
     f32 line_width;
@@ -164,16 +685,185 @@ struct Vgk_PipelineSpec
     bool enable_depth_testing;
 
     VkRenderPass render_pass;
+
+    // Used instead of the render pass when it is VK_NULL_HANDLE (dynamic rendering)
+    VkFormat color_format;
+    VkFormat depth_format;
 };
 
+// Hot data only; the spec is kept in Vgk_PipelineTable::specs, see vgk_get_pipeline_spec
 struct Vgk_PipelineBundle
 {
-    Vgk_PipelineSpec spec;
     // VkDescriptorSetLayout descriptor_set_layout;
     VkPipelineLayout layout;
     VkPipeline pipeline;
 };
 
+struct Vgk_ComputePipelineSpec
+{
+    char comp_shader_path[MAX_SHADER_PATH_LENGTH];
+
+    Vgk_PipelineLayoutSpec pipeline_layout_spec;
+};
+
+// Hot data only, like Vgk_PipelineBundle; the caller keeps the spec if it needs to rebuild
+struct Vgk_ComputePipelineBundle
+{
+    VkPipelineLayout layout;
+    VkPipeline pipeline;
+};
+
+typedef Handle Vgk_PipelineHandle;
+
+// Pipelines addressed by generational handles. Binding only touches the dense hot arrays,
+// the specs (several KB each) sit in their own array and are read only when rebuilding.
+struct Vgk_PipelineTable
+{
+    SlotMap slots;
+
+    VkPipeline *pipelines;
+    VkPipelineLayout *layouts;
+
+    // Set while a background compile is in flight; lookups answer with the fallback entry
+    bool *pending;
+    Vgk_PipelineHandle *fallbacks;
+
+    // Cold, read when comparing or rebuilding specs, never per draw
+    Vgk_PipelineSpec *specs;
+};
+
+struct Vgk_ShaderHash
+{
+    char path[MAX_SHADER_PATH_LENGTH]; // empty marks a free slot
+    u64 path_hash;
+    i64 size;     // with mtime_ns, the file state the hash was taken from
+    i64 mtime_ns;
+    u64 hash; // of the file contents
+};
+
+// Get-or-create on top of a pipeline table. Specs are keyed by a canonical per-field hash
+// that uses shader contents in place of paths, so equal pipelines are created once. Hits are
+// checked against the spec kept in the table, colliding specs get their own entries.
+// The hash -> handle map is open addressing with linear probing, key 0 marks an empty slot.
+// Remove registry pipelines with vgk_registry_remove_pipeline, which backward-shifts the run.
+struct Vgk_PipelineRegistry
+{
+    Vgk_PipelineTable table;
+
+    u64 *keys;
+    Vgk_PipelineHandle *values;
+    u32 map_capacity; // power of two
+
+    // Shader files are hashed once per path and version; open addressing by path hash, 2 * MAX_CACHED_SHADER_HASHES slots
+    Vgk_ShaderHash *shader_hashes;
+    u32 shader_hash_count;
+
+    u32 hit_count;
+    u32 miss_count;
+};
+
+// Runs on the main thread from vgk_pipeline_compiler_poll once the pipeline is installed
+typedef void (*Vgk_PipelineReadyFn)(Vgk_PipelineHandle handle, void *user_data);
+
+struct Vgk_PipelineCompileJob
+{
+    Vgk_PipelineHandle handle;
+    Vgk_PipelineSpec spec;
+    Vgk_PipelineReadyFn on_ready;
+    void *user_data;
+};
+
+struct Vgk_PipelineCompileResult
+{
+    Vgk_PipelineHandle handle;
+    Vgk_PipelineBundle bundle;
+    Vgk_PipelineReadyFn on_ready;
+    void *user_data;
+};
+
+list_define_type(Vgk_PipelineCompileJobList, Vgk_PipelineCompileJob);
+list_define_type(Vgk_PipelineCompileResultList, Vgk_PipelineCompileResult);
+
+// One background thread that builds pipelines from queued specs. Results are handed back
+// through vgk_pipeline_compiler_poll, so pipeline tables are only ever touched by the main thread.
+struct Vgk_PipelineCompiler
+{
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    bool shutting_down;
+
+    VkDevice device;
+
+    Vgk_PipelineCompileJobList queue;
+    size_t queue_head;
+    Vgk_PipelineCompileResultList completed;
+    Vgk_PipelineCompileResultList installing; // swapped with completed on poll
+
+    u32 in_flight_count;
+};
+
+// ====================================================================
+
+// Commands of one batch are contiguous in the command buffer and share a pipeline,
+// so the whole batch goes out with a single indirect draw.
+struct Vgk_IndirectBatch
+{
+    VkPipeline pipeline;
+    u32 first_command;
+    u32 command_count; // for GPU batches: reserved capacity
+    bool gpu_count;    // commands and count are written on the GPU, e.g. by the cull pass
+};
+
+struct Vgk_IndirectDrawList
+{
+    // Device local, the cull pass fills and counts GPU batches in place
+    Vgk_BufferBundleList command_buffers; // VkDrawIndexedIndirectCommand[max_command_count] per frame
+    Vgk_BufferBundleList count_buffers;   // u32[MAX_INDIRECT_BATCHES] per frame, for the count variant
+    // Host visible, CPU batches are written here and copied over by vgk_cmd_upload_indirect_list.
+    // Commands at the same offsets as in command_buffers, followed by the counts.
+    Vgk_BufferBundleList upload_buffers;
+
+    Vgk_IndirectBatch batches[MAX_INDIRECT_BATCHES];
+    u32 batch_count;
+    u32 command_count;
+    u32 max_command_count;
+    u32 frame_index;
+
+    bool use_multi_draw;
+    bool use_draw_count;
+    bool allow_first_instance; // drawIndirectFirstInstance, otherwise firstInstance must be 0
+    u32 max_draw_indirect_count;
+};
+
+// Matches the std430 layout of CullObject in cull.comp
+struct Vgk_CullObject
+{
+    v4 bounding_sphere; // xyz center, w radius
+    VkDrawIndexedIndirectCommand draw;
+    u32 pad[3];
+};
+
+// Matches the push constant block in cull.comp
+struct Vgk_CullPushConstants
+{
+    v4 planes[6];
+    u32 object_count;
+    u32 first_command;
+    u32 count_index;
+    u32 max_command_count;
+};
+
+struct Vgk_CullPass
+{
+    Vgk_ComputePipelineBundle pipeline_bundle;
+    Vgk_DescriptorSetBundle *descriptor_sets; // one per frame in flight
+    Vgk_BufferBundleList object_buffers;      // Vgk_CullObject[max_object_count] per frame
+    u32 *object_counts;
+    u32 max_object_count;
+    u32 frame_count;
+};
+
 // ============================ CREATE ===============================
 
 VkInstance vgk_create_instance();
@@ -182,14 +872,29 @@ VkPhysicalDevice vgk_find_physical_device(VkInstance instance);
 VkDevice vgk_create_device(u32 queue_family_index, VkPhysicalDevice physical_device);
 VkQueue vgk_get_queue(VkDevice device, u32 queue_family_index);
 Vgk_SwapchainBundle vgk_create_swapchain_bundle(VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkDevice device);
-Vgk_DepthImageBundle vgk_create_depth_image_bundle(VkFormat depth_format, u32 image_count, VkExtent2D swapchain_extent, VkDevice device, VkPhysicalDevice physical_device);
-Vgk_RenderPassBundle vgk_create_render_pass_bundle(const Vgk_SwapchainBundle *swapchain_bundle, const Vgk_DepthImageBundle *depth_image_bundle, bool with_clear, bool is_final, VkDevice device);
+Vgk_DepthImageBundle vgk_create_depth_image_bundle(VkFormat depth_format, VkSampleCountFlagBits samples, u32 frames_in_flight, VkExtent2D swapchain_extent, VkDevice device, VkPhysicalDevice physical_device);
+Vgk_MsaaImageBundle vgk_create_msaa_image_bundle(VkFormat color_format, VkSampleCountFlagBits samples, u32 frames_in_flight, VkExtent2D swapchain_extent, VkDevice device, VkPhysicalDevice physical_device);
+Vgk_RenderPassBundle vgk_create_render_pass_bundle(const Vgk_SwapchainBundle *swapchain_bundle, const Vgk_DepthImageBundle *depth_image_bundle, const Vgk_MsaaImageBundle *msaa_image_bundle, bool with_clear, bool is_final, VkDevice device);
+Vgk_RenderPassBundle vgk_create_damage_render_pass_bundle(const Vgk_SwapchainBundle *swapchain_bundle, const Vgk_DepthImageBundle *depth_image_bundle, const Vgk_MsaaImageBundle *msaa_image_bundle, VkDevice device);
+void vgk_recreate_framebuffers(Vgk_RenderPassBundle *bundle, const Vgk_SwapchainBundle *swapchain_bundle, const Vgk_DepthImageBundle *depth_image_bundle, const Vgk_MsaaImageBundle *msaa_image_bundle, VkDevice device);
+Vgk_RenderingSpec vgk_make_rendering_spec(const Vgk_SwapchainBundle *swapchain_bundle, const Vgk_DepthImageBundle *depth_image_bundle, const Vgk_MsaaImageBundle *msaa_image_bundle, bool with_clear, bool is_final);
+Vgk_RenderingTarget vgk_get_swapchain_rendering_target(const Vgk_SwapchainBundle *swapchain_bundle, const Vgk_DepthImageBundle *depth_image_bundle, const Vgk_MsaaImageBundle *msaa_image_bundle, u32 image_index, u32 frame_index);
 VkCommandPool vgk_create_command_pool(u32 queue_family_index, VkDevice device);
 Vgk_FrameList vgk_create_frame_list(u32 frames_in_flight, VkCommandPool command_pool, VkDevice device);
+Vgk_ParallelRecorder vgk_create_parallel_recorder(u32 thread_count, u32 frames_in_flight, u32 queue_family_index, VkDevice device);
 void vgk_frame_list_reset_sync_objects(Vgk_FrameList *frame_list, VkDevice device);
+Vgk_Frame *vgk_frame_list_begin_frame(Vgk_FrameList *frame_list, VkDevice device);
+u64 vgk_frame_list_submit_frame(Vgk_FrameList *frame_list, Vgk_Frame *frame, VkSemaphore present_semaphore, VkQueue queue);
+u64 vgk_frame_list_submit(Vgk_FrameList *frame_list, VkCommandBuffer command_buffer, u64 wait_value, VkPipelineStageFlags wait_stage, VkQueue queue);
+u64 vgk_frame_list_get_completed_value(const Vgk_FrameList *frame_list, VkDevice device);
+void vgk_frame_list_wait_value(const Vgk_FrameList *frame_list, u64 value, VkDevice device);
+u64 vgk_frame_list_get_use_value(const Vgk_FrameList *frame_list);
+u64 vgk_frame_list_resolve_use_value(const Vgk_FrameList *frame_list, u64 use_value);
 VkShaderModule vgk_create_shader_module(const char *path, VkDevice device);
-Vgk_BufferBundle vgk_create_buffer_bundle(VkDeviceSize size, VkBufferUsageFlags usage, VkDevice device, VkPhysicalDevice physical_device);
-Vgk_BufferBundleList vgk_create_buffer_bundle_list(VkDeviceSize max_size, VkBufferUsageFlags usage, u32 frames_in_flight, VkDevice device, VkPhysicalDevice physical_device);
+Vgk_BufferBundle vgk_create_buffer_bundle(VkDeviceSize size, VkBufferUsageFlags usage, Vgk_MemoryAccess access, VkDevice device, VkPhysicalDevice physical_device);
+Vgk_BufferBundleList vgk_create_buffer_bundle_list(VkDeviceSize max_size, VkBufferUsageFlags usage, Vgk_MemoryAccess access, u32 frames_in_flight, VkDevice device, VkPhysicalDevice physical_device);
+Vgk_IndirectDrawList vgk_create_indirect_draw_list(u32 max_command_count, u32 frames_in_flight, VkDevice device, VkPhysicalDevice physical_device);
+Vgk_CullPass vgk_create_cull_pass(const char *comp_shader_path, u32 max_object_count, const Vgk_IndirectDrawList *draw_list, Vgk_DescriptorPoolBundle *descriptor_pool_bundle, VkDevice device, VkPhysicalDevice physical_device);
 
 Vgk_DescriptorPoolBundle vgk_create_descriptor_pool_bundle(VkDevice device);
 Vgk_DescriptorSetBundle vgk_create_descriptor_set_bundle_from_spec(Vgk_DescriptorPoolBundle *descriptor_pool_bundle, const Vgk_DescriptorSetSpec *description, VkDevice device);
@@ -207,35 +912,207 @@ void vgk_set_vert_shader_path(Vgk_PipelineSpec *spec, const char *path);
 void vgk_set_frag_shader_path(Vgk_PipelineSpec *spec, const char *path);
 void vgk_set_frame_count(Vgk_PipelineSpec *spec, u32 frame_count);
 void vgk_add_descriptor_set(Vgk_PipelineSpec *spec, const Vgk_DescriptorSetSpec *descriptor_set_spec);
-// void vgk_add_push_constant(Vgk_PipelineSpec *spec);
+void vgk_add_push_constant(Vgk_PipelineSpec *spec, VkShaderStageFlags stage_flags, u32 size);
 void vgk_set_vert_input(Vgk_PipelineSpec *spec, const Vgk_VertInputSpec *vert_input);
 void vgk_set_viewport(Vgk_PipelineSpec *spec, VkViewport viewport);
 void vgk_set_scissor(Vgk_PipelineSpec *spec, VkRect2D scissor);
+void vgk_set_dynamic_viewport(Vgk_PipelineSpec *spec, bool enable);
+void vgk_set_dynamic_scissor(Vgk_PipelineSpec *spec, bool enable);
 void vgk_set_rasterization_state(Vgk_PipelineSpec *spec, VkPolygonMode polygon_mode, f32 line_width, VkCullModeFlags cull_mode, VkFrontFace front_face);
 void vgk_set_sample_count(Vgk_PipelineSpec *spec, VkSampleCountFlagBits sample_count);
 void vgk_set_enable_blending(Vgk_PipelineSpec *spec, bool enable);
 void vgk_set_enable_depth_testing(Vgk_PipelineSpec *spec, bool enable);
 void vgk_set_render_pass(Vgk_PipelineSpec *spec, VkRenderPass render_pass);
+void vgk_set_rendering_spec(Vgk_PipelineSpec *spec, const Vgk_RenderingSpec *rendering_spec);
 
 Vgk_PipelineBundle vgk_create_pipeline_from_spec(const Vgk_PipelineSpec *description, VkDevice device);
 
+Vgk_ComputePipelineSpec vgk_make_compute_pipeline_spec();
+void vgk_set_comp_shader_path(Vgk_ComputePipelineSpec *spec, const char *path);
+void vgk_add_compute_descriptor_set(Vgk_ComputePipelineSpec *spec, const Vgk_DescriptorSetSpec *descriptor_set_spec);
+void vgk_add_compute_push_constant(Vgk_ComputePipelineSpec *spec, u32 size);
+
+Vgk_ComputePipelineBundle vgk_create_compute_pipeline_from_spec(const Vgk_ComputePipelineSpec *spec, VkDevice device);
+
+void vgk_update_buffer_descriptor(const Vgk_DescriptorSetBundle *descriptor_set_bundle, u32 binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range, VkDevice device);
+void vgk_update_image_descriptor(const Vgk_DescriptorSetBundle *descriptor_set_bundle, u32 binding, u32 array_index, VkImageView image_view, VkSampler sampler, VkImageLayout layout, VkDevice device);
+
+// ============================ PIPELINE TABLE ===============================
+
+Vgk_PipelineTable vgk_create_pipeline_table(u32 capacity);
+Vgk_PipelineHandle vgk_pipeline_table_add(Vgk_PipelineTable *table, const Vgk_PipelineSpec *spec, VkDevice device);
+void vgk_pipeline_table_remove(Vgk_PipelineTable *table, Vgk_PipelineHandle handle, Vgk_FrameList *frame_list);
+VkPipeline vgk_get_pipeline(const Vgk_PipelineTable *table, Vgk_PipelineHandle handle);
+VkPipelineLayout vgk_get_pipeline_layout(const Vgk_PipelineTable *table, Vgk_PipelineHandle handle);
+const Vgk_PipelineSpec *vgk_get_pipeline_spec(const Vgk_PipelineTable *table, Vgk_PipelineHandle handle);
+
+Vgk_PipelineRegistry vgk_create_pipeline_registry(u32 capacity);
+u64 vgk_hash_pipeline_spec(Vgk_PipelineRegistry *registry, const Vgk_PipelineSpec *spec);
+Vgk_PipelineHandle vgk_registry_get_pipeline(Vgk_PipelineRegistry *registry, const Vgk_PipelineSpec *spec, VkDevice device);
+Vgk_PipelineHandle vgk_registry_find_pipeline(const Vgk_PipelineRegistry *registry, u64 spec_hash);
+void vgk_registry_remove_pipeline(Vgk_PipelineRegistry *registry, Vgk_PipelineHandle handle, Vgk_FrameList *frame_list);
+
+Vgk_PipelineCompiler *vgk_create_pipeline_compiler(VkDevice device);
+Vgk_PipelineHandle vgk_pipeline_table_add_async(Vgk_PipelineTable *table, Vgk_PipelineCompiler *compiler, const Vgk_PipelineSpec *spec, Vgk_PipelineHandle fallback, Vgk_PipelineReadyFn on_ready, void *user_data);
+Vgk_PipelineHandle vgk_registry_get_pipeline_async(Vgk_PipelineRegistry *registry, Vgk_PipelineCompiler *compiler, const Vgk_PipelineSpec *spec, Vgk_PipelineHandle fallback);
+u32 vgk_pipeline_compiler_poll(Vgk_PipelineCompiler *compiler, Vgk_PipelineTable *table, Vgk_FrameList *frame_list);
+bool vgk_is_pipeline_ready(const Vgk_PipelineTable *table, Vgk_PipelineHandle handle);
+
+// ============================ STAGING ===============================
+
+Vgk_StagingPool vgk_create_staging_pool(u32 initial_chunk_count, VkDevice device, VkPhysicalDevice physical_device);
+Vgk_StagingAllocation vgk_staging_alloc(Vgk_StagingPool *pool, Vgk_FrameList *frame_list, VkDeviceSize size, VkDeviceSize alignment, VkDevice device, VkPhysicalDevice physical_device);
+Vgk_TextureBundle vgk_create_texture_bundle(u32 width, u32 height, VkFormat format, VkDevice device, VkPhysicalDevice physical_device);
+void vgk_cmd_upload_texture_region(VkCommandBuffer command_buffer, Vgk_TextureBundle *texture, Vgk_StagingPool *pool, Vgk_FrameList *frame_list, const void *pixels, u32 x, u32 y, u32 width, u32 height, VkDevice device, VkPhysicalDevice physical_device);
+Vgk_TextureBundle vgk_load_texture_from_pixels(const void *pixels, u32 width, u32 height, VkFormat format, Vgk_StagingPool *pool, Vgk_FrameList *frame_list, VkDevice device, VkPhysicalDevice physical_device, VkCommandPool command_pool, VkQueue queue);
+
+// ============================ READBACK ===============================
+
+Vgk_ReadbackRing vgk_create_readback_ring(u32 slot_count);
+bool vgk_cmd_readback_image(VkCommandBuffer command_buffer, Vgk_ReadbackRing *ring, Vgk_FrameList *frame_list, VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout, VkPipelineStageFlags src_stage, VkAccessFlags src_access, Vgk_ReadbackFn callback, void *user_data, VkDevice device, VkPhysicalDevice physical_device);
+bool vgk_cmd_readback_swapchain_image(VkCommandBuffer command_buffer, Vgk_ReadbackRing *ring, Vgk_FrameList *frame_list, const Vgk_SwapchainBundle *swapchain_bundle, u32 image_index, Vgk_ReadbackFn callback, void *user_data, VkDevice device, VkPhysicalDevice physical_device);
+u32 vgk_readback_ring_poll(Vgk_ReadbackRing *ring, Vgk_FrameList *frame_list, VkDevice device);
+
+// ============================ TEXT ===============================
+
+Vgk_UiBatch vgk_create_ui_batch(u32 max_quad_count, u32 frames_in_flight, VkDevice device, VkPhysicalDevice physical_device);
+void vgk_ui_batch_begin(Vgk_UiBatch *batch, u32 frame_index);
+void vgk_ui_batch_add_quad(Vgk_UiBatch *batch, f32 x0, f32 y0, f32 x1, f32 y1, f32 u0, f32 v0, f32 u1, f32 v1, v4 color, u32 tex_index);
+void vgk_cmd_draw_ui_batch(VkCommandBuffer command_buffer, const Vgk_UiBatch *batch);
+Vgk_VertInputSpec vgk_make_ui_vert_input_spec();
+
+Vgk_GlyphCache vgk_create_glyph_cache(const char *font_path, f32 pixel_height, u32 atlas_size, VkDevice device, VkPhysicalDevice physical_device);
+void vgk_glyph_cache_begin_frame(Vgk_GlyphCache *cache);
+const Vgk_Glyph *vgk_glyph_cache_get(Vgk_GlyphCache *cache, u32 codepoint);
+void vgk_cmd_upload_glyph_atlas(VkCommandBuffer command_buffer, Vgk_GlyphCache *cache, Vgk_StagingPool *pool, Vgk_FrameList *frame_list, VkDevice device, VkPhysicalDevice physical_device);
+f32 vgk_ui_batch_add_text(Vgk_UiBatch *batch, Vgk_GlyphCache *cache, const char *text, f32 x, f32 baseline_y, v4 color, u32 tex_index);
+f32 vgk_measure_text(Vgk_GlyphCache *cache, const char *text);
+
+// ============================ TEXTURE ATLAS ===============================
+
+Vgk_TextureAtlas vgk_create_texture_atlas(u32 page_size, u32 max_page_count, VkFormat format);
+bool vgk_cmd_texture_atlas_add(VkCommandBuffer command_buffer, Vgk_TextureAtlas *atlas, Vgk_StagingPool *pool, Vgk_FrameList *frame_list, const void *pixels, u32 width, u32 height, Vgk_AtlasRect *out_rect, bool *out_new_page, VkDevice device, VkPhysicalDevice physical_device);
+void vgk_cmd_texture_atlas_reset(VkCommandBuffer command_buffer, Vgk_TextureAtlas *atlas);
+void vgk_ui_batch_add_image(Vgk_UiBatch *batch, const Vgk_AtlasRect *rect, f32 x, f32 y, f32 width, f32 height, v4 color, u32 first_tex_index);
+
+// ============================ DRAW LISTS ===============================
+
+void vgk_indirect_draw_list_begin(Vgk_IndirectDrawList *list, u32 frame_index);
+void vgk_indirect_draw_list_set_pipeline(Vgk_IndirectDrawList *list, VkPipeline pipeline);
+void vgk_indirect_draw_list_add(Vgk_IndirectDrawList *list, u32 index_count, u32 instance_count, u32 first_index, i32 vertex_offset, u32 first_instance);
+u32 vgk_indirect_draw_list_add_gpu_batch(Vgk_IndirectDrawList *list, VkPipeline pipeline, u32 max_command_count);
+void vgk_indirect_draw_list_end(Vgk_IndirectDrawList *list);
+void vgk_cmd_upload_indirect_list(VkCommandBuffer command_buffer, const Vgk_IndirectDrawList *list);
+void vgk_cmd_draw_indirect_list(VkCommandBuffer command_buffer, const Vgk_IndirectDrawList *list);
+
+// ============================ RENDER GRAPH ===============================
+
+Vgk_RenderGraph vgk_make_render_graph();
+u32 vgk_rg_import_image(Vgk_RenderGraph *graph, const char *name, const VkImage *images, const VkImageView *image_views, u32 variant_count, VkFormat format, VkExtent2D extent, VkImageLayout initial_layout, VkImageLayout final_layout);
+u32 vgk_rg_import_swapchain(Vgk_RenderGraph *graph, const Vgk_SwapchainBundle *swapchain_bundle);
+u32 vgk_rg_import_buffer(Vgk_RenderGraph *graph, const char *name, VkBuffer buffer, bool is_output);
+u32 vgk_rg_create_image(Vgk_RenderGraph *graph, const char *name, VkFormat format, VkExtent2D extent);
+u32 vgk_rg_add_pass(Vgk_RenderGraph *graph, const char *name, Vgk_RgExecuteFn fn, void *user_data);
+void vgk_rg_write_color(Vgk_RenderGraph *graph, u32 pass, u32 image, bool clear, VkClearColorValue clear_color);
+void vgk_rg_write_depth(Vgk_RenderGraph *graph, u32 pass, u32 image, bool clear, f32 clear_depth);
+void vgk_rg_use(Vgk_RenderGraph *graph, u32 pass, u32 resource, Vgk_RgAccess access);
+void vgk_rg_compile(Vgk_RenderGraph *graph, VkDevice device, VkPhysicalDevice physical_device);
+VkRenderPass vgk_rg_get_render_pass(const Vgk_RenderGraph *graph, u32 pass);
+void vgk_cmd_execute_render_graph(VkCommandBuffer command_buffer, const Vgk_RenderGraph *graph, u32 variant_index);
+
+// ============================ RECORDING ===============================
+
+void vgk_cmd_begin_rendering(VkCommandBuffer command_buffer, const Vgk_RenderingSpec *spec, const Vgk_RenderingTarget *target, VkClearColorValue clear_color, bool with_secondary_command_buffers);
+void vgk_cmd_end_rendering(VkCommandBuffer command_buffer, const Vgk_RenderingSpec *spec, const Vgk_RenderingTarget *target);
+
+void vgk_parallel_recorder_begin_frame(Vgk_ParallelRecorder *recorder, u32 frame_index, VkDevice device);
+void vgk_cmd_record_parallel(VkCommandBuffer primary_command_buffer, Vgk_ParallelRecorder *recorder, u32 frame_index, const Vgk_InheritanceSpec *inheritance, u32 item_count, Vgk_RecordChunkFn fn, void *user_data, VkDevice device);
+
+// ============================ DAMAGE ===============================
+
+Vgk_DamageTracker vgk_create_damage_tracker(const Vgk_SwapchainBundle *swapchain_bundle);
+void vgk_damage_add_rect(Vgk_DamageTracker *tracker, VkRect2D rect);
+void vgk_damage_add_full(Vgk_DamageTracker *tracker);
+bool vgk_damage_has_pending(const Vgk_DamageTracker *tracker);
+Vgk_DamageRegion vgk_damage_take(Vgk_DamageTracker *tracker, u32 image_index);
+VkRect2D vgk_damage_get_bounds(const Vgk_DamageRegion *region);
+void vgk_cmd_begin_damage_render_pass(VkCommandBuffer command_buffer, const Vgk_RenderPassBundle *full_pass, const Vgk_RenderPassBundle *damage_pass, Vgk_DamageRegion *region, u32 image_index, u32 frame_index, VkExtent2D extent, VkClearColorValue clear_color);
+
+// ============================ COMPUTE ===============================
+
+void vgk_cmd_bind_compute_pipeline(VkCommandBuffer command_buffer, const Vgk_ComputePipelineBundle *bundle, const Vgk_DescriptorSetBundle *descriptor_sets, u32 descriptor_set_count);
+u32 vgk_get_group_count(u32 item_count, u32 local_size);
+void vgk_cmd_dispatch_1d(VkCommandBuffer command_buffer, u32 item_count, u32 local_size);
+void vgk_cmd_dispatch_2d(VkCommandBuffer command_buffer, u32 width, u32 height, u32 local_size_x, u32 local_size_y);
+void vgk_cmd_buffer_barrier(VkCommandBuffer command_buffer, VkBuffer buffer, VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access);
+void vgk_cmd_image_barrier(VkCommandBuffer command_buffer, VkImage image, VkImageAspectFlags aspect, VkImageLayout old_layout, VkImageLayout new_layout, VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access);
+
+// ============================ CULLING ===============================
+
+void vgk_cull_pass_set_objects(Vgk_CullPass *pass, u32 frame_index, const Vgk_CullObject *objects, u32 object_count);
+void vgk_cmd_cull_to_indirect_list(VkCommandBuffer command_buffer, const Vgk_CullPass *pass, const Vgk_IndirectDrawList *list, u32 batch_index, m4 view_proj);
+u32 vgk_cull_objects_cpu(const Vgk_CullObject *objects, u32 object_count, m4 view_proj, VkDrawIndexedIndirectCommand *out_commands, u32 max_command_count);
+
 // ============================ DESTROY ===============================
 
 void vgk_destroy_swapchain_bundle(Vgk_SwapchainBundle *bundle, VkDevice device);
 void vgk_destroy_depth_image_bundle(Vgk_DepthImageBundle *bundle, VkDevice device);
+void vgk_destroy_msaa_image_bundle(Vgk_MsaaImageBundle *bundle, VkDevice device);
 void vgk_destroy_render_pass_bundle(Vgk_RenderPassBundle *bundle, VkDevice device);
 void vgk_destroy_command_pool(VkCommandPool *command_pool, VkDevice device);
 void vgk_destroy_frame_list(Vgk_FrameList *list, VkDevice device);
+void vgk_destroy_parallel_recorder(Vgk_ParallelRecorder *recorder, VkDevice device);
+void vgk_destroy_render_graph(Vgk_RenderGraph *graph, VkDevice device);
 void vgk_destroy_buffer_bundle(Vgk_BufferBundle *bundle, VkDevice device);
 void vgk_destroy_buffer_bundle_list(Vgk_BufferBundleList *list, VkDevice device);
 void vgk_destroy_texture_bundle(Vgk_TextureBundle *bundle, VkDevice device);
+void vgk_destroy_staging_pool(Vgk_StagingPool *pool, VkDevice device);
+void vgk_destroy_readback_ring(Vgk_ReadbackRing *ring, VkDevice device);
+void vgk_destroy_ui_batch(Vgk_UiBatch *batch, VkDevice device);
+void vgk_destroy_glyph_cache(Vgk_GlyphCache *cache, VkDevice device);
+void vgk_destroy_texture_atlas(Vgk_TextureAtlas *atlas, VkDevice device);
+void vgk_destroy_indirect_draw_list(Vgk_IndirectDrawList *list, VkDevice device);
+void vgk_destroy_compute_pipeline_bundle(Vgk_ComputePipelineBundle *bundle, VkDevice device);
+void vgk_destroy_cull_pass(Vgk_CullPass *pass, VkDevice device);
 // TODO: destroy_descriptor_set_bundle
 // TODO: destroy_descriptor_pool_bundle
-// TODO: destroy_pipeline_bundle
+void vgk_destroy_pipeline_bundle(Vgk_PipelineBundle *bundle, VkDevice device);
+void vgk_destroy_pipeline_table(Vgk_PipelineTable *table, VkDevice device);
+void vgk_destroy_pipeline_compiler(Vgk_PipelineCompiler *compiler, VkDevice device);
+void vgk_destroy_pipeline_registry(Vgk_PipelineRegistry *registry, VkDevice device);
+
+// ============================ DEFERRED DESTROY ===============================
+
+void vgk_defer_deletion(Vgk_FrameList *frame_list, const Vgk_Deletion *deletion);
+void vgk_defer_destroy_buffer_bundle(Vgk_FrameList *frame_list, Vgk_BufferBundle *bundle);
+void vgk_defer_destroy_texture_bundle(Vgk_FrameList *frame_list, Vgk_TextureBundle *bundle);
+void vgk_defer_destroy_pipeline_bundle(Vgk_FrameList *frame_list, Vgk_PipelineBundle *bundle);
+void vgk_defer_destroy_compute_pipeline_bundle(Vgk_FrameList *frame_list, Vgk_ComputePipelineBundle *bundle);
+void vgk_defer_destroy_descriptor_set_bundle(Vgk_FrameList *frame_list, Vgk_DescriptorPoolBundle *pool_bundle, Vgk_DescriptorSetBundle *bundle);
+void vgk_defer_destroy_render_pass_bundle(Vgk_FrameList *frame_list, Vgk_RenderPassBundle *bundle);
+void vgk_frame_list_flush_deletions(Vgk_FrameList *frame_list, u64 completed_value, VkDevice device);
+
+// ============================ MEMORY ===============================
+
+// Every device allocation in vgk goes through these so it is counted by category and heap
+VkResult vgk_allocate_memory(const VkMemoryAllocateInfo *allocate_info, Vgk_MemoryCategory category, VkDevice device, VkDeviceMemory *out_memory);
+void vgk_free_memory(VkDeviceMemory memory, VkDevice device);
+Vgk_MemoryCategory vgk_get_buffer_memory_category(VkBufferUsageFlags usage);
+void vgk_flush_buffer_bundle(const Vgk_BufferBundle *bundle, VkDeviceSize offset, VkDeviceSize size, VkDevice device);
+void vgk_invalidate_buffer_bundle(const Vgk_BufferBundle *bundle, VkDeviceSize offset, VkDeviceSize size, VkDevice device);
+Vgk_MemoryStats vgk_get_memory_stats();
+void vgk_log_memory_stats();
+void vgk_maybe_log_memory_stats(f64 now_seconds);
 
 // ============================ HELPERS ===============================
 
+Arena *vgk_get_scratch_arena();
+Vgk_DeviceCaps vgk_get_device_caps(VkPhysicalDevice physical_device);
 u32 vgk_get_queue_family_index(VkPhysicalDevice physical_device, VkSurfaceKHR surface);
 u32 vgk_find_memory_type(VkPhysicalDevice physical_device, u32 type_filter, VkMemoryPropertyFlags props);
+bool vgk_try_find_memory_type(VkPhysicalDevice physical_device, u32 type_filter, VkMemoryPropertyFlags props, u32 *out_type_index);
+bool vgk_try_find_preferred_memory_type(VkPhysicalDevice physical_device, u32 type_filter, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags secondary, VkMemoryPropertyFlags avoided, u32 *out_type_index);
+VkSampleCountFlagBits vgk_clamp_sample_count(VkPhysicalDevice physical_device, VkSampleCountFlagBits requested);
+VkFramebuffer vgk_get_framebuffer(const Vgk_RenderPassBundle *bundle, u32 image_index, u32 frame_index);
 VkViewport vgk_get_viewport_for_extent(VkExtent2D extent);
 VkRect2D vgk_get_scissor_for_extent(VkExtent2D extent);